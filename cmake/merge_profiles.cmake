@@ -0,0 +1,12 @@
+# Merge the raw profiles of a Clang instrumented build into the file -fprofile-use reads
+#     cmake -DLLVM_PROFDATA=llvm-profdata -DPROFILES=<dir> -DOUTPUT=<file> -P merge_profiles.cmake
+
+file(GLOB raw_profiles "${PROFILES}/*.profraw")
+if(NOT raw_profiles)
+    message(FATAL_ERROR "No raw profiles in ${PROFILES}")
+endif()
+
+execute_process(COMMAND "${LLVM_PROFDATA}" merge -output=${OUTPUT} ${raw_profiles} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "llvm-profdata merge failed")
+endif()
@@ -0,0 +1,55 @@
+# Translate copies of every sample with worker processes sharing a cache, and check that each distinct program is
+# translated once and that the outputs are those of a plain run
+#     cmake -DTINY=<tiny> -DSAMPLES=<dir> -DWORK_DIR=<dir> [-DCOPIES=<n>] -P processes_cache.cmake
+
+if(NOT COPIES)
+    set(COPIES 4)
+endif()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}/plain" "${WORK_DIR}/processes")
+file(GLOB samples "${SAMPLES}/*.txt")
+list(LENGTH samples count)
+if(count EQUAL 0)
+    message(FATAL_ERROR "No samples in ${SAMPLES}")
+endif()
+
+# Every sample under COPIES names, the copies of one sample having the same content
+set(names)
+foreach(sample ${samples})
+    get_filename_component(name "${sample}" NAME_WE)
+    foreach(copy RANGE 1 ${COPIES})
+        foreach(dir plain processes)
+            configure_file("${sample}" "${WORK_DIR}/${dir}/${name}_${copy}.txt" COPYONLY)
+        endforeach()
+        list(APPEND names "${name}_${copy}")
+    endforeach()
+endforeach()
+
+execute_process(COMMAND "${TINY}" -q "${WORK_DIR}/plain" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "tiny failed: ${result}")
+endif()
+
+execute_process(COMMAND "${TINY}" --processes 2 "${WORK_DIR}/processes" RESULT_VARIABLE result ERROR_VARIABLE report)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "tiny --processes 2 failed: ${result}\n${report}")
+endif()
+
+foreach(name ${names})
+    file(READ "${WORK_DIR}/plain/${name}.cpp" plain)
+    file(READ "${WORK_DIR}/processes/${name}.cpp" processes)
+    if(NOT plain STREQUAL processes)
+        message(FATAL_ERROR "${name}: tiny --processes 2 wrote another translation than tiny")
+    endif()
+endforeach()
+
+# Each distinct program is translated by one process, its other copies are found in the shared cache
+math(EXPR expected "${count} * (${COPIES} - 1)")
+if(NOT report MATCHES "tiny: 2 worker processes, ([0-9]+) shared cache hits")
+    message(FATAL_ERROR "tiny --processes 2 did not report its cache hits:\n${report}")
+endif()
+if(NOT CMAKE_MATCH_1 EQUAL expected)
+    message(FATAL_ERROR "${CMAKE_MATCH_1} shared cache hits, expected ${expected}:\n${report}")
+endif()
+message(STATUS "${count} samples, ${COPIES} copies each: ${CMAKE_MATCH_1} shared cache hits")
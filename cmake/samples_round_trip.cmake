@@ -0,0 +1,44 @@
+# Translate every sample, build and run its code, and check that it prints what the VM (tiny --run) prints
+#     cmake -DTINY=<tiny> -DCXX=<compiler> -DSAMPLES=<dir> -DWORK_DIR=<dir> -P samples_round_trip.cmake
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+file(GLOB samples "${SAMPLES}/*.txt")
+if(NOT samples)
+    message(FATAL_ERROR "No samples in ${SAMPLES}")
+endif()
+
+# Samples asking for a number all get this one
+set(input "${WORK_DIR}/input")
+file(WRITE "${input}" "7\n")
+
+foreach(sample ${samples})
+    get_filename_component(name "${sample}" NAME_WE)
+    file(COPY "${sample}" DESTINATION "${WORK_DIR}")
+
+    execute_process(COMMAND "${TINY}" -q "${WORK_DIR}/${name}.txt" RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${name}: translation failed")
+    endif()
+
+    execute_process(COMMAND "${CXX}" -std=c++17 -O1 "${WORK_DIR}/${name}.cpp" -o "${WORK_DIR}/${name}"
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${name}: the translated code does not build")
+    endif()
+
+    execute_process(COMMAND "${WORK_DIR}/${name}" INPUT_FILE "${input}" OUTPUT_VARIABLE compiled RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${name}: the translated program failed: ${result}")
+    endif()
+    execute_process(COMMAND "${TINY}" --run "${WORK_DIR}/${name}.txt" INPUT_FILE "${input}" OUTPUT_VARIABLE interpreted
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${name}: tiny --run failed: ${result}")
+    endif()
+
+    if(NOT compiled STREQUAL interpreted)
+        message(FATAL_ERROR "${name}: the translated program printed\n${compiled}\nbut the VM printed\n${interpreted}")
+    endif()
+    message(STATUS "${name}: ok")
+endforeach()
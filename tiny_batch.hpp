@@ -0,0 +1,778 @@
+#ifndef TINY_BATCH_HPP_INCLUDED
+#define TINY_BATCH_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_scheduler.hpp"
+#include "tiny_stats.hpp"
+#include "tiny_perf.hpp"
+#include "tiny_trace.hpp"
+#include "tiny_stream.hpp"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <memory>
+#include <memory_resource>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <glob.h>
+#include <sys/resource.h>
+
+namespace TINY
+{
+// Outcome of translating one source file
+struct File_Result
+{
+    std::string path;
+    bool ok = false;
+    std::string diagnostics; // Everything the translator reported for this file, one message per line
+    Phase_Times times;       // Measured with Batch_Options::time_report only
+    std::string counters_reason;          // Why hardware counters are missing from times, see Perf_Counters::get_reason
+    Allocation_Stats allocations;         // What the translator allocated, with Batch_Options::alloc_report only
+    std::uint64_t system_allocations = 0; // Allocations that reached new/delete through the pool of the worker
+    Memory_Peaks memory;                  // High-water marks of each component, with Batch_Options::memory_report only
+};
+
+// Outcome of a whole batch, results are kept in the same order as the inputs
+struct Batch_Result
+{
+    std::vector<File_Result> files;
+    std::size_t failed = 0;
+    std::size_t skipped = 0; // Up to date files an incremental build did not translate again
+    std::vector<Worker_Stats> workers; // Utilization of each scheduler worker over the batch
+    std::size_t peak_admitted = 0;     // Largest estimated footprint of the translations running together
+    Phase_Times times;                 // Sum of the times of the files, with Batch_Options::time_report
+    std::string counters_reason;       // Why hardware counters are missing from times, as the first file reporting it says
+    Allocation_Stats allocations;      // Sum of the allocations of the files, with Batch_Options::alloc_report
+    std::uint64_t system_allocations = 0;
+    Memory_Peaks memory;               // Highest high-water marks of the files, with Batch_Options::memory_report
+    std::string largest;               // File with the highest total high-water mark
+};
+
+struct Batch_Options
+{
+    std::size_t jobs = 0;              // Number of workers, 0 for one per core
+    bool check_only = false;           // Only report errors, do not write any output
+    bool parallel_lex = false;         // Split large files at top level statement boundaries and translate the pieces in parallel
+    std::size_t chunk_bytes = 1 << 18; // Approximate size of a piece, files smaller than two pieces are never split
+    std::size_t memory_budget = 0;     // Estimated bytes the translations running together may use, 0 for no limit
+    bool time_report = false;          // Measure the phases of each file (files are then never split)
+    bool alloc_report = false;         // Count the allocations of each file by phase (files are then never split)
+    bool memory_report = false;        // Measure the high-water marks of each file by component (never split either)
+    bool perf_counters = false;        // Add hardware counters to the time report, when the system provides them
+    Trace_Recorder* p_trace = nullptr; // Record the spans of each file's phases (files are then never split)
+    // Write code counting or sampling the executions of each TINY line (files are then never split)
+    Translator::Profile_Mode profile = Translator::Profile_Mode::NONE;
+};
+
+// Piece of the body of a program made of whole top level statements
+struct Program_Piece
+{
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    std::set<std::string> declared; // Identifiers declared (by LET or INPUT, at any depth) by the statements before the piece
+};
+
+// Turn command line operands into a sorted list of unique .txt paths
+// An operand can be a file, a directory (searched recursively for .txt files) or a glob pattern
+// Operands matching nothing are reported in errors
+inline std::vector<std::string> collect_inputs(const std::vector<std::string>& operands, std::vector<std::string>& errors)
+{
+    namespace fs = std::filesystem;
+    std::vector<std::string> inputs;
+
+    for(const std::string& operand : operands)
+    {
+        std::error_code ec;
+        if(fs::is_directory(operand, ec))
+        {
+            for(fs::recursive_directory_iterator it(operand, ec), end; it != end; it.increment(ec))
+            {
+                if(ec)
+                    break;
+                if(it->is_regular_file(ec) && it->path().extension() == ".txt")
+                    inputs.push_back(it->path().string());
+            }
+            if(ec)
+                errors.push_back(operand + ": " + ec.message());
+        }
+        else if(operand.find_first_of("*?[") != std::string::npos)
+        {
+            glob_t matches;
+            if(glob(operand.c_str(), 0, nullptr, &matches) == 0)
+            {
+                for(std::size_t i = 0; i < matches.gl_pathc; i++)
+                    inputs.push_back(matches.gl_pathv[i]);
+            }
+            else
+            {
+                errors.push_back(operand + ": no matching files");
+            }
+            globfree(&matches);
+        }
+        else if(fs::exists(operand, ec))
+        {
+            inputs.push_back(operand);
+        }
+        else
+        {
+            errors.push_back(operand + ": no such file or directory");
+        }
+    }
+
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+    return inputs;
+}
+
+// Split the body of a program into pieces of about piece_bytes, cutting only before top level statements.
+// Lines are scanned without parsing, so this returns false when the program does not have the plain
+// 'BEGIN' line ... 'END' line shape, in which case it must be translated as a whole
+inline bool split_program(const std::string& source, std::size_t piece_bytes, std::vector<Program_Piece>& pieces)
+{
+    // Line content with surrounding whitespace trimmed
+    auto trimmed = [&](std::size_t begin, std::size_t end)
+    {
+        while(begin < end && std::isspace(static_cast<unsigned char>(source[begin])))
+            begin++;
+        while(end > begin && std::isspace(static_cast<unsigned char>(source[end - 1])))
+            end--;
+        return std::string(source, begin, end - begin);
+    };
+    // Word made of letters and digits starting at pos (after leading blanks), pos is moved past it
+    auto word = [&](std::size_t& pos, std::size_t end)
+    {
+        while(pos < end && (source[pos] == ' ' || source[pos] == '\t' || source[pos] == '\r'))
+            pos++;
+        std::size_t begin = pos;
+        if(pos < end && std::isalpha(static_cast<unsigned char>(source[pos])))
+        {
+            while(pos < end && std::isalnum(static_cast<unsigned char>(source[pos])))
+                pos++;
+        }
+        return std::string(source, begin, pos - begin);
+    };
+
+    std::vector<std::pair<std::size_t, std::size_t>> lines;
+    for(std::size_t begin = 0; begin < source.size();)
+    {
+        std::size_t end = source.find('\n', begin);
+        end = end == std::string::npos ? source.size() : end + 1;
+        if(!trimmed(begin, end).empty())
+            lines.emplace_back(begin, end);
+        begin = end;
+    }
+
+    if(lines.size() < 3 || trimmed(lines.front().first, lines.front().second) != "BEGIN"
+       || trimmed(lines.back().first, lines.back().second) != "END" || source.back() != '\n')
+        return false;
+
+    pieces.clear();
+    pieces.emplace_back();
+    pieces.back().begin = lines.front().second;
+
+    std::set<std::string> declared;
+    int depth = 0;
+    for(std::size_t i = 1; i + 1 < lines.size(); i++)
+    {
+        std::size_t pos = lines[i].first;
+        std::string first = word(pos, lines[i].second);
+
+        bool statement = first == "PRINT" || first == "INPUT" || first == "LET" || first == "IF" || first == "WHILE";
+        if(depth == 0 && statement && lines[i].first - pieces.back().begin >= piece_bytes)
+        {
+            pieces.back().end = lines[i].first;
+            pieces.emplace_back();
+            pieces.back().begin = lines[i].first;
+            pieces.back().declared = declared;
+        }
+
+        if(first == "LET" || first == "INPUT")
+            declared.insert(word(pos, lines[i].second));
+        else if(first == "IF" || first == "WHILE")
+            depth++;
+        else if(first == "ENDIF" || first == "ENDWHILE")
+            depth--;
+
+        if(depth < 0)
+            return false;
+    }
+    pieces.back().end = lines.back().first;
+
+    return depth == 0;
+}
+
+// Translators are not shareable but can be reused, so each worker thread keeps its own
+inline Translator& worker_translator()
+{
+    thread_local Translator translator;
+    return translator;
+}
+
+// Instrument what a worker's translator writes while in scope (Batch_Options::profile), for the batch drivers
+class Profiling_Scope
+{
+    Translator& translator;
+
+ public:
+    Profiling_Scope(Translator& translator, Translator::Profile_Mode mode) : translator(translator)
+    {
+        translator.set_profiling(mode);
+    }
+    ~Profiling_Scope() { translator.set_profiling(Translator::Profile_Mode::NONE); }
+
+    Profiling_Scope(const Profiling_Scope&) = delete;
+};
+
+// Memory a translation is expected to hold, by what holds it. The translator has no AST: statements are emitted
+// as they are parsed, so what grows with the program is the set of declared identifiers and whatever buffers the
+// source or the output in memory
+struct Memory_Estimate
+{
+    std::size_t source = 0; // Source text read into memory
+    std::size_t tokens = 0; // Lexer buffers and declared identifiers, bounded by the source size
+    std::size_t output = 0; // Generated code held in memory, about twice the source
+    std::size_t fixed = 0;  // Stream buffers and the translator itself
+
+    std::size_t total() const { return source + tokens + output + fixed; }
+};
+
+// Estimate for translating a file of size bytes the way translate_file will. A heuristic from the file size alone,
+// not a measure: --memory-report gives what a translation actually held (Memory_Tracker)
+inline Memory_Estimate estimate_memory(std::uintmax_t size, const Batch_Options& options)
+{
+    Memory_Estimate estimate;
+    bool split = options.parallel_lex && !options.check_only && size >= 2 * options.chunk_bytes;
+
+    estimate.fixed = std::size_t(64) << 10;
+    estimate.tokens = std::size_t(size);
+    if(options.check_only || split)
+        estimate.source = std::size_t(size);
+    if(split)
+        estimate.output = 2 * std::size_t(size) + std::size_t(size); // Piece outputs, plus the piece inputs
+    return estimate;
+}
+
+// Admits translations while the sum of their estimates stays within a budget. One translation is always admitted
+// when none is running, however large, so a batch never stalls on a file bigger than the budget
+class Admission_Control
+{
+ protected:
+    std::size_t budget;
+    std::size_t in_use;
+    std::size_t peak;
+    std::mutex mutex;
+    std::condition_variable released;
+
+ public:
+    explicit Admission_Control(std::size_t bytes) : budget(bytes), in_use(0), peak(0) {}
+
+    // Block until bytes fit in the budget
+    void acquire(std::size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&] { return in_use == 0 || in_use + bytes <= budget; });
+        in_use += bytes;
+        peak = std::max(peak, in_use);
+    }
+
+    void release(std::size_t bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_use -= bytes;
+        }
+        released.notify_all();
+    }
+
+    std::size_t get_peak()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+};
+
+// Highest resident set size of the process so far, in bytes
+inline std::size_t peak_rss_bytes()
+{
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return std::size_t(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+}
+
+namespace detail
+{
+
+// Translate one file as a whole
+inline void translate_whole(const std::string& path, File_Result& result, bool check_only = false)
+{
+    Translator& translator = worker_translator();
+
+    std::ostringstream diagnostics;
+    translator.set_diagnostics(diagnostics);
+
+    if(check_only)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+        {
+            diagnostics << "Invalid file path" << std::endl;
+            result.ok = false;
+        }
+        else
+        {
+            std::stringstream input;
+            input << file.rdbuf();
+            std::ostream discard(nullptr);
+            result.ok = translator.translate(input, discard);
+        }
+    }
+    else
+    {
+        result.ok = translator(path);
+    }
+    result.diagnostics = diagnostics.str();
+
+    translator.set_diagnostics(std::cerr);
+}
+
+// Translate one file as a whole with its phases measured. The source is read before translating and the code written
+// after, so that reading and writing are told apart from lexing and emitting.
+// The translator allocates from a pool kept by the worker thread, and is counted on both sides of it: what the
+// translator asks for, and what the pool asks new/delete for. What it asks for is also tracked by component, with
+// the source and the code, to give the high-water marks of the translation. With options.perf_counters, the hardware counters of the
+// worker thread are read at every change of phase too, and with options.p_trace the phases are recorded as spans
+inline void translate_timed(const std::string& path, File_Result& result, const Batch_Options& options)
+{
+    thread_local Accounting_Resource system(std::pmr::new_delete_resource());
+    thread_local std::pmr::unsynchronized_pool_resource pool(&system);
+
+    bool check_only = options.check_only;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    Phase_Timer timer;
+    Perf_Counters* p_counters = nullptr;
+    if(options.perf_counters)
+    {
+        thread_local Perf_Counters counters;
+        timer.set_counters(counters);
+        p_counters = &counters;
+    }
+    if(options.p_trace)
+        timer.set_spans(*options.p_trace);
+    Phase_Timer_Activation activation(timer);
+
+    Translator& translator = worker_translator();
+    std::ostringstream diagnostics;
+    translator.set_diagnostics(diagnostics);
+    Accounting_Resource accounting(&pool);
+    Memory_Tracker tracker(&accounting);
+    std::pmr::memory_resource* p_memory = translator.get_memory();
+    translator.set_memory(Component::TOKENS, tracker.resource(Component::TOKENS));
+    translator.set_memory(Component::IR, tracker.resource(Component::IR));
+    translator.set_memory(Component::SYMBOLS, tracker.resource(Component::SYMBOLS));
+    std::uint64_t system_before = system.get_stats().total_count();
+
+    std::pmr::string source(tracker.resource(Component::SOURCE));
+    bool readable;
+    {
+        Phase_Scope scope(Phase::READ);
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        readable = path.size() >= 4 && file;
+        if(readable)
+        {
+            source.resize(std::size_t(file.tellg()));
+            readable = bool(file.seekg(0).read(&source[0], std::streamsize(source.size())));
+        }
+    }
+    View_Streambuf input_buffer(source.data(), source.size());
+    std::iostream input(&input_buffer);
+
+    if(!readable)
+        diagnostics << "Invalid file path" << std::endl;
+    else if(!check_only && path.compare(path.size() - 4, 4, ".txt") != 0)
+        diagnostics << "Invalid file extension" << std::endl;
+    else
+    {
+        std::pmr::string code(tracker.resource(Component::OUTPUT));
+        Pmr_String_Streambuf code_buffer(code);
+        Timed_Streambuf timed(check_only ? nullptr : &code_buffer);
+        std::ostream output(&timed);
+        result.ok = translator.translate(input, output);
+
+        if(!check_only)
+        {
+            Phase_Scope scope(Phase::WRITE);
+            std::string outfile_path = path.substr(0, path.size() - 4) + ".cpp";
+            if(result.ok)
+            {
+                std::ofstream file(outfile_path, std::ios::trunc | std::ios::binary);
+                file.write(code.data(), std::streamsize(code.size()));
+                result.ok = bool(file.flush());
+            }
+            else
+            {
+                std::remove(outfile_path.c_str());
+            }
+        }
+    }
+
+    result.diagnostics = diagnostics.str();
+    translator.set_diagnostics(std::cerr);
+    translator.set_memory(p_memory);
+    result.times = timer.get_times();
+    if(p_counters)
+        result.counters_reason = p_counters->get_reason(); // Known once the counters were read
+    result.allocations = accounting.get_stats();
+    result.memory = tracker.get_peaks();
+    result.system_allocations = system.get_stats().total_count() - system_before;
+    if(options.p_trace)
+        options.p_trace->file(path, begin, std::chrono::steady_clock::now(), result.ok, result.times);
+}
+
+// State shared by the pieces of a file being translated in parallel
+struct Split_File
+{
+    std::shared_ptr<void> admission; // Released with the last piece
+    std::string path;
+    File_Result* p_result;
+    std::string source;
+    std::vector<std::string> outputs;
+    std::vector<char> piece_ok;
+    std::atomic<std::size_t> remaining;
+};
+
+// Called by the last finished piece: assemble the output, or translate the whole file again to report its errors exactly
+inline void finish_split(Split_File& file)
+{
+    if(std::find(file.piece_ok.begin(), file.piece_ok.end(), 0) != file.piece_ok.end())
+    {
+        translate_whole(file.path, *file.p_result);
+        return;
+    }
+
+    std::string outfile_path(file.path.begin(), file.path.end() - 4);
+    std::ofstream output(outfile_path + ".cpp", std::ios::trunc);
+
+    Translator::begin_output(output);
+    Translator::begin_main(output);
+    for(const std::string& piece : file.outputs)
+        output << piece;
+    Translator::end_main(output);
+
+    file.p_result->ok = bool(output);
+}
+
+// Translate a file, splitting it into pieces scheduled on their own when it is large enough.
+// admission, when given, is kept alive until the whole file is done
+inline void translate_file(Work_Stealing_Scheduler& scheduler, const Batch_Options& options, File_Result& result,
+                           std::shared_ptr<void> admission = nullptr)
+{
+    if(options.profile != Translator::Profile_Mode::NONE)
+    {
+        Profiling_Scope profiling(worker_translator(), options.profile);
+        if(options.time_report || options.alloc_report || options.memory_report || options.p_trace)
+            translate_timed(result.path, result, options);
+        else
+            translate_whole(result.path, result, options.check_only);
+        return;
+    }
+
+    if(options.time_report || options.alloc_report || options.memory_report || options.p_trace)
+    {
+        translate_timed(result.path, result, options);
+        return;
+    }
+
+    std::error_code ec;
+    std::uintmax_t size = std::filesystem::file_size(result.path, ec);
+    if(options.check_only || !options.parallel_lex || ec || size < 2 * options.chunk_bytes || result.path.size() < 4
+       || result.path.compare(result.path.size() - 4, 4, ".txt") != 0)
+    {
+        translate_whole(result.path, result, options.check_only);
+        return;
+    }
+
+    auto file = std::make_shared<Split_File>();
+    file->admission = std::move(admission);
+    file->path = result.path;
+    file->p_result = &result;
+    {
+        std::ifstream input(result.path, std::ios::binary);
+        file->source.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<Program_Piece> pieces;
+    if(!split_program(file->source, options.chunk_bytes, pieces))
+    {
+        translate_whole(result.path, result);
+        return;
+    }
+
+    file->outputs.resize(pieces.size());
+    file->piece_ok.assign(pieces.size(), 0);
+    file->remaining = pieces.size();
+
+    for(std::size_t i = 0; i < pieces.size(); i++)
+    {
+        scheduler.submit([file, i, piece = std::move(pieces[i])]
+        {
+            Translator& translator = worker_translator();
+
+            std::ostringstream diagnostics;
+            translator.set_diagnostics(diagnostics);
+
+            std::stringstream input(file->source.substr(piece.begin, piece.end - piece.begin));
+            std::ostringstream output;
+            file->piece_ok[i] = translator.translate_fragment(input, output, piece.declared);
+            file->outputs[i] = output.str();
+
+            translator.set_diagnostics(std::cerr);
+
+            if(--file->remaining == 0)
+                finish_split(*file);
+        });
+    }
+}
+}
+
+// Translate every input concurrently on a work stealing scheduler, largest files first.
+// With a memory budget, a file only starts once its estimated footprint fits next to the translations running.
+// Diagnostics are collected per file so that the caller can print them in input order
+inline Batch_Result translate_batch(const std::vector<std::string>& inputs, const Batch_Options& options = Batch_Options())
+{
+    Batch_Result batch;
+    batch.files.resize(inputs.size());
+
+    std::size_t workers = options.jobs == 0 ? Work_Stealing_Scheduler::default_size() : options.jobs;
+    if(!options.parallel_lex)
+        workers = std::min(workers, std::max<std::size_t>(inputs.size(), 1));
+
+    {
+        Work_Stealing_Scheduler scheduler(workers);
+
+        std::vector<std::pair<std::uint64_t, std::size_t>> sizes;
+        for(std::size_t i = 0; i < inputs.size(); i++)
+        {
+            batch.files[i].path = inputs[i];
+
+            std::error_code ec;
+            std::uintmax_t size = std::filesystem::file_size(inputs[i], ec);
+            sizes.emplace_back(ec ? 0 : size, i);
+        }
+
+        if(options.memory_budget == 0)
+        {
+            std::vector<std::pair<std::uint64_t, Work_Stealing_Scheduler::Task>> tasks;
+            for(const auto& size : sizes)
+            {
+                File_Result& result = batch.files[size.second];
+                tasks.emplace_back(size.first, [&scheduler, &options, &result] { detail::translate_file(scheduler, options, result); });
+            }
+            scheduler.seed(std::move(tasks));
+        }
+        else
+        {
+            // Hand the files to the scheduler largest first, each one once its estimate fits in the budget. Waiting
+            // here rather than in the workers keeps them free to finish the translations that will release memory
+            auto admission = std::make_shared<Admission_Control>(options.memory_budget);
+            std::stable_sort(sizes.begin(), sizes.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+            for(const auto& size : sizes)
+            {
+                std::size_t bytes = estimate_memory(size.first, options).total();
+                admission->acquire(bytes);
+
+                std::shared_ptr<void> ticket(nullptr, [admission, bytes](void*) { admission->release(bytes); });
+                File_Result& result = batch.files[size.second];
+                scheduler.submit([&scheduler, &options, &result, ticket]() mutable
+                {
+                    detail::translate_file(scheduler, options, result, std::move(ticket));
+                });
+            }
+            scheduler.wait();
+            batch.peak_admitted = admission->get_peak();
+        }
+        scheduler.wait();
+        batch.workers = scheduler.stats();
+    }
+
+    for(const File_Result& result : batch.files)
+    {
+        if(!result.ok)
+            batch.failed++;
+        batch.times += result.times;
+        if(batch.counters_reason.empty())
+            batch.counters_reason = result.counters_reason;
+        batch.allocations += result.allocations;
+        batch.system_allocations += result.system_allocations;
+        if(result.memory.total > batch.memory.total)
+            batch.largest = result.path;
+        batch.memory += result.memory;
+    }
+
+    return batch;
+}
+
+// Print the diagnostics of a batch in input order, each line prefixed with the path of its file
+inline void print_diagnostics(const Batch_Result& batch, std::ostream& out)
+{
+    for(const File_Result& result : batch.files)
+    {
+        std::istringstream lines(result.diagnostics);
+        std::string line;
+        while(std::getline(lines, line))
+            out << result.path << ": " << line << "\n";
+    }
+    out.flush();
+}
+
+namespace detail
+{
+// Path as the contents of a JSON string
+inline std::string json_path(const std::string& path)
+{
+    std::string escaped;
+    for(char c : path)
+    {
+        if(c == '"' || c == '\\')
+            escaped += '\\';
+        if(static_cast<unsigned char>(c) >= 0x20)
+            escaped += c;
+    }
+    return escaped;
+}
+}
+
+// Print the phase times of a batch: as a table (one row of wall milliseconds per file, then the phases of the whole
+// batch) or as one JSON object {"files": [{"path": ..., "phases": {...}}...], "total": {...}}
+inline void print_time_report(const Batch_Result& batch, std::ostream& out, bool json = false)
+{
+    if(json)
+    {
+        out << "{\"files\":[";
+        for(std::size_t i = 0; i < batch.files.size(); i++)
+        {
+            out << (i ? "," : "") << "{\"path\":\"" << detail::json_path(batch.files[i].path) << "\",\"phases\":"
+                << phase_json(batch.files[i].times) << "}";
+        }
+        out << "],\"total\":" << phase_json(batch.times) << "}" << std::endl;
+        return;
+    }
+
+    out << "     read       lex     parse  optimize      emit     write  file (wall ms)\n";
+    for(const File_Result& result : batch.files)
+    {
+        const Phase_Times& times = result.times;
+        char line[128];
+        std::snprintf(line, sizeof line, "%9.3f %9.3f %9.3f %9.3f %9.3f %9.3f  ",
+                      1000 * times.wall[int(Phase::READ)], 1000 * times.wall[int(Phase::LEX)],
+                      1000 * times.wall[int(Phase::PARSE)], 1000 * times.wall[int(Phase::OPTIMIZE)],
+                      1000 * times.wall[int(Phase::EMIT)], 1000 * times.wall[int(Phase::WRITE)]);
+        out << line << result.path << "\n";
+    }
+    out << "\n";
+    print_phase_table(batch.times, out);
+    out.flush();
+}
+
+// Print the allocations of a batch: as a table (one row per file, then the phases of the whole batch) or as one JSON
+// object {"files": [{"path": ..., "phases": {...}, "system_allocations": ...}...], "total": {...}, "system_allocations": ...}
+inline void print_allocation_report(const Batch_Result& batch, std::ostream& out, bool json = false)
+{
+    if(json)
+    {
+        out << "{\"files\":[";
+        for(std::size_t i = 0; i < batch.files.size(); i++)
+        {
+            const File_Result& result = batch.files[i];
+            out << (i ? "," : "") << "{\"path\":\"" << detail::json_path(result.path) << "\",\"phases\":"
+                << allocation_json(result.allocations) << ",\"system_allocations\":" << result.system_allocations << "}";
+        }
+        out << "],\"total\":" << allocation_json(batch.allocations) << ",\"system_allocations\":"
+            << batch.system_allocations << "}" << std::endl;
+        return;
+    }
+
+    out << "allocations        bytes   peak bytes       system  file\n";
+    for(const File_Result& result : batch.files)
+    {
+        const Allocation_Stats& stats = result.allocations;
+        char line[96];
+        std::snprintf(line, sizeof line, "%11llu %12llu %12llu %12llu  ", static_cast<unsigned long long>(stats.total_count()),
+                      static_cast<unsigned long long>(stats.total_bytes()),
+                      static_cast<unsigned long long>(stats.peak_bytes()),
+                      static_cast<unsigned long long>(result.system_allocations));
+        out << line << result.path << "\n";
+    }
+    out << "\n";
+    print_allocation_table(batch.allocations, out);
+    out << "system allocations: " << batch.system_allocations << std::endl;
+}
+
+// Print the memory high-water marks of a batch: as a table (one row of peak bytes by component per file, then the
+// highest of each component over the batch, the memory the largest translation needs) or as one JSON object
+// {"files": [{"path": ..., "peak_bytes": {...}}...], "largest": {...}, "largest_file": ...}
+inline void print_memory_report(const Batch_Result& batch, std::ostream& out, bool json = false)
+{
+    if(json)
+    {
+        out << "{\"files\":[";
+        for(std::size_t i = 0; i < batch.files.size(); i++)
+        {
+            out << (i ? "," : "") << "{\"path\":\"" << detail::json_path(batch.files[i].path) << "\",\"peak_bytes\":"
+                << memory_json(batch.files[i].memory) << "}";
+        }
+        out << "],\"largest\":" << memory_json(batch.memory) << ",\"largest_file\":\"" << detail::json_path(batch.largest)
+            << "\"}" << std::endl;
+        return;
+    }
+
+    out << "      source       tokens           ir      symbols       output        total  file (peak bytes)\n";
+    for(const File_Result& result : batch.files)
+    {
+        const Memory_Peaks& peaks = result.memory;
+        char line[128];
+        std::snprintf(line, sizeof line, "%12llu %12llu %12llu %12llu %12llu %12llu  ",
+                      static_cast<unsigned long long>(peaks.peak[int(Component::SOURCE)]),
+                      static_cast<unsigned long long>(peaks.peak[int(Component::TOKENS)]),
+                      static_cast<unsigned long long>(peaks.peak[int(Component::IR)]),
+                      static_cast<unsigned long long>(peaks.peak[int(Component::SYMBOLS)]),
+                      static_cast<unsigned long long>(peaks.peak[int(Component::OUTPUT)]),
+                      static_cast<unsigned long long>(peaks.total));
+        out << line << result.path << "\n";
+    }
+    out << "\nhighest over the batch";
+    if(!batch.largest.empty())
+        out << " (largest total: " << batch.largest << ")";
+    out << ":\n";
+    print_memory_table(batch.memory, out);
+    out.flush();
+}
+
+// Print how busy each worker was over the batch
+inline void print_utilization(const Batch_Result& batch, std::ostream& out)
+{
+    out << "worker  tasks  steals  busy(s)  utilization\n";
+    for(std::size_t i = 0; i < batch.workers.size(); i++)
+    {
+        const Worker_Stats& stat = batch.workers[i];
+        char line[96];
+        std::snprintf(line, sizeof line, "%6zu %6zu %7zu %8.3f %11.1f%%\n", i, stat.tasks, stat.steals, stat.busy_seconds, 100 * stat.utilization);
+        out << line;
+    }
+    out.flush();
+}
+}
+
+#endif // TINY_BATCH_HPP_INCLUDED
@@ -0,0 +1,600 @@
+// Benchmarks of the translator, written as JSON, and comparison of two results to catch regressions
+//
+// Usage: tiny_bench [options]                      run the benchmarks, print the results (or write them with -o)
+//        tiny_bench --compare <baseline> <results> flag the benchmarks worse than the baseline beyond the noise
+//        tiny_bench --write-corpus <dir>           write the synthetic programs, to train a PGO build of tiny on
+//
+// Build: g++ -std=c++17 -O2 -pthread tiny_bench.cpp -o tiny_bench
+//
+// Translation benchmarks translate in memory, so they measure lexing, parsing and emitting and not the file system.
+// Compile and run benchmarks translate samples/fibonacci.txt and build both its code and the hand written
+// "Test (1).cpp" with the C++ compiler, then run both on the same input.
+// Exit status: 0, 1 when a benchmark failed or a comparison found regressions, 2 on usage errors
+
+#include "tiny_language (1).hpp"
+#include "tiny_stream.hpp"
+#include "tiny_json.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <stdlib.h>
+
+namespace
+{
+struct Bench_Options
+{
+    std::string samples = "samples";
+    std::string handwritten = "Test (1).cpp";
+    std::string cxx;                // C++ compiler of the compile and run benchmarks, $CXX or g++ by default
+    std::string output;             // Results file, standard output when empty
+    double min_time = 0.5;          // Seconds each translation benchmark runs for at least
+    std::size_t synthetic_mb = 16;  // Size of the synthetic programs
+    std::size_t runs = 20;          // Runs of each compiled program
+    bool compile = true;
+
+    std::string corpus;             // With --write-corpus
+    std::string baseline;           // With --compare
+    std::string results;
+    double threshold = 0.10;        // Change beyond which a comparison reports a regression
+};
+
+// One measurement. Units are "MB/s" (higher is better) or "s" (lower is better)
+struct Bench_Result
+{
+    std::string name;
+    double value = 0;
+    std::string unit;
+    std::map<std::string, double> details; // Other figures, not compared
+};
+
+void usage(std::ostream& out)
+{
+    out << "Usage: tiny_bench [options]\n"
+        << "       tiny_bench --compare <baseline> <results> [--threshold F]\n"
+        << "       tiny_bench --write-corpus DIR [--synthetic-mb N]\n"
+        << "\n"
+        << "Options:\n"
+        << "  -o, --output FILE     write the results to FILE instead of the standard output\n"
+        << "      --samples DIR     TINY programs to translate (default: samples)\n"
+        << "      --handwritten F   hand written C++ of samples/fibonacci.txt (default: \"Test (1).cpp\")\n"
+        << "      --min-time S      seconds each translation benchmark runs for at least (default: 0.5)\n"
+        << "      --synthetic-mb N  size of the synthetic programs in MiB (default: 16)\n"
+        << "      --cxx COMPILER    C++ compiler to build the generated code with (default: $CXX or g++)\n"
+        << "      --runs N          runs of each compiled program (default: 20)\n"
+        << "      --no-compile      skip the compile and run benchmarks\n"
+        << "      --compare B R     compare results R to the baseline B, exit with 1 on regressions\n"
+        << "      --threshold F     relative change reported as a regression (default: 0.10)\n"
+        << "      --write-corpus DIR  write the synthetic programs to DIR as .txt files and exit\n"
+        << "  -h, --help            show this help" << std::endl;
+}
+
+int parse_arguments(int argc, char* argv[], Bench_Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        auto value = [&](std::string& text) -> bool
+        {
+            if(i + 1 == argc)
+            {
+                std::cerr << "tiny_bench: " << arg << " expects a value" << std::endl;
+                return false;
+            }
+            text = argv[++i];
+            return true;
+        };
+        auto number = [&](double& result) -> bool
+        {
+            std::string text;
+            if(!value(text))
+                return false;
+            char* end = nullptr;
+            result = std::strtod(text.c_str(), &end);
+            if(end == text.c_str() || *end != '\0' || !(result > 0))
+            {
+                std::cerr << "tiny_bench: " << arg << " expects a positive number" << std::endl;
+                return false;
+            }
+            return true;
+        };
+
+        double figure = 0;
+        if(arg == "-h" || arg == "--help")
+        {
+            usage(std::cout);
+            return -1;
+        }
+        else if(arg == "-o" || arg == "--output")
+        {
+            if(!value(options.output))
+                return 2;
+        }
+        else if(arg == "--samples")
+        {
+            if(!value(options.samples))
+                return 2;
+        }
+        else if(arg == "--handwritten")
+        {
+            if(!value(options.handwritten))
+                return 2;
+        }
+        else if(arg == "--cxx")
+        {
+            if(!value(options.cxx))
+                return 2;
+        }
+        else if(arg == "--min-time")
+        {
+            if(!number(options.min_time))
+                return 2;
+        }
+        else if(arg == "--synthetic-mb")
+        {
+            if(!number(figure))
+                return 2;
+            options.synthetic_mb = std::size_t(figure);
+        }
+        else if(arg == "--runs")
+        {
+            if(!number(figure))
+                return 2;
+            options.runs = std::size_t(figure);
+        }
+        else if(arg == "--no-compile")
+            options.compile = false;
+        else if(arg == "--compare")
+        {
+            if(!value(options.baseline) || !value(options.results))
+                return 2;
+        }
+        else if(arg == "--write-corpus")
+        {
+            if(!value(options.corpus))
+                return 2;
+        }
+        else if(arg == "--threshold")
+        {
+            if(!number(options.threshold))
+                return 2;
+        }
+        else
+        {
+            std::cerr << "tiny_bench: unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool read_file(const std::string& path, std::string& content)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return bool(file);
+}
+
+// Statements of a program: lines starting with a statement keyword
+std::size_t count_statements(const std::string& source)
+{
+    static const char* const keywords[] = {"PRINT", "INPUT", "LET", "IF", "WHILE"};
+
+    std::size_t statements = 0;
+    std::istringstream lines(source);
+    std::string word;
+    std::string line;
+    while(std::getline(lines, line))
+    {
+        std::istringstream(line) >> word;
+        for(const char* keyword : keywords)
+        {
+            if(word == keyword)
+            {
+                statements++;
+                break;
+            }
+        }
+        word.clear();
+    }
+    return statements;
+}
+
+// Program of about bytes bytes. Flat programs are straight line code, the others nest IF and WHILE statements
+std::string synthetic_program(std::size_t bytes, bool nested)
+{
+    std::string source = "BEGIN\n";
+    for(int i = 0; i < 64; i++)
+        source += "LET v" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+
+    for(std::size_t block = 0; source.size() < bytes; block++)
+    {
+        std::string v = "v" + std::to_string(block % 64);
+        std::string w = "v" + std::to_string((block * 7 + 3) % 64);
+        if(!nested)
+        {
+            source += "LET " + v + " = " + w + " * 3\n"
+                      "PRINT " + v + "\n"
+                      "PRINT \"value of " + v + "\"\n"
+                      "LET " + w + " = " + v + " mod 7\n";
+            continue;
+        }
+
+        std::string indent;
+        int depth = int(block % 6) + 1;
+        for(int level = 0; level < depth; level++)
+        {
+            if(level % 2 == 0)
+                source += indent + "IF " + v + " > " + std::to_string(level) + "\n";
+            else
+                source += indent + "WHILE " + w + " < " + std::to_string(level * 10) + " REPEAT\n";
+            indent += "    ";
+        }
+        source += indent + "LET " + w + " = " + w + " + 1\n" + indent + "PRINT " + v + "\n";
+        for(int level = depth - 1; level >= 0; level--)
+        {
+            indent.resize(indent.size() - 4);
+            if(level % 2 == 0)
+                source += indent + "ELSE\n" + indent + "    PRINT \"no\"\n" + indent + "ENDIF\n";
+            else
+                source += indent + "ENDWHILE\n";
+        }
+    }
+    return source + "END\n";
+}
+
+// Translate source in memory over and over for at least min_time seconds, in rounds of about a tenth of it, and
+// keep the fastest round
+bool bench_translation(const std::string& name, const std::string& source, double min_time,
+                       std::vector<Bench_Result>& results)
+{
+    TINY::Translator translator;
+    std::ostringstream diagnostics;
+    translator.set_diagnostics(diagnostics);
+    std::string code;
+
+    auto translate_once = [&]() -> bool
+    {
+        code.clear();
+        TINY::View_Streambuf input_buffer(source.data(), source.size());
+        std::iostream input(&input_buffer);
+        TINY::String_Streambuf output_buffer(code);
+        std::ostream output(&output_buffer);
+        return translator.translate(input, output);
+    };
+
+    // Warm up, and size the rounds
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if(!translate_once())
+    {
+        std::cerr << "tiny_bench: " << name << ": " << diagnostics.str();
+        return false;
+    }
+    double once = std::max(seconds_since(start), 1e-7);
+    std::size_t per_round = std::max<std::size_t>(1, std::size_t(min_time / 10 / once));
+
+    double best = 0;
+    double total = 0;
+    std::size_t rounds = 0;
+    while(total < min_time || rounds < 3)
+    {
+        start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < per_round; i++)
+            translate_once();
+        double round = seconds_since(start) / double(per_round);
+        best = rounds == 0 ? round : std::min(best, round);
+        total += round * double(per_round);
+        rounds++;
+    }
+
+    Bench_Result result;
+    result.name = "translate/" + name;
+    result.value = double(source.size()) / best / 1e6;
+    result.unit = "MB/s";
+    result.details["bytes"] = double(source.size());
+    result.details["statements"] = double(count_statements(source));
+    result.details["statements_per_s"] = result.details["statements"] / best;
+    result.details["seconds"] = best;
+    result.details["iterations"] = double(rounds * per_round);
+    results.push_back(result);
+    return true;
+}
+
+std::string shell_quote(const std::string& text)
+{
+    std::string quoted = "'";
+    for(char c : text)
+    {
+        if(c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+}
+
+// Run a shell command, returning its duration in seconds or a negative number when it failed
+double timed_system(const std::string& command)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int status = std::system(command.c_str());
+    double seconds = seconds_since(start);
+    return status == 0 ? seconds : -1;
+}
+
+// Compile the C++ code of samples/fibonacci.txt and the hand written version, then run both on the same input
+bool bench_compiled(const Bench_Options& options, std::vector<Bench_Result>& results)
+{
+    std::string source;
+    if(!read_file(options.samples + "/fibonacci.txt", source))
+    {
+        std::cerr << "tiny_bench: cannot read " << options.samples << "/fibonacci.txt" << std::endl;
+        return false;
+    }
+
+    char directory_template[] = "/tmp/tiny_bench.XXXXXX";
+    if(!mkdtemp(directory_template))
+    {
+        std::cerr << "tiny_bench: cannot create a temporary directory" << std::endl;
+        return false;
+    }
+    std::string directory = directory_template;
+
+    bool ok = true;
+    {
+        TINY::Translator translator;
+        std::stringstream input(source);
+        std::ofstream generated(directory + "/generated.cpp");
+        ok = translator.translate(input, generated);
+    }
+    std::ofstream(directory + "/input") << "40\n";
+
+    std::string cxx = options.cxx;
+    if(cxx.empty())
+        cxx = std::getenv("CXX") ? std::getenv("CXX") : "g++";
+
+    const std::pair<const char*, std::string> programs[] = {{"generated", directory + "/generated.cpp"},
+                                                             {"handwritten", options.handwritten}};
+    std::string outputs[2];
+    for(int i = 0; ok && i < 2; i++)
+    {
+        std::string executable = directory + "/" + programs[i].first;
+        double compile = timed_system(shell_quote(cxx) + " -O2 -o " + shell_quote(executable) + " "
+                                      + shell_quote(programs[i].second));
+        if(compile < 0)
+        {
+            std::cerr << "tiny_bench: cannot compile " << programs[i].second << " with " << cxx << std::endl;
+            ok = false;
+            break;
+        }
+
+        std::string output = directory + "/" + programs[i].first + ".out";
+        std::string command = shell_quote(executable) + " < " + shell_quote(directory + "/input") + " > "
+                              + shell_quote(output);
+        double best = -1;
+        for(std::size_t run = 0; run < options.runs; run++)
+        {
+            double seconds = timed_system(command);
+            if(seconds < 0)
+            {
+                ok = false;
+                break;
+            }
+            best = best < 0 ? seconds : std::min(best, seconds);
+        }
+        read_file(output, outputs[i]);
+
+        Bench_Result compiled;
+        compiled.name = std::string("compile/") + programs[i].first;
+        compiled.value = compile;
+        compiled.unit = "s";
+        results.push_back(compiled);
+
+        Bench_Result ran;
+        ran.name = std::string("run/") + programs[i].first;
+        ran.value = best;
+        ran.unit = "s";
+        ran.details["runs"] = double(options.runs);
+        results.push_back(ran);
+    }
+
+    if(ok && outputs[0] != outputs[1])
+    {
+        std::cerr << "tiny_bench: the generated and hand written programs print different outputs" << std::endl;
+        ok = false;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+    return ok;
+}
+
+std::string results_json(const std::vector<Bench_Result>& results)
+{
+    std::string json = "{\"version\":";
+    TINY::put_json_string(json, TINY_TRANSLATOR_VERSION);
+    json += ",\"benchmarks\":[";
+    for(std::size_t i = 0; i < results.size(); i++)
+    {
+        char number[64];
+        json += i ? ",\n" : "\n";
+        json += "{\"name\":";
+        TINY::put_json_string(json, results[i].name);
+        std::snprintf(number, sizeof number, ",\"value\":%.6g,\"unit\":", results[i].value);
+        json += number;
+        TINY::put_json_string(json, results[i].unit);
+        for(const auto& detail : results[i].details)
+        {
+            json += ",";
+            TINY::put_json_string(json, detail.first);
+            std::snprintf(number, sizeof number, ":%.6g", detail.second);
+            json += number;
+        }
+        json += "}";
+    }
+    return json + "\n]}\n";
+}
+
+// Write the synthetic programs of the benchmarks to options.corpus, the training run of a PGO build
+int write_corpus(const Bench_Options& options)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(options.corpus, ec);
+    std::size_t bytes = options.synthetic_mb << 20;
+    for(bool nested : {false, true})
+    {
+        std::string path = options.corpus + (nested ? "/synthetic_nested.txt" : "/synthetic_flat.txt");
+        if(!(std::ofstream(path, std::ios::binary) << synthetic_program(bytes, nested)))
+        {
+            std::cerr << "tiny_bench: cannot write " << path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int run_benchmarks(const Bench_Options& options)
+{
+    std::vector<Bench_Result> results;
+    bool ok = true;
+
+    std::vector<std::string> samples;
+    std::error_code ec;
+    for(std::filesystem::directory_iterator entry(options.samples, ec), end; !ec && entry != end; entry.increment(ec))
+    {
+        if(entry->path().extension() == ".txt")
+            samples.push_back(entry->path().string());
+    }
+    std::sort(samples.begin(), samples.end());
+    if(samples.empty())
+        std::cerr << "tiny_bench: no samples in " << options.samples << std::endl;
+
+    for(const std::string& path : samples)
+    {
+        std::string source;
+        ok = read_file(path, source) && bench_translation(std::filesystem::path(path).stem().string(), source,
+                                                          options.min_time, results) && ok;
+    }
+
+    std::size_t bytes = options.synthetic_mb << 20;
+    ok = bench_translation("synthetic_flat", synthetic_program(bytes, false), options.min_time, results) && ok;
+    ok = bench_translation("synthetic_nested", synthetic_program(bytes, true), options.min_time, results) && ok;
+
+    if(options.compile)
+        ok = bench_compiled(options, results) && ok;
+
+    std::string json = results_json(results);
+    if(options.output.empty())
+        std::cout << json << std::flush;
+    else if(!(std::ofstream(options.output) << json))
+    {
+        std::cerr << "tiny_bench: cannot write " << options.output << std::endl;
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
+
+bool load_results(const std::string& path, std::map<std::string, Bench_Result>& results)
+{
+    std::string text;
+    if(!read_file(path, text))
+    {
+        std::cerr << "tiny_bench: cannot read " << path << std::endl;
+        return false;
+    }
+
+    try
+    {
+        TINY::Json_Value json = TINY::parse_json(text);
+        const TINY::Json_Value* benchmarks = json.find("benchmarks");
+        if(!benchmarks)
+            throw TINY::Json_Error{"no benchmarks"};
+        for(const TINY::Json_Value& benchmark : benchmarks->array)
+        {
+            const TINY::Json_Value* name = benchmark.find("name");
+            const TINY::Json_Value* value = benchmark.find("value");
+            const TINY::Json_Value* unit = benchmark.find("unit");
+            if(!name || !value || !unit)
+                throw TINY::Json_Error{"benchmark without name, value or unit"};
+
+            Bench_Result& result = results[name->string];
+            result.name = name->string;
+            result.value = value->number;
+            result.unit = unit->string;
+        }
+    }
+    catch(TINY::Json_Error& er)
+    {
+        std::cerr << "tiny_bench: " << path << ": " << er << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Compare every benchmark of the baseline to the results. A regression is a throughput lower, or a time higher, than
+// the baseline by more than the threshold
+int compare(const Bench_Options& options)
+{
+    std::map<std::string, Bench_Result> baseline;
+    std::map<std::string, Bench_Result> results;
+    if(!load_results(options.baseline, baseline) || !load_results(options.results, results))
+        return 2;
+
+    std::size_t regressions = 0;
+    std::printf("%-28s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    for(const auto& entry : baseline)
+    {
+        const Bench_Result& before = entry.second;
+        auto found = results.find(entry.first);
+        if(found == results.end())
+        {
+            std::printf("%-28s %12.4g %12s %9s  missing\n", entry.first.c_str(), before.value, "-", "-");
+            continue;
+        }
+
+        const Bench_Result& after = found->second;
+        double change = before.value != 0 ? (after.value - before.value) / before.value : 0;
+        bool higher_is_better = before.unit != "s";
+        bool regression = higher_is_better ? change < -options.threshold : change > options.threshold;
+        if(regression)
+            regressions++;
+        std::printf("%-28s %12.4g %12.4g %+8.1f%%  %s%s\n", entry.first.c_str(), before.value, after.value, 100 * change,
+                    before.unit.c_str(), regression ? "  REGRESSION" : "");
+    }
+
+    std::printf("%zu regression%s beyond %.0f%%\n", regressions, regressions == 1 ? "" : "s", 100 * options.threshold);
+    return regressions == 0 ? 0 : 1;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    Bench_Options options;
+    int status = parse_arguments(argc, argv, options);
+    if(status != 0)
+        return status < 0 ? 0 : status;
+
+    if(!options.baseline.empty())
+        return compare(options);
+    if(!options.corpus.empty())
+        return write_corpus(options);
+    return run_benchmarks(options);
+}
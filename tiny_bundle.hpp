@@ -0,0 +1,379 @@
+#ifndef TINY_BUNDLE_HPP_INCLUDED
+#define TINY_BUNDLE_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_batch.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <streambuf>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TINY
+{
+// Malformed or unreadable bundles
+using Bundle_Error = Error<6>;
+
+// A bundle stores many named programs (or their translations) in one file, so that millions of them cost one inode.
+// All integers are little endian:
+//   bundle = "TINYBNDL", u32 format version (1), then entries up to the end of the file
+//   entry  = u32 size + name, u32 size + content
+// Names are free form, the pack and unpack helpers use relative paths
+const char bundle_magic[8] = {'T', 'I', 'N', 'Y', 'B', 'N', 'D', 'L'};
+const std::uint32_t bundle_version = 1;
+
+// Input stream buffer over memory owned by someone else. The lexer puts characters back when it moves back, so the
+// memory must be writable; it is only ever given back the characters it read
+class Memory_Streambuf : public std::streambuf
+{
+ public:
+    Memory_Streambuf(char* data, std::size_t size)
+    {
+        setg(data, data, data + size);
+    }
+
+ protected:
+    int_type pbackfail(int_type c) override
+    {
+        if(traits_type::eq_int_type(c, traits_type::eof()) || gptr() == eback())
+            return traits_type::eof();
+
+        gbump(-1);
+        *gptr() = traits_type::to_char_type(c);
+        return c;
+    }
+};
+
+struct Bundle_Entry
+{
+    std::string_view name;
+    char* content;
+    std::size_t size;
+};
+
+// A bundle mapped in memory with a single mmap. The mapping is private and writable so that programs can be read
+// through Memory_Streambuf in place, nothing is ever written back to the file
+class Bundle_Reader
+{
+ protected:
+    char* data;
+    std::size_t size;
+    std::vector<Bundle_Entry> entries;
+
+ public:
+    explicit Bundle_Reader(const std::string& path) : data(nullptr), size(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            throw Bundle_Error{path + ": " + std::strerror(errno)};
+
+        struct stat info;
+        if(::fstat(fd, &info) != 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw Bundle_Error{path + ": " + std::strerror(error)};
+        }
+        size = std::size_t(info.st_size);
+
+        if(size != 0)
+        {
+            void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if(mapped == MAP_FAILED)
+            {
+                int error = errno;
+                ::close(fd);
+                throw Bundle_Error{path + ": " + std::strerror(error)};
+            }
+            data = static_cast<char*>(mapped);
+            ::madvise(data, size, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+
+        try
+        {
+            index(path);
+        }
+        catch(Bundle_Error&)
+        {
+            release();
+            throw;
+        }
+    }
+
+    Bundle_Reader(const Bundle_Reader&) = delete;
+    Bundle_Reader(Bundle_Reader&&) = delete;
+
+    ~Bundle_Reader() { release(); }
+
+    const std::vector<Bundle_Entry>& get_entries() const { return entries; }
+
+ protected:
+    void release()
+    {
+        if(data)
+            ::munmap(data, size);
+        data = nullptr;
+    }
+
+    std::uint32_t get_u32(const std::string& path, std::size_t& pos) const
+    {
+        if(size - pos < 4)
+            throw Bundle_Error{path + ": truncated bundle"};
+
+        std::uint32_t value = 0;
+        for(int i = 0; i < 4; i++)
+            value |= std::uint32_t(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        pos += 4;
+        return value;
+    }
+
+    void index(const std::string& path)
+    {
+        if(size < sizeof bundle_magic || std::memcmp(data, bundle_magic, sizeof bundle_magic) != 0)
+            throw Bundle_Error{path + ": not a bundle"};
+
+        std::size_t pos = sizeof bundle_magic;
+        if(get_u32(path, pos) != bundle_version)
+            throw Bundle_Error{path + ": unsupported bundle version"};
+
+        while(pos < size)
+        {
+            Bundle_Entry entry;
+            std::uint32_t name_size = get_u32(path, pos);
+            if(size - pos < name_size)
+                throw Bundle_Error{path + ": truncated bundle"};
+            entry.name = std::string_view(data + pos, name_size);
+            pos += name_size;
+
+            entry.size = get_u32(path, pos);
+            if(size - pos < entry.size)
+                throw Bundle_Error{path + ": truncated bundle"};
+            entry.content = data + pos;
+            pos += entry.size;
+
+            entries.push_back(entry);
+        }
+    }
+};
+
+// Appends entries to a new bundle. Entries go to a temporary file next to it, renamed over path by close(): the
+// previous bundle at path stays readable until then, so a bundle can be translated into itself
+class Bundle_Writer
+{
+ protected:
+    std::string path;
+    std::string temporary;
+    std::ofstream file;
+    std::vector<char> buffer;
+    bool closed;
+
+ public:
+    explicit Bundle_Writer(const std::string& path)
+        : path(path), temporary(path + "." + std::to_string(::getpid()) + ".tmp"), buffer(1 << 20), closed(false)
+    {
+        file.rdbuf()->pubsetbuf(buffer.data(), std::streamsize(buffer.size()));
+        file.open(temporary, std::ios::binary | std::ios::trunc);
+        if(!file)
+            throw Bundle_Error{path + ": cannot create"};
+
+        file.write(bundle_magic, sizeof bundle_magic);
+        put_u32(bundle_version);
+    }
+
+    void add(std::string_view name, std::string_view content)
+    {
+        put_u32(std::uint32_t(name.size()));
+        file.write(name.data(), std::streamsize(name.size()));
+        put_u32(std::uint32_t(content.size()));
+        file.write(content.data(), std::streamsize(content.size()));
+    }
+
+    Bundle_Writer(const Bundle_Writer&) = delete;
+
+    // A bundle that was not closed is left out
+    ~Bundle_Writer()
+    {
+        if(!closed)
+        {
+            file.close();
+            ::unlink(temporary.c_str());
+        }
+    }
+
+    void close()
+    {
+        file.close();
+        closed = true;
+        if(!file)
+        {
+            ::unlink(temporary.c_str());
+            throw Bundle_Error{path + ": write failed"};
+        }
+        if(::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            int error = errno;
+            ::unlink(temporary.c_str());
+            throw Bundle_Error{path + ": cannot replace: " + std::strerror(error)};
+        }
+    }
+
+ protected:
+    void put_u32(std::uint32_t value)
+    {
+        char bytes[4];
+        for(int i = 0; i < 4; i++)
+            bytes[i] = char((value >> (8 * i)) & 0xff);
+        file.write(bytes, 4);
+    }
+};
+
+// Translate every program of a bundle into an output bundle holding the C++ code of each program that translated,
+// under the same name. Diagnostics are keyed by program name (File_Result::path). Programs are translated in memory on
+// the scheduler, a group at a time so that the outputs waiting to be written stay bounded; the output bundle keeps the
+// order of the input bundle. With check_only no output bundle is written
+inline Batch_Result translate_bundle(const std::string& input, const std::string& output,
+                                     const Batch_Options& options = Batch_Options())
+{
+    const std::size_t group_size = 1 << 14; // Programs translated before their outputs are written
+    const std::size_t task_size = 64;       // Programs per task, tiny programs take less time than scheduling them
+
+    Bundle_Reader reader(input);
+    const std::vector<Bundle_Entry>& entries = reader.get_entries();
+
+    std::unique_ptr<Bundle_Writer> writer;
+    if(!options.check_only)
+        writer.reset(new Bundle_Writer(output));
+
+    Batch_Result batch;
+    batch.files.resize(entries.size());
+
+    std::size_t workers = options.jobs == 0 ? Work_Stealing_Scheduler::default_size() : options.jobs;
+    Work_Stealing_Scheduler scheduler(std::min(workers, std::max<std::size_t>(entries.size() / task_size, 1)));
+
+    std::vector<std::string> outputs(std::min(group_size, entries.size()));
+    for(std::size_t first = 0; first < entries.size(); first += group_size)
+    {
+        std::size_t count = std::min(group_size, entries.size() - first);
+
+        std::vector<std::pair<std::uint64_t, Work_Stealing_Scheduler::Task>> tasks;
+        for(std::size_t begin = 0; begin < count; begin += task_size)
+        {
+            std::size_t end = std::min(begin + task_size, count);
+            std::uint64_t cost = 0;
+            for(std::size_t i = begin; i < end; i++)
+                cost += entries[first + i].size;
+
+            tasks.emplace_back(cost, [&, first, begin, end]
+            {
+                Translator& translator = worker_translator();
+                Profiling_Scope profiling(translator, options.profile);
+                std::ostringstream diagnostics;
+                translator.set_diagnostics(diagnostics);
+
+                for(std::size_t i = begin; i < end; i++)
+                {
+                    const Bundle_Entry& entry = entries[first + i];
+                    File_Result& result = batch.files[first + i];
+                    result.path.assign(entry.name);
+
+                    Memory_Streambuf source(entry.content, entry.size);
+                    std::iostream program(&source);
+                    std::ostringstream code;
+                    result.ok = translator.translate(program, code);
+
+                    if(result.ok && !options.check_only)
+                        outputs[i] = code.str();
+                    else
+                        outputs[i].clear();
+
+                    result.diagnostics = diagnostics.str();
+                    diagnostics.str(std::string());
+                }
+
+                translator.set_diagnostics(std::cerr);
+            });
+        }
+        scheduler.seed(std::move(tasks));
+        scheduler.wait();
+
+        if(writer)
+        {
+            for(std::size_t i = 0; i < count; i++)
+            {
+                if(batch.files[first + i].ok)
+                    writer->add(entries[first + i].name, outputs[i]);
+            }
+        }
+    }
+
+    if(writer)
+        writer->close();
+
+    batch.workers = scheduler.stats();
+    for(const File_Result& result : batch.files)
+    {
+        if(!result.ok)
+            batch.failed++;
+    }
+    return batch;
+}
+
+// Store files in a new bundle, each under its path as given
+inline void pack_bundle(const std::vector<std::string>& paths, const std::string& bundle)
+{
+    Bundle_Writer writer(bundle);
+    for(const std::string& path : paths)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+            throw Bundle_Error{path + ": cannot read"};
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        writer.add(path, content);
+    }
+    writer.close();
+}
+
+// Write every entry of a bundle to directory/name, creating subdirectories as needed. Names leaving the directory
+// (absolute, or going through "..") are refused. Returns the number of files written
+inline std::size_t unpack_bundle(const std::string& bundle, const std::string& directory)
+{
+    namespace fs = std::filesystem;
+
+    Bundle_Reader reader(bundle);
+    std::size_t written = 0;
+    for(const Bundle_Entry& entry : reader.get_entries())
+    {
+        fs::path name(std::string(entry.name));
+        if(name.empty() || name.is_absolute() || std::find(name.begin(), name.end(), "..") != name.end())
+            throw Bundle_Error{bundle + ": refusing to unpack " + name.string()};
+
+        fs::path path = fs::path(directory) / name;
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(entry.content, std::streamsize(entry.size));
+        if(!file.flush())
+            throw Bundle_Error{path.string() + ": cannot write"};
+        written++;
+    }
+    return written;
+}
+}
+
+#endif // TINY_BUNDLE_HPP_INCLUDED
@@ -0,0 +1,64 @@
+#ifndef TINY_BYTECODE_HPP_INCLUDED
+#define TINY_BYTECODE_HPP_INCLUDED
+
+// Bytecode of the TINY virtual machine, shared by the VM (tiny_vm.hpp) and the compile time compiler
+// (tiny_constexpr.hpp), which must not depend on the streams of the translator
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace TINY
+{
+// Operations of the TINY virtual machine. Operands are evaluated on a stack
+enum class Op : unsigned char {
+    PUSH,           // push constants[operand]
+    LOAD,           // push variables[operand]
+    STORE,          // pop into variables[operand], converted to int as in the generated C++
+    ADD, SUB, MUL, DIV, MOD,
+    GREATER, LESS, EQUAL, GREATER_EQUAL, LESS_EQUAL,
+    JUMP,           // continue at code[operand]
+    JUMP_IF_FALSE,  // pop, continue at code[operand] when zero
+    PRINT_STRING,   // write strings[operand]
+    PRINT,          // pop and write
+    INPUT,          // read an int into variables[operand]
+    HALT
+};
+
+struct Instruction
+{
+    Op op;
+    std::uint32_t operand;
+};
+
+// Value on the stack. Variables are always int, literals and arithmetic involving a floating literal are double,
+// following the usual arithmetic conversions of the generated C++
+struct Value
+{
+    bool real = false;
+    std::int64_t integer = 0;
+    double number = 0;
+
+    double as_real() const { return real ? number : double(integer); }
+};
+
+// Compiled program
+struct Bytecode
+{
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<std::string> strings;
+    std::vector<std::string> variables; // Names of the variable slots
+
+    void clear()
+    {
+        code.clear();
+        constants.clear();
+        strings.clear();
+        variables.clear();
+    }
+};
+
+}
+
+#endif // TINY_BYTECODE_HPP_INCLUDED
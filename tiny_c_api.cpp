@@ -0,0 +1,183 @@
+// Implementation of the C interface (tiny_c_api.h) over the header only translator and VM.
+// Build it into a static library, for instance:
+//     g++ -std=c++17 -O2 -fPIC -c tiny_c_api.cpp && ar rcs libtiny.a tiny_c_api.o
+
+#include "tiny_c_api.h"
+
+#include "tiny_language (1).hpp"
+#include "tiny_vm.hpp"
+#include "tiny_stream.hpp"
+
+#include <string>
+#include <istream>
+#include <ostream>
+#include <new>
+#include <exception>
+
+struct tiny_context
+{
+    TINY::Translator translator;
+    TINY::Compiler compiler;
+    TINY::VM vm;
+    TINY::Bytecode code;
+
+    std::string output;
+    std::string diagnostics;
+    TINY::String_Streambuf diagnostics_buffer;
+    std::ostream diagnostics_stream;
+
+    tiny_context() : diagnostics_buffer(diagnostics), diagnostics_stream(&diagnostics_buffer)
+    {
+        translator.set_diagnostics(diagnostics_stream);
+        compiler.set_diagnostics(diagnostics_stream);
+        vm.set_diagnostics(diagnostics_stream);
+    }
+};
+
+namespace
+{
+// Run one call: reset the results, and keep every exception on the C++ side
+template<class Body>
+tiny_status guarded(tiny_context* context, Body body)
+{
+    if(!context)
+        return TINY_ERROR_ARGUMENT;
+
+    try
+    {
+        context->output.clear();
+        context->diagnostics.clear();
+        context->diagnostics_stream.clear();
+        return body();
+    }
+    catch(std::bad_alloc&)
+    {
+        return TINY_ERROR_MEMORY;
+    }
+    catch(std::exception& er)
+    {
+        context->diagnostics = std::string("Internal Error: ") + er.what() + "\n";
+        return TINY_ERROR_INTERNAL;
+    }
+    catch(...)
+    {
+        context->diagnostics = "Internal Error\n";
+        return TINY_ERROR_INTERNAL;
+    }
+}
+
+void give_output(const tiny_context* context, const char** output, size_t* output_size)
+{
+    if(output)
+        *output = context->output.c_str();
+    if(output_size)
+        *output_size = context->output.size();
+}
+}
+
+extern "C" {
+
+const char* tiny_version(void)
+{
+    return TINY_TRANSLATOR_VERSION;
+}
+
+tiny_context* tiny_context_create(void)
+{
+    try
+    {
+        return new tiny_context();
+    }
+    catch(...)
+    {
+        return nullptr;
+    }
+}
+
+void tiny_context_destroy(tiny_context* context)
+{
+    delete context;
+}
+
+void tiny_set_step_limit(tiny_context* context, uint64_t limit)
+{
+    if(context)
+        context->vm.set_step_limit(limit);
+}
+
+tiny_status tiny_translate(tiny_context* context, const char* source, size_t size,
+                           const char** output, size_t* output_size)
+{
+    if(!source && size != 0)
+        return TINY_ERROR_ARGUMENT;
+
+    return guarded(context, [&]
+    {
+        TINY::View_Streambuf source_buffer(source, size);
+        std::iostream input(&source_buffer);
+        TINY::String_Streambuf output_buffer(context->output);
+        std::ostream code(&output_buffer);
+
+        if(!context->translator.translate(input, code))
+        {
+            context->output.clear();
+            return TINY_ERROR_PROGRAM;
+        }
+        give_output(context, output, output_size);
+        return TINY_OK;
+    });
+}
+
+tiny_status tiny_check(tiny_context* context, const char* source, size_t size)
+{
+    if(!source && size != 0)
+        return TINY_ERROR_ARGUMENT;
+
+    return guarded(context, [&]
+    {
+        TINY::View_Streambuf source_buffer(source, size);
+        std::iostream input(&source_buffer);
+        std::ostream discard(nullptr);
+
+        return context->translator.translate(input, discard) ? TINY_OK : TINY_ERROR_PROGRAM;
+    });
+}
+
+tiny_status tiny_run(tiny_context* context, const char* source, size_t size, const char* input, size_t input_size,
+                     const char** output, size_t* output_size)
+{
+    if((!source && size != 0) || (!input && input_size != 0))
+        return TINY_ERROR_ARGUMENT;
+
+    return guarded(context, [&]
+    {
+        TINY::View_Streambuf source_buffer(source, size);
+        std::iostream program(&source_buffer);
+        if(!context->compiler.compile(program, context->code))
+            return TINY_ERROR_PROGRAM;
+
+        TINY::View_Streambuf input_buffer(input, input_size);
+        std::istream program_input(&input_buffer);
+        TINY::String_Streambuf output_buffer(context->output);
+        std::ostream program_output(&output_buffer);
+
+        bool ok = context->vm.run(context->code, program_input, program_output);
+        give_output(context, output, output_size);
+        return ok ? TINY_OK : TINY_ERROR_RUNTIME;
+    });
+}
+
+const char* tiny_diagnostics(const tiny_context* context, size_t* size)
+{
+    if(!context)
+    {
+        if(size)
+            *size = 0;
+        return "";
+    }
+    if(size)
+        *size = context->diagnostics.size();
+    return context->diagnostics.c_str();
+}
+
+}
@@ -0,0 +1,66 @@
+/* C interface to the TINY translator and VM, for embedding in C programs and in other languages through their FFI.
+ *
+ * Everything goes through a context: programs and inputs are read from caller memory and results are returned as
+ * pointers into the context, valid until the next call on the same context (or its destruction). Nothing is read from
+ * or written to files or the standard streams. A context is not thread safe; use one per thread.
+ *
+ *     tiny_context* context = tiny_context_create();
+ *     const char* code;
+ *     size_t code_size;
+ *     if(tiny_translate(context, source, source_size, &code, &code_size) != TINY_OK)
+ *         fprintf(stderr, "%s", tiny_diagnostics(context, NULL));
+ *     tiny_context_destroy(context);
+ */
+
+#ifndef TINY_C_API_H_INCLUDED
+#define TINY_C_API_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tiny_context tiny_context;
+
+typedef enum tiny_status
+{
+    TINY_OK = 0,
+    TINY_ERROR_PROGRAM = 1,   /* Lexical or syntax error in the program, see tiny_diagnostics */
+    TINY_ERROR_RUNTIME = 2,   /* The program failed while running (division by zero, step limit...) */
+    TINY_ERROR_ARGUMENT = 3,  /* NULL context, or NULL pointer with a non zero size */
+    TINY_ERROR_MEMORY = 4,    /* Out of memory */
+    TINY_ERROR_INTERNAL = 5   /* Anything else, see tiny_diagnostics */
+} tiny_status;
+
+/* Version of the translator, as in the generated code */
+const char* tiny_version(void);
+
+/* NULL when out of memory */
+tiny_context* tiny_context_create(void);
+void tiny_context_destroy(tiny_context* context);
+
+/* Instructions a program run may execute, 0 (the default) for no limit */
+void tiny_set_step_limit(tiny_context* context, uint64_t limit);
+
+/* Translate source[0..size) to C++. On TINY_OK, *output and *output_size (either may be NULL) receive the code */
+tiny_status tiny_translate(tiny_context* context, const char* source, size_t size,
+                           const char** output, size_t* output_size);
+
+/* Only look for errors */
+tiny_status tiny_check(tiny_context* context, const char* source, size_t size);
+
+/* Run a program on the bytecode VM with input[0..input_size) as its standard input. *output receives what the
+ * program printed, also when it failed while running */
+tiny_status tiny_run(tiny_context* context, const char* source, size_t size, const char* input, size_t input_size,
+                     const char** output, size_t* output_size);
+
+/* Messages of the last call, one per line, NUL terminated. Empty after a call that succeeded */
+const char* tiny_diagnostics(const tiny_context* context, size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TINY_C_API_H_INCLUDED */
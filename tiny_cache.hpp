@@ -0,0 +1,117 @@
+#ifndef TINY_CACHE_HPP_INCLUDED
+#define TINY_CACHE_HPP_INCLUDED
+
+#include "tiny_hash.hpp"
+
+#include <string>
+#include <list>
+#include <iterator>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+namespace TINY
+{
+// Thread safe least recently used cache of values computed from a key text (typically a source program)
+// Entries are found by the hash of the key and the full key is compared, so a hash collision is only a miss.
+// Values are shared and immutable, a caller keeps a found value alive even if it is evicted meanwhile
+template<class T>
+class Content_Cache
+{
+ protected:
+    struct Entry
+    {
+        std::string key;
+        std::shared_ptr<const T> value;
+        std::size_t bytes;
+    };
+
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_multimap<std::uint64_t, typename std::list<Entry>::iterator> index;
+
+    std::size_t capacity; // Bytes of keys and values kept at most
+    std::size_t used;
+
+    std::size_t hits;
+    std::size_t misses;
+
+    mutable std::mutex cache_mutex;
+
+ public:
+    explicit Content_Cache(std::size_t capacity_bytes) : capacity(capacity_bytes), used(0), hits(0), misses(0) {}
+
+    Content_Cache(const Content_Cache&) = delete;
+    Content_Cache(Content_Cache&&) = delete;
+
+    // Value stored for key, or nullptr
+    std::shared_ptr<const T> find(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+
+        auto range = index.equal_range(content_hash(key));
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(it->second->key == key)
+            {
+                entries.splice(entries.begin(), entries, it->second);
+                hits++;
+                return it->second->value;
+            }
+        }
+
+        misses++;
+        return nullptr;
+    }
+
+    // Store value for key, bytes being the approximate size of the value. Values larger than the cache are not kept
+    void insert(const std::string& key, std::shared_ptr<const T> value, std::size_t bytes)
+    {
+        bytes += key.size();
+        if(bytes > capacity)
+            return;
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+
+        std::uint64_t hash = content_hash(key);
+        auto range = index.equal_range(hash);
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(it->second->key == key)
+                return; // Computed concurrently by someone else
+        }
+
+        while(used + bytes > capacity)
+            evict();
+
+        entries.push_front(Entry{key, std::move(value), bytes});
+        index.emplace(hash, entries.begin());
+        used += bytes;
+    }
+
+    std::size_t get_hits() const { std::lock_guard<std::mutex> lock(cache_mutex); return hits; }
+    std::size_t get_misses() const { std::lock_guard<std::mutex> lock(cache_mutex); return misses; }
+
+ private:
+    void evict()
+    {
+        const Entry& oldest = entries.back();
+
+        auto range = index.equal_range(content_hash(oldest.key));
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(it->second == std::prev(entries.end()))
+            {
+                index.erase(it);
+                break;
+            }
+        }
+
+        used -= oldest.bytes;
+        entries.pop_back();
+    }
+};
+}
+
+#endif // TINY_CACHE_HPP_INCLUDED
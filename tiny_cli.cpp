@@ -0,0 +1,898 @@
+// Command line driver: translate many TINY sources (files, directories or glob patterns) concurrently
+//
+// Usage: tiny [options] <file|directory|pattern>...
+//        tiny --run <file>
+//        tiny --profile-report <file> [profile]
+//        tiny - (or --fd N) < program.txt > program.cpp
+//        tiny --bundle <bundle> [-o <bundle>]
+//        tiny --pack <bundle> <file|directory|pattern>... | tiny --unpack <bundle> <directory>
+//        tiny --json [--ordered] < requests.jsonl > responses.jsonl
+//        tiny --watch <file|directory|pattern>...
+//        tiny --serve <socket>
+//
+// Exit status: 0 when every file was translated, 1 when at least one failed, 2 on usage errors
+
+#include "tiny_batch.hpp"
+#include "tiny_vm.hpp"
+#include "tiny_daemon.hpp"
+#include "tiny_manifest.hpp"
+#include "tiny_stream.hpp"
+#include "tiny_io.hpp"
+#include "tiny_watch.hpp"
+#include "tiny_bundle.hpp"
+#include "tiny_json.hpp"
+#include "tiny_shard.hpp"
+#include "tiny_profile.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <csignal>
+
+namespace
+{
+void usage(std::ostream& out)
+{
+    out << "Usage: tiny [options] <file|directory|pattern>...\n"
+        << "       tiny [--connect SOCKET] --run <file>\n"
+        << "       tiny --profile-report <file> [profile]\n"
+        << "       tiny [--fd N | -] > program.cpp\n"
+        << "       tiny [options] --bundle BUNDLE [-o BUNDLE]\n"
+        << "       tiny --pack BUNDLE <file|directory|pattern>...\n"
+        << "       tiny --unpack BUNDLE DIRECTORY\n"
+        << "       tiny --json [options] < requests.jsonl\n"
+        << "       tiny --watch [options] <file|directory|pattern>...\n"
+        << "       tiny --serve SOCKET\n"
+        << "Translate TINY sources (.txt) to C++ (.cpp next to each input)\n"
+        << "\n"
+        << "Options:\n"
+        << "  -j, --jobs N          number of worker threads (default: one per core)\n"
+        << "      --check           only report errors, do not write any output\n"
+        << "      --run             run one program, reading its input from stdin\n"
+        << "  -,   --fd N           translate the program read from stdin (or file descriptor N) to stdout\n"
+        << "  -p, --processes N     translate in N worker processes sharing a result cache instead of threads\n"
+        << "      --parallel-lex    split large files at top level statements and translate the pieces in parallel\n"
+        << "      --chunk-size N    approximate piece size in bytes for --parallel-lex (default: 262144)\n"
+        << "      --io BACKEND      file access for the batch: fstream (default), posix or uring\n"
+        << "      --io-report       print the system calls and time spent by the file access\n"
+        << "      --memory-budget N hold files back while their estimated memory would exceed N bytes (K, M, G suffixes)\n"
+        << "      --time-report[=json]  print the wall and CPU time of each phase, per file and for the batch\n"
+        << "      --perf-counters   add cycles, instructions, branch and cache misses to the time report (Linux)\n"
+        << "      --profile[=count] write code counting and timing the executions of each TINY line\n"
+        << "      --profile=sample  write code sampling the running TINY line, saved as folded stacks\n"
+        << "      --profile-report  print a program annotated with the profile its code wrote\n"
+        << "      --trace FILE      write the spans of each file's phases on each worker as Chrome trace events\n"
+        << "      --trace-min-us N  leave out of the trace the spans shorter than N microseconds (default: 10)\n"
+        << "      --alloc-report[=json] print the allocations of the translator by phase, per file and for the batch\n"
+        << "      --memory-report[=json] print the peak memory of the source, tokens, parse state, symbols and code\n"
+        << "      --utilization     print how busy each worker was at the end of the batch\n"
+        << "      --incremental     only translate inputs changed since the last incremental build\n"
+        << "      --manifest FILE   record of the incremental builds (default: .tiny-manifest)\n"
+        << "      --bundle FILE     translate every program of a bundle into an output bundle\n"
+        << "  -o, --output FILE     output bundle (default: the input bundle name ending in .cpp.tinyb)\n"
+        << "      --pack FILE       store the given sources in a new bundle\n"
+        << "      --unpack FILE     write every program of a bundle below the given directory\n"
+        << "      --json            answer JSON requests read from stdin, one per line (see tiny_json.hpp)\n"
+        << "      --ordered         with --json, answer in request order\n"
+        << "      --window N        with --json, requests handled ahead of the oldest unanswered one (default: 256)\n"
+        << "      --watch           keep running and translate again every input saved afterwards\n"
+        << "      --debounce MS     with --watch, wait for MS milliseconds without changes first (default: 5)\n"
+        << "      --serve SOCKET    run as a daemon answering requests on a UNIX domain socket\n"
+        << "      --connect SOCKET  send the work to the daemon listening on SOCKET\n"
+        << "      --shutdown        with --connect, stop the daemon\n"
+        << "      --step-limit N    stop programs run by the daemon or --json after N instructions (default: 100000000)\n"
+        << "  -q, --quiet           do not print the summary line\n"
+        << "  -h, --help            show this help\n";
+}
+
+// Parse a strictly positive count, return 0 on error
+std::size_t parse_count(const std::string& text)
+{
+    char* end = nullptr;
+    unsigned long value = std::strtoul(text.c_str(), &end, 10);
+    if(text.empty() || *end != '\0')
+        return 0;
+    return value;
+}
+
+// Parse a strictly positive size in bytes with an optional K, M or G suffix, return 0 on error
+std::size_t parse_size(const std::string& text)
+{
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if(text.empty() || end == text.c_str())
+        return 0;
+
+    std::string suffix = end;
+    if(suffix == "K" || suffix == "k")
+        value <<= 10;
+    else if(suffix == "M" || suffix == "m")
+        value <<= 20;
+    else if(suffix == "G" || suffix == "g")
+        value <<= 30;
+    else if(!suffix.empty())
+        return 0;
+    return std::size_t(value);
+}
+
+struct Cli_Options
+{
+    TINY::Batch_Options batch;
+    bool quiet = false;
+    bool utilization = false;
+    bool run = false;
+    bool shutdown = false;
+    bool incremental = false;
+    bool io_report = false;
+    bool time_json = false;
+    bool alloc_json = false;
+    bool memory_json = false;
+    std::string trace;         // Chrome trace events file
+    bool profile_report = false;
+    double trace_min_us = 10;
+    bool watch = false;
+    std::size_t processes = 0; // Sharded translation in worker processes when set
+    bool json = false;
+    bool ordered = false;
+    std::size_t window = 256;
+    std::string bundle;
+    std::string output;
+    std::string pack;
+    std::string unpack;
+    std::size_t debounce_ms = 5;
+    TINY::Io_Backend io = TINY::Io_Backend::FSTREAM;
+    std::string manifest = ".tiny-manifest";
+    std::string serve_socket;
+    std::string connect_socket;
+    std::size_t step_limit = TINY::Daemon_Options().step_limit;
+    int input_fd = -1; // Streaming translation from this descriptor when set
+    std::vector<std::string> operands;
+};
+
+// Option choosing another driver than translate_batch for the operands, nullptr for translate_batch itself (also
+// behind --io-report). Only translate_batch measures files (translate_timed) and applies the memory budget
+const char* batch_driver(const Cli_Options& options)
+{
+    return !options.connect_socket.empty()           ? "--connect"
+           : options.processes != 0                  ? "--processes"
+           : options.incremental                     ? "--incremental"
+           : options.io != TINY::Io_Backend::FSTREAM ? "--io"
+           : !options.bundle.empty()                 ? "--bundle"
+           : options.watch                           ? "--watch"
+           : options.json                            ? "--json"
+           : options.input_fd >= 0                   ? "- or --fd"
+                                                     : nullptr;
+}
+
+// Returns 0 when the command line is valid, -1 when nothing is left to do, otherwise the exit status to use
+int parse_arguments(int argc, char* argv[], Cli_Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        // Value of an option taking one
+        auto value = [&](std::string& text) -> bool
+        {
+            if(i + 1 == argc)
+            {
+                std::cerr << "tiny: " << arg << " expects a value" << std::endl;
+                return false;
+            }
+            text = argv[++i];
+            return true;
+        };
+        auto count = [&](std::size_t& number) -> bool
+        {
+            std::string text;
+            if(!value(text))
+                return false;
+            if((number = parse_count(text)) == 0)
+            {
+                std::cerr << "tiny: " << arg << " expects a positive number" << std::endl;
+                return false;
+            }
+            return true;
+        };
+
+        if(arg == "-h" || arg == "--help")
+        {
+            usage(std::cout);
+            return -1;
+        }
+        else if(arg == "-q" || arg == "--quiet")
+            options.quiet = true;
+        else if(arg == "--time-report" || arg == "--time-report=table")
+            options.batch.time_report = true;
+        else if(arg == "--time-report=json")
+            options.batch.time_report = options.time_json = true;
+        else if(arg == "--perf-counters")
+            options.batch.time_report = options.batch.perf_counters = true;
+        else if(arg == "--profile" || arg == "--profile=count")
+            options.batch.profile = TINY::Translator::Profile_Mode::COUNT;
+        else if(arg == "--profile=sample")
+            options.batch.profile = TINY::Translator::Profile_Mode::SAMPLE;
+        else if(arg == "--profile-report")
+            options.profile_report = true;
+        else if(arg == "--trace")
+        {
+            if(!value(options.trace))
+                return 2;
+        }
+        else if(arg == "--trace-min-us")
+        {
+            std::string text;
+            if(!value(text))
+                return 2;
+            char* end = nullptr;
+            options.trace_min_us = std::strtod(text.c_str(), &end);
+            if(text.empty() || *end != '\0' || !(options.trace_min_us >= 0))
+            {
+                std::cerr << "tiny: " << arg << " expects a number of microseconds" << std::endl;
+                return 2;
+            }
+        }
+        else if(arg == "--alloc-report" || arg == "--alloc-report=table")
+            options.batch.alloc_report = true;
+        else if(arg == "--alloc-report=json")
+            options.batch.alloc_report = options.alloc_json = true;
+        else if(arg == "--memory-report" || arg == "--memory-report=table")
+            options.batch.memory_report = true;
+        else if(arg == "--memory-report=json")
+            options.batch.memory_report = options.memory_json = true;
+        else if(arg == "--utilization")
+            options.utilization = true;
+        else if(arg == "--parallel-lex")
+            options.batch.parallel_lex = true;
+        else if(arg == "--check")
+            options.batch.check_only = true;
+        else if(arg == "--run")
+            options.run = true;
+        else if(arg == "--shutdown")
+            options.shutdown = true;
+        else if(arg == "--incremental")
+            options.incremental = true;
+        else if(arg == "--json")
+            options.json = true;
+        else if(arg == "--ordered")
+            options.ordered = true;
+        else if(arg == "--window")
+        {
+            if(!count(options.window))
+                return 2;
+        }
+        else if(arg == "--bundle")
+        {
+            if(!value(options.bundle))
+                return 2;
+        }
+        else if(arg == "-o" || arg == "--output")
+        {
+            if(!value(options.output))
+                return 2;
+        }
+        else if(arg == "--pack")
+        {
+            if(!value(options.pack))
+                return 2;
+        }
+        else if(arg == "--unpack")
+        {
+            if(!value(options.unpack))
+                return 2;
+        }
+        else if(arg == "--watch")
+            options.watch = true;
+        else if(arg == "--debounce")
+        {
+            if(!count(options.debounce_ms))
+                return 2;
+        }
+        else if(arg == "--io-report")
+            options.io_report = true;
+        else if(arg == "--io")
+        {
+            std::string text;
+            if(!value(text))
+                return 2;
+            if(text == "fstream")
+                options.io = TINY::Io_Backend::FSTREAM;
+            else if(text == "posix")
+                options.io = TINY::Io_Backend::POSIX;
+            else if(text == "uring" || text == "io_uring")
+                options.io = TINY::Io_Backend::URING;
+            else
+            {
+                std::cerr << "tiny: --io expects fstream, posix or uring" << std::endl;
+                return 2;
+            }
+        }
+        else if(arg == "--manifest")
+        {
+            if(!value(options.manifest))
+                return 2;
+        }
+        else if(arg == "-j" || arg == "--jobs")
+        {
+            if(!count(options.batch.jobs))
+                return 2;
+        }
+        else if(arg.size() > 2 && arg.compare(0, 2, "-j") == 0)
+        {
+            if((options.batch.jobs = parse_count(arg.substr(2))) == 0)
+            {
+                std::cerr << "tiny: -j expects a positive number" << std::endl;
+                return 2;
+            }
+        }
+        else if(arg == "--chunk-size")
+        {
+            if(!count(options.batch.chunk_bytes))
+                return 2;
+        }
+        else if(arg == "-p" || arg == "--processes")
+        {
+            if(!count(options.processes))
+                return 2;
+        }
+        else if(arg == "--memory-budget")
+        {
+            std::string text;
+            if(!value(text))
+                return 2;
+            if((options.batch.memory_budget = parse_size(text)) == 0)
+            {
+                std::cerr << "tiny: --memory-budget expects a positive size" << std::endl;
+                return 2;
+            }
+        }
+        else if(arg == "--step-limit")
+        {
+            if(!count(options.step_limit))
+                return 2;
+        }
+        else if(arg == "--serve")
+        {
+            if(!value(options.serve_socket))
+                return 2;
+        }
+        else if(arg == "--connect")
+        {
+            if(!value(options.connect_socket))
+                return 2;
+        }
+        else if(arg == "-")
+            options.input_fd = 0;
+        else if(arg == "--fd")
+        {
+            std::string text;
+            if(!value(text))
+                return 2;
+            char* end = nullptr;
+            long fd = std::strtol(text.c_str(), &end, 10);
+            if(text.empty() || *end != '\0' || fd < 0)
+            {
+                std::cerr << "tiny: --fd expects a file descriptor" << std::endl;
+                return 2;
+            }
+            options.input_fd = int(fd);
+        }
+        else if(arg == "--")
+        {
+            options.operands.insert(options.operands.end(), argv + i + 1, argv + argc);
+            break;
+        }
+        else if(arg.size() > 1 && arg[0] == '-')
+        {
+            std::cerr << "tiny: unknown option " << arg << std::endl;
+            usage(std::cerr);
+            return 2;
+        }
+        else
+            options.operands.push_back(arg);
+    }
+
+    // The daemon, the interpreter and the streaming translators write uninstrumented code
+    if(options.batch.profile != TINY::Translator::Profile_Mode::NONE)
+    {
+        const char* mode = !options.connect_socket.empty() ? "--connect"
+                           : options.run                   ? "--run"
+                           : options.input_fd >= 0         ? "- or --fd"
+                           : options.json                  ? "--json"
+                                                           : nullptr;
+        if(mode)
+        {
+            std::cerr << "tiny: --profile cannot be used with " << mode << std::endl;
+            return 2;
+        }
+    }
+
+    // The incremental driver has no check mode and does its own file access; rather than running another driver
+    if(options.incremental)
+    {
+        const char* mode = options.batch.check_only                ? "--check"
+                           : options.io != TINY::Io_Backend::FSTREAM ? "--io"
+                           : options.io_report                       ? "--io-report"
+                           : options.processes != 0                  ? "--processes"
+                           : !options.connect_socket.empty()         ? "--connect"
+                                                                     : nullptr;
+        if(mode)
+        {
+            std::cerr << "tiny: --incremental cannot be used with " << mode << std::endl;
+            return 2;
+        }
+    }
+
+    // --run times its own phases, the other drivers would print a table of zeros
+    if(options.batch.time_report && !options.run)
+    {
+        if(const char* driver = batch_driver(options))
+        {
+            std::cerr << "tiny: --time-report cannot be used with " << driver << std::endl;
+            return 2;
+        }
+    }
+    if(options.batch.alloc_report)
+    {
+        if(const char* driver = options.run ? "--run" : batch_driver(options))
+        {
+            std::cerr << "tiny: --alloc-report cannot be used with " << driver << std::endl;
+            return 2;
+        }
+    }
+    if(options.batch.memory_report)
+    {
+        if(const char* driver = options.run ? "--run" : batch_driver(options))
+        {
+            std::cerr << "tiny: --memory-report cannot be used with " << driver << std::endl;
+            return 2;
+        }
+    }
+    if(options.batch.memory_budget != 0)
+    {
+        if(const char* driver = options.run ? "--run" : batch_driver(options))
+        {
+            std::cerr << "tiny: --memory-budget cannot be used with " << driver << std::endl;
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+int serve(const Cli_Options& options)
+{
+    TINY::Daemon_Options daemon_options;
+    daemon_options.step_limit = options.step_limit;
+
+    try
+    {
+        TINY::Daemon daemon(options.serve_socket, daemon_options);
+        daemon.listen();
+        daemon.serve();
+    }
+    catch(TINY::Connection_Error& er)
+    {
+        std::cerr << "tiny: " << er << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int shutdown(const Cli_Options& options)
+{
+    try
+    {
+        TINY::Daemon_Client client(options.connect_socket);
+        TINY::Request request;
+        request.kind = TINY::Request_Kind::SHUTDOWN;
+        client.call(request);
+    }
+    catch(TINY::Connection_Error& er)
+    {
+        std::cerr << "tiny: " << er << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Translate the program read from a descriptor to stdout. Every statement is written and flushed as soon as it is
+// parsed, so a consumer can start before the input ends. On error, what was already written stays written
+int stream(const Cli_Options& options)
+{
+    TINY::Fd_Streambuf buffer(options.input_fd);
+    std::iostream input(&buffer);
+
+    TINY::Translator translator;
+    return translator.translate(input, std::cout) ? 0 : 1;
+}
+
+// Answer JSON line requests on stdin/stdout
+int json_lines(const Cli_Options& options)
+{
+    std::ios::sync_with_stdio(false);
+
+    TINY::Json_Lines_Options json_options;
+    json_options.jobs = options.batch.jobs;
+    json_options.window = options.window;
+    json_options.ordered = options.ordered;
+    json_options.engine.step_limit = options.step_limit;
+
+    TINY::serve_json_lines(std::cin, std::cout, json_options);
+    return 0;
+}
+
+// Translate a bundle into an output bundle, or pack and unpack bundles
+int bundle(const Cli_Options& options)
+{
+    try
+    {
+        if(!options.unpack.empty())
+        {
+            if(options.operands.size() != 1)
+            {
+                std::cerr << "tiny: --unpack expects exactly one directory" << std::endl;
+                return 2;
+            }
+            std::size_t written = TINY::unpack_bundle(options.unpack, options.operands[0]);
+            if(!options.quiet)
+                std::cerr << "tiny: unpacked " << written << " files" << std::endl;
+            return 0;
+        }
+
+        if(!options.pack.empty())
+        {
+            std::vector<std::string> errors;
+            std::vector<std::string> inputs = TINY::collect_inputs(options.operands, errors);
+            for(const std::string& error : errors)
+                std::cerr << "tiny: " << error << std::endl;
+            TINY::pack_bundle(inputs, options.pack);
+            if(!options.quiet)
+                std::cerr << "tiny: packed " << inputs.size() << " files" << std::endl;
+            return errors.empty() ? 0 : 1;
+        }
+
+        std::string output = options.output;
+        if(output.empty())
+        {
+            const std::string extension = ".tinyb";
+            output = options.bundle;
+            if(output.size() > extension.size() && output.compare(output.size() - extension.size(), extension.size(), extension) == 0)
+                output.erase(output.size() - extension.size());
+            output += ".cpp" + extension;
+        }
+
+        TINY::Batch_Result batch = TINY::translate_bundle(options.bundle, output, options.batch);
+        TINY::print_diagnostics(batch, std::cerr);
+        if(options.utilization)
+            TINY::print_utilization(batch, std::cerr);
+        if(!options.quiet)
+        {
+            std::cerr << "tiny: " << (options.batch.check_only ? "checked " : "translated ")
+                      << batch.files.size() - batch.failed << " of " << batch.files.size() << " programs";
+            if(batch.failed != 0)
+                std::cerr << ", " << batch.failed << " failed";
+            std::cerr << std::endl;
+        }
+        return batch.failed != 0 ? 1 : 0;
+    }
+    catch(TINY::Bundle_Error& er)
+    {
+        std::cerr << "tiny: " << er << std::endl;
+        return 1;
+    }
+}
+
+TINY::Watcher* p_watcher = nullptr;
+
+extern "C" void stop_watching(int)
+{
+    if(p_watcher)
+        p_watcher->stop();
+}
+
+void print_round(const Cli_Options& options, const TINY::Watch_Round& round)
+{
+    std::size_t files = round.batch.files.size();
+    TINY::print_diagnostics(round.batch, std::cerr);
+    if(!options.quiet)
+    {
+        char latency[32];
+        std::snprintf(latency, sizeof latency, "%.1f ms", 1000 * round.latency_seconds);
+        std::cerr << "tiny: " << (options.batch.check_only ? "checked " : "translated ")
+                  << files - round.batch.failed - round.batch.skipped << " of " << files << " files";
+        if(round.batch.skipped != 0)
+            std::cerr << ", " << round.batch.skipped << " unchanged";
+        if(round.batch.failed != 0)
+            std::cerr << ", " << round.batch.failed << " failed";
+        std::cerr << " in " << latency << std::endl;
+    }
+}
+
+// Translate the inputs, then every input saved afterwards until interrupted
+int watch(const Cli_Options& options)
+{
+    TINY::Watch_Options watch_options;
+    watch_options.batch = options.batch;
+    watch_options.debounce_ms = unsigned(options.debounce_ms);
+
+    try
+    {
+        TINY::Watcher watcher(options.operands, watch_options);
+
+        std::vector<std::string> errors;
+        TINY::Watch_Round round = watcher.start(errors);
+        for(const std::string& error : errors)
+            std::cerr << "tiny: " << error << std::endl;
+        print_round(options, round);
+
+        p_watcher = &watcher;
+        std::signal(SIGINT, stop_watching);
+        std::signal(SIGTERM, stop_watching);
+        watcher.run([&](const TINY::Watch_Round& round) { print_round(options, round); });
+        p_watcher = nullptr;
+    }
+    catch(TINY::Watch_Error& er)
+    {
+        std::cerr << "tiny: " << er << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// tiny --profile-report <file> [profile]: the profile defaults to $TINY_PROFILE, then tiny.prof
+int profile_report(const Cli_Options& options)
+{
+    if(options.operands.empty() || options.operands.size() > 2)
+    {
+        std::cerr << "tiny: --profile-report expects a program and optionally its profile" << std::endl;
+        return 2;
+    }
+
+    std::ifstream file(options.operands[0], std::ios::binary);
+    std::stringstream source;
+    if(!(source << file.rdbuf()))
+    {
+        std::cerr << "tiny: cannot read " << options.operands[0] << std::endl;
+        return 1;
+    }
+
+    std::string path = options.operands.size() == 2 ? options.operands[1]
+                       : std::getenv("TINY_PROFILE") ? std::getenv("TINY_PROFILE") : "tiny.prof";
+    std::map<std::size_t, TINY::Line_Profile> profile;
+    if(!TINY::read_profile(path, profile))
+    {
+        std::cerr << "tiny: cannot read the profile " << path << std::endl;
+        return 1;
+    }
+
+    TINY::print_profile_report(source.str(), profile, std::cout);
+    return 0;
+}
+
+// Say which hardware counters the time report lacks and why, given the Counter bits it has
+void print_counters_unavailable(const std::string& reason, unsigned counted)
+{
+    std::cerr << "tiny: " << (counted == 0 ? "hardware counters unavailable" : "some hardware counters unavailable");
+    if(!reason.empty())
+        std::cerr << " (" << reason << ")";
+    std::cerr << (counted == 0 ? ", reporting times only" : "") << std::endl;
+}
+
+// Run one program with the process's stdin and stdout, in this process or in the daemon
+int run(const Cli_Options& options)
+{
+    if(options.operands.size() != 1)
+    {
+        std::cerr << "tiny: --run expects exactly one file" << std::endl;
+        return 2;
+    }
+
+    TINY::Phase_Timer timer;
+    std::unique_ptr<TINY::Phase_Timer_Activation> activation;
+    std::unique_ptr<TINY::Perf_Counters> counters;
+    if(options.batch.perf_counters)
+    {
+        counters.reset(new TINY::Perf_Counters());
+        timer.set_counters(*counters);
+    }
+    if(options.batch.time_report)
+        activation.reset(new TINY::Phase_Timer_Activation(timer));
+
+    std::stringstream source;
+    {
+        TINY::Phase_Scope scope(TINY::Phase::READ);
+        std::ifstream file(options.operands[0], std::ios::binary);
+        if(!file)
+        {
+            std::cerr << "Invalid file path" << std::endl;
+            return 1;
+        }
+        source << file.rdbuf();
+    }
+
+    if(options.connect_socket.empty())
+    {
+        TINY::Compiler compiler;
+        TINY::Bytecode code;
+        bool ok = compiler.compile(source, code);
+        if(ok)
+        {
+            TINY::VM vm;
+            ok = vm.run(code, std::cin, std::cout);
+        }
+
+        if(options.batch.time_report)
+        {
+            std::cout.flush();
+            if(options.time_json)
+                std::cerr << TINY::phase_json(timer.get_times()) << std::endl;
+            else
+                TINY::print_phase_table(timer.get_times(), std::cerr);
+            if(counters && !counters->get_reason().empty())
+                print_counters_unavailable(counters->get_reason(), timer.get_times().counters);
+        }
+        return ok ? 0 : 1;
+    }
+
+    TINY::Request request;
+    request.kind = TINY::Request_Kind::RUN;
+    request.source = source.str();
+    std::ostringstream input;
+    input << std::cin.rdbuf();
+    request.input = input.str();
+
+    try
+    {
+        TINY::Daemon_Client client(options.connect_socket);
+        TINY::Response response = client.call(request);
+        std::cout << response.output << std::flush;
+        std::cerr << response.diagnostics << std::flush;
+        return response.ok ? 0 : 1;
+    }
+    catch(TINY::Connection_Error& er)
+    {
+        std::cerr << "tiny: " << er << std::endl;
+        return 1;
+    }
+}
+}
+
+int main(int argc, char* argv[])
+{
+    Cli_Options options;
+    int status = parse_arguments(argc, argv, options);
+    if(status != 0)
+        return status < 0 ? 0 : status;
+
+    if(!options.serve_socket.empty())
+        return serve(options);
+    if(options.shutdown && !options.connect_socket.empty())
+        return shutdown(options);
+    if(options.run)
+        return run(options);
+    if(options.profile_report)
+        return profile_report(options);
+    if(options.input_fd >= 0)
+        return stream(options);
+    if(options.json)
+        return json_lines(options);
+    if(!options.bundle.empty() || !options.pack.empty() || !options.unpack.empty())
+        return bundle(options);
+
+    if(options.operands.empty())
+    {
+        usage(std::cerr);
+        return 2;
+    }
+    if(options.watch)
+        return watch(options);
+
+    std::vector<std::string> errors;
+    std::vector<std::string> inputs = TINY::collect_inputs(options.operands, errors);
+    for(const std::string& error : errors)
+        std::cerr << "tiny: " << error << std::endl;
+
+    std::unique_ptr<TINY::Trace_Recorder> trace;
+    if(!options.trace.empty())
+    {
+        trace.reset(new TINY::Trace_Recorder(options.trace_min_us));
+        options.batch.p_trace = trace.get();
+    }
+
+    TINY::Batch_Result batch;
+    TINY::Shard_Report shard_report;
+    TINY::Io_Report io_report;
+    std::unique_ptr<TINY::Bulk_Io> io = TINY::make_bulk_io(options.io);
+    if(!options.connect_socket.empty())
+        batch = TINY::translate_batch_remote(options.connect_socket, inputs, options.batch);
+    else if(options.processes != 0)
+    {
+        TINY::Shard_Options shard_options;
+        shard_options.processes = options.processes;
+        try
+        {
+            batch = TINY::translate_batch_processes(inputs, options.batch, shard_options, shard_report);
+        }
+        catch(TINY::Connection_Error& er)
+        {
+            std::cerr << "tiny: " << er << std::endl;
+            return 1;
+        }
+    }
+    else if(options.incremental)
+        batch = TINY::translate_batch_incremental(inputs, options.batch, options.manifest);
+    else if(io)
+    {
+        try
+        {
+            batch = TINY::translate_batch_bulk(inputs, options.batch, *io, io_report);
+        }
+        catch(TINY::Io_Error& er)
+        {
+            std::cerr << "tiny: " << er << std::endl;
+            return 1;
+        }
+        if(!io_report.failure.empty())
+            std::cerr << "tiny: " << io_report.failure << ", continued with plain system calls" << std::endl;
+    }
+    else if(options.io_report)
+        batch = TINY::translate_batch_fstream(inputs, options.batch, io_report);
+    else
+        batch = TINY::translate_batch(inputs, options.batch);
+    TINY::print_diagnostics(batch, std::cerr);
+    if(options.utilization)
+        TINY::print_utilization(batch, std::cerr);
+    if(options.io_report && !io_report.backend.empty())
+        TINY::print_io_report(io_report, std::cerr);
+    if(options.batch.time_report)
+        TINY::print_time_report(batch, std::cerr, options.time_json);
+    if(options.batch.perf_counters && batch.times.counters != (1u << int(TINY::Counter::COUNT)) - 1)
+        print_counters_unavailable(batch.counters_reason, batch.times.counters);
+    if(options.batch.alloc_report)
+        TINY::print_allocation_report(batch, std::cerr, options.alloc_json);
+    if(options.batch.memory_report)
+        TINY::print_memory_report(batch, std::cerr, options.memory_json);
+    if(trace)
+    {
+        std::ofstream trace_file(options.trace);
+        trace->write(trace_file);
+        if(!trace_file)
+            std::cerr << "tiny: cannot write " << options.trace << std::endl;
+    }
+    if(options.processes != 0 && !options.quiet)
+    {
+        std::cerr << "tiny: " << shard_report.processes << " worker processes, " << shard_report.cache_hits
+                  << " shared cache hits";
+        if(shard_report.crashed_workers != 0)
+            std::cerr << ", " << shard_report.crashed_workers << " crashed workers, " << shard_report.reassigned_files
+                      << " files reassigned";
+        std::cerr << std::endl;
+    }
+    if(options.batch.memory_budget != 0)
+    {
+        char line[128];
+        std::snprintf(line, sizeof line, "tiny: peak RSS %.1f MiB, estimated peak %.1f MiB of a %.1f MiB budget",
+                      double(TINY::peak_rss_bytes()) / (1 << 20), double(batch.peak_admitted) / (1 << 20),
+                      double(options.batch.memory_budget) / (1 << 20));
+        std::cerr << line << std::endl;
+    }
+
+    if(!options.quiet)
+    {
+        std::cerr << "tiny: " << (options.batch.check_only ? "checked " : "translated ")
+                  << inputs.size() - batch.failed << " of " << inputs.size() << " files";
+        if(batch.skipped != 0)
+            std::cerr << ", " << batch.skipped << " up to date";
+        if(batch.failed != 0)
+            std::cerr << ", " << batch.failed << " failed";
+        if(options.batch.memory_report && !batch.largest.empty())
+            std::cerr << ", largest peak " << batch.memory.total << " bytes (" << batch.largest << ")";
+        std::cerr << std::endl;
+    }
+
+    return (batch.failed != 0 || !errors.empty()) ? 1 : 0;
+}
@@ -0,0 +1,853 @@
+#ifndef TINY_CONSTEXPR_HPP_INCLUDED
+#define TINY_CONSTEXPR_HPP_INCLUDED
+
+// Compilation of TINY programs embedded in C++ at compile time, into the bytecode of the VM (tiny_vm.hpp).
+//
+//     constexpr auto program = TINY::compile_static<"BEGIN\nLET x = 6 * 7\nPRINT x\nEND\n">();
+//     TINY::VM().run(program.to_bytecode(), std::cin, std::cout);
+//
+// program holds the instructions, constants, strings and variable names in arrays sized for the program, built by the
+// compiler at compile time: nothing is parsed when the service starts. Errors in the program are compile errors,
+// whose text (line, kind and message, as the Compiler reports them) is the argument of Embedded_Program_Error.
+//
+// Static_Compiler follows the Compiler token for token and emits the same instructions, so it accepts a program
+// exactly when the Compiler does, with one exception: floating literals must convert exactly from at most 19
+// significant digits and a power of ten up to 22 (1.5, 3.14, 2.5e-3, 6.02e23 do), as it cannot round longer ones.
+// Needs C++20 (constexpr std::vector) and nothing of the streams of the translator.
+
+#if __cplusplus < 202002L
+#error "tiny_constexpr.hpp needs C++20"
+#endif
+
+#include "tiny_bytecode.hpp"
+#include "tiny_literal.hpp"
+
+#include <array>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace TINY
+{
+// Error found by Static_Compiler: "<kind>: <message><detail>" is what the Compiler reports for the program
+struct Static_Error
+{
+    const char* kind = nullptr;   // "Lexical Error" or "Syntax Error", nullptr when the program compiled
+    const char* message = "";
+    std::string_view detail;      // Text appended to the message: the number, the string read so far, the character
+    std::size_t line = 0;
+};
+
+// Program compiled by Static_Compiler. strings and variables view the source, which must outlive them
+struct Static_Result
+{
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<std::string_view> strings;
+    std::vector<std::string_view> variables;
+    Static_Error error;
+
+    constexpr bool ok() const { return error.kind == nullptr; }
+};
+
+// Recursive descent compiler from TINY to bytecode, usable in constant expressions. It is the Compiler with its
+// lexer over a string_view and without exceptions, which constant evaluation does not allow: every step returns
+// false once an error was recorded
+class Static_Compiler
+{
+    enum class Token : char {
+       ID, STRING, NUM,
+
+       ASSIGNMENT_SYMBOL, PLUS_SYMBOL, MINUS_SYMBOL, MUL_SYMBOL, DIV_SYMBOL, MOD_SYMBOL,
+       GREATER_SYMBOL, LESS_SYMBOL, EQUAL_SYMBOL, GREATER_EQUAL_SYMBOL, LESS_EQUAL_SYMBOL,
+
+       BEGIN_LITERAL, END_LITERAL, PRINT_LITERAL, INPUT_LITERAL, LET_LITERAL,
+       IF_LITERAL, ENDIF_LITERAL, WHILE_LITERAL, REPEAT_LITERAL, ENDWHILE_LITERAL,
+
+       NEWLINE, EOFSTREAM,
+
+       ELSE_LITERAL, ELSEIF_LITERAL
+    };
+
+    // Character classes of the "C" locale, which the translator's lexer uses
+    static constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static constexpr bool is_alnum(char c) { return is_alpha(c) || is_digit(c); }
+    static constexpr bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+    static constexpr bool is_punct(char c)
+    {
+        return (c >= '!' && c <= '/') || (c >= ':' && c <= '@') || (c >= '[' && c <= '`') || (c >= '{' && c <= '~');
+    }
+
+    // Lexer of the translator over a string_view: the current token is a view of the source, and moving back
+    // returns to the position before it
+    class Lexer
+    {
+     protected:
+        std::string_view source;
+        std::size_t position; // Next character to read
+        std::size_t start;    // Position before the current token, including the whitespace skipped
+        Token cur_token;
+        std::string_view text;
+        std::size_t line;
+        Static_Error* p_error;
+
+     public:
+        constexpr Lexer(std::string_view source, Static_Error& error)
+            : source(source), position(0), start(0), cur_token(Token::EOFSTREAM), line(1), p_error(&error) {}
+
+        constexpr Token get_current_token() const { return cur_token; }
+        constexpr std::string_view get_current_text() const { return text; }
+        constexpr std::size_t get_line() const { return line; }
+
+        // Read the next token, newlines included with newline_check. Returns false on a lexical error
+        constexpr bool advance(bool newline_check = false)
+        {
+            start = position;
+            if(!get_token(newline_check))
+                return false;
+            line += newlines(start, position);
+            return true;
+        }
+
+        // Return to the position before the current token. The token and its text stay the same
+        constexpr void move_back()
+        {
+            line -= newlines(start, position);
+            position = start;
+        }
+
+     private:
+        constexpr std::size_t newlines(std::size_t from, std::size_t to) const
+        {
+            std::size_t count = 0;
+            for(std::size_t i = from; i < to; i++)
+                count += source[i] == '\n';
+            return count;
+        }
+
+        // Next character, or '\0' past the end, which no token accepts
+        constexpr char peek() const { return position < source.size() ? source[position] : '\0'; }
+
+        constexpr bool fail(const char* message, std::string_view detail)
+        {
+            *p_error = Static_Error{"Lexical Error", message, detail, line + newlines(start, position)};
+            return false;
+        }
+
+        constexpr bool get_token(bool newline_check)
+        {
+            text = std::string_view();
+            while(position < source.size() && is_space(source[position]) && !(newline_check && source[position] == '\n'))
+                position++;
+
+            if(position == source.size())
+            {
+                cur_token = Token::EOFSTREAM;
+                return true;
+            }
+
+            std::size_t begin = position;
+            char c = source[position++];
+            if(c == '\n')
+            {
+                cur_token = Token::NEWLINE;
+                return true;
+            }
+
+            if(is_alpha(c))
+            {
+                while(is_alnum(peek()))
+                    position++;
+                text = source.substr(begin, position - begin);
+                cur_token = keyword(text);
+                return true;
+            }
+
+            if(is_digit(c) || c == '.')
+            {
+                if(is_digit(c))
+                {
+                    while(is_digit(peek()))
+                        position++;
+                    if(peek() == '.')
+                    {
+                        position++;
+                        while(is_digit(peek()))
+                            position++;
+                    }
+                }
+                else
+                {
+                    if(!is_digit(peek()))
+                        return fail("no digits after decimal point", {});
+                    while(is_digit(peek()))
+                        position++;
+                }
+
+                if(peek() == 'E' || peek() == 'e')
+                {
+                    position++;
+                    if(peek() == '+' || peek() == '-')
+                        position++;
+                    if(!is_digit(peek()))
+                        return fail("no digits in exponent part", {});
+                    while(is_digit(peek()))
+                        position++;
+                }
+
+                text = source.substr(begin, position - begin);
+                cur_token = Token::NUM;
+                return true;
+            }
+
+            text = source.substr(begin, 1);
+            switch(c)
+            {
+            case '>':
+            case '<':
+            case '=':
+                if(peek() == '=')
+                {
+                    position++;
+                    text = source.substr(begin, 2);
+                    cur_token = c == '>' ? Token::GREATER_EQUAL_SYMBOL
+                                         : c == '<' ? Token::LESS_EQUAL_SYMBOL : Token::EQUAL_SYMBOL;
+                }
+                else
+                {
+                    cur_token = c == '>' ? Token::GREATER_SYMBOL
+                                         : c == '<' ? Token::LESS_SYMBOL : Token::ASSIGNMENT_SYMBOL;
+                }
+                return true;
+            case '+':
+                cur_token = Token::PLUS_SYMBOL;
+                return true;
+            case '-':
+                cur_token = Token::MINUS_SYMBOL;
+                return true;
+            case '*':
+                cur_token = Token::MUL_SYMBOL;
+                return true;
+            case '/':
+                cur_token = Token::DIV_SYMBOL;
+                return true;
+            case '\"':
+                // Digits, letters, punctuation and spaces up to the next ", which ends the string
+                while(peek() != '\"')
+                {
+                    if(position == source.size() || (peek() != ' ' && !is_alnum(peek()) && !is_punct(peek())))
+                        return fail("unexpected character in string ", source.substr(begin + 1, position - begin - 1));
+                    position++;
+                }
+                text = source.substr(begin + 1, position - begin - 1);
+                position++;
+                cur_token = Token::STRING;
+                return true;
+            default:
+                // The Compiler reports the character as a C string, where '\0' is empty
+                return fail("", c == '\0' ? std::string_view() : text);
+            }
+        }
+
+        static constexpr Token keyword(std::string_view word)
+        {
+            if(word == "BEGIN")
+                return Token::BEGIN_LITERAL;
+            else if(word == "END")
+                return Token::END_LITERAL;
+            else if(word == "PRINT")
+                return Token::PRINT_LITERAL;
+            else if(word == "INPUT")
+                return Token::INPUT_LITERAL;
+            else if(word == "LET")
+                return Token::LET_LITERAL;
+            else if(word == "IF")
+                return Token::IF_LITERAL;
+            else if(word == "ELSEIF")
+                return Token::ELSEIF_LITERAL;
+            else if(word == "ELSE")
+                return Token::ELSE_LITERAL;
+            else if(word == "ENDIF")
+                return Token::ENDIF_LITERAL;
+            else if(word == "WHILE")
+                return Token::WHILE_LITERAL;
+            else if(word == "REPEAT")
+                return Token::REPEAT_LITERAL;
+            else if(word == "ENDWHILE")
+                return Token::ENDWHILE_LITERAL;
+            else if(word == "mod")
+                return Token::MOD_SYMBOL;
+            else
+                return Token::ID;
+        }
+    };
+
+ protected:
+    Lexer* p_lexer;
+    Static_Result* p_result;
+
+ public:
+    constexpr Static_Compiler() : p_lexer(nullptr), p_result(nullptr) {}
+
+    // Compile a whole program. The result holds the error instead when ok() is false
+    constexpr Static_Result compile(std::string_view source)
+    {
+        Static_Result result;
+        Lexer lexer(source, result.error);
+        p_lexer = &lexer;
+        p_result = &result;
+
+        if(!program())
+        {
+            result.code.clear();
+            result.constants.clear();
+            result.strings.clear();
+            result.variables.clear();
+        }
+
+        p_lexer = nullptr;
+        p_result = nullptr;
+        return result;
+    }
+
+ private:
+    constexpr bool fail(const char* message, std::string_view detail = {})
+    {
+        p_result->error = Static_Error{"Syntax Error", message, detail, p_lexer->get_line()};
+        return false;
+    }
+
+    constexpr std::uint32_t emit(Op op, std::uint32_t operand = 0)
+    {
+        p_result->code.push_back(Instruction{op, operand});
+        return std::uint32_t(p_result->code.size() - 1);
+    }
+
+    // Point the jump at index to the next instruction to be emitted
+    constexpr void patch(std::uint32_t index)
+    {
+        p_result->code[index].operand = std::uint32_t(p_result->code.size());
+    }
+
+    // Slot of a declared variable, variables.size() when it is not declared
+    constexpr std::uint32_t find(std::string_view name) const
+    {
+        std::uint32_t slot = 0;
+        while(slot < p_result->variables.size() && p_result->variables[slot] != name)
+            slot++;
+        return slot;
+    }
+
+    constexpr bool declared(std::string_view name) const { return find(name) < p_result->variables.size(); }
+
+    constexpr std::uint32_t declare(std::string_view name)
+    {
+        std::uint32_t slot = find(name);
+        if(slot == p_result->variables.size())
+            p_result->variables.push_back(name);
+        return slot;
+    }
+
+    // <program>	::= 'BEGIN' <newlines> <statements> <newlines> 'END'
+    constexpr bool program()
+    {
+        std::string_view temp_text;
+
+        if(!p_lexer->advance())
+            return false;
+        if(p_lexer->get_current_token() != Token::BEGIN_LITERAL)
+            return fail("Cannot find the beginning of the program");
+
+        if(!newlines("BEGIN must be followed by a newline") || !p_lexer->advance())
+            return false;
+
+        if(p_lexer->get_current_token() != Token::END_LITERAL)
+        {
+            if(!statements())
+                return false;
+
+            temp_text = p_lexer->get_current_text();
+            if(!p_lexer->advance())
+                return false;
+        }
+
+        Token current_token = p_lexer->get_current_token();
+        if((current_token != Token::END_LITERAL) && !(current_token == Token::EOFSTREAM && temp_text == "END"))
+            return fail("Cannot find the end of the program");
+        if(!p_lexer->advance())
+            return false;
+
+        emit(Op::HALT);
+
+        if(p_lexer->get_current_token() != Token::EOFSTREAM)
+            return fail("Unexpected tokens after END");
+        return true;
+    }
+
+    constexpr bool newlines(const char* message)
+    {
+        if(!p_lexer->advance(true))
+            return false;
+        if(p_lexer->get_current_token() != Token::NEWLINE)
+            return fail(message);
+        return true;
+    }
+
+    constexpr bool statements()
+    {
+        while(true)
+        {
+            bool ok;
+            switch(p_lexer->get_current_token())
+            {
+            case Token::PRINT_LITERAL:
+                ok = print_statement() && newlines("print_statement must be followed by a newline");
+                break;
+
+            case Token::INPUT_LITERAL:
+                ok = input_statement() && newlines("input_statement must be followed by a newline");
+                break;
+
+            case Token::LET_LITERAL:
+                ok = let_statement() && newlines("let_statement must be followed by a newline");
+                break;
+
+            case Token::IF_LITERAL:
+                ok = if_statement() && newlines("if_statement must be followed by a newline");
+                break;
+
+            case Token::WHILE_LITERAL:
+                ok = while_statement() && newlines("print_statement must be followed by a newline");
+                break;
+
+            default:
+                p_lexer->move_back();
+                return true;
+            }
+
+            if(!ok || !p_lexer->advance()) // Move past the newline
+                return false;
+        }
+    }
+
+    // <print_statement>	::= 'PRINT' <string>|'PRINT' id
+    constexpr bool print_statement()
+    {
+        if(!p_lexer->advance()) // move past PRINT literal
+            return false;
+
+        switch(p_lexer->get_current_token())
+        {
+        case Token::STRING:
+            p_result->strings.push_back(p_lexer->get_current_text());
+            emit(Op::PRINT_STRING, std::uint32_t(p_result->strings.size() - 1));
+            return true;
+        case Token::ID:
+            if(!declared(p_lexer->get_current_text()))
+                return fail("Attempt to print an undeclared identifier");
+
+            emit(Op::LOAD, find(p_lexer->get_current_text()));
+            emit(Op::PRINT);
+            return true;
+
+        default:
+            return fail("Unexpected tokens after PRINT");
+        }
+    }
+
+    // <input_statement>	::= 'INPUT' <id>
+    constexpr bool input_statement()
+    {
+        if(!p_lexer->advance()) // move past INPUT literal
+            return false;
+
+        if(p_lexer->get_current_token() != Token::ID)
+            return fail("Unexpected tokens after INPUT");
+
+        emit(Op::INPUT, declare(p_lexer->get_current_text()));
+        return true;
+    }
+
+    // <let_statement>	::= 'LET' <assignment>
+    constexpr bool let_statement()
+    {
+        if(!p_lexer->advance()) // move past LET literal
+            return false;
+
+        // Declare before the assignment is checked, exactly like the translator does
+        if(p_lexer->get_current_token() == Token::ID)
+            declare(p_lexer->get_current_text());
+
+        return assignment();
+    }
+
+    // <if_statement>	:= 'IF' <condition> <newline> <statements> <newline> 'ENDIF' with optional ELSEIF and ELSE parts
+    constexpr bool if_statement()
+    {
+        std::vector<std::uint32_t> exits; // Jumps to the end of the whole statement
+
+        if(!p_lexer->advance() || !condition() || !newlines("if_statement's condition must be followed by a newline"))
+            return false;
+
+        std::uint32_t skip = emit(Op::JUMP_IF_FALSE);
+
+        if(!p_lexer->advance() || !statements() || !p_lexer->advance())
+            return false;
+        Token current_token = p_lexer->get_current_token();
+
+        while(current_token == Token::ELSEIF_LITERAL)
+        {
+            exits.push_back(emit(Op::JUMP));
+            patch(skip);
+
+            if(!p_lexer->advance() || !condition()
+               || !newlines("elseif_statement's condition must be followed by a newline"))
+                return false;
+
+            skip = emit(Op::JUMP_IF_FALSE);
+
+            if(!p_lexer->advance() || !statements() || !p_lexer->advance())
+                return false;
+            current_token = p_lexer->get_current_token();
+        }
+
+        if(current_token == Token::ELSE_LITERAL)
+        {
+            if(!newlines("ELSE must be followed by a newline"))
+                return false;
+
+            exits.push_back(emit(Op::JUMP));
+            patch(skip);
+
+            if(!p_lexer->advance() || !statements() || !p_lexer->advance())
+                return false;
+            current_token = p_lexer->get_current_token();
+        }
+        else
+        {
+            patch(skip);
+        }
+
+        if(current_token != Token::ENDIF_LITERAL)
+            return fail("Cannot find the end of if_statement");
+
+        for(std::uint32_t exit : exits)
+            patch(exit);
+        return true;
+    }
+
+    // <while_statement>	:= 'WHILE' <condition> 'REPEAT' <newline> <statements> <newline> 'ENDWHILE'
+    constexpr bool while_statement()
+    {
+        std::uint32_t start = std::uint32_t(p_result->code.size());
+
+        if(!p_lexer->advance() || !condition())
+            return false;
+
+        std::uint32_t exit = emit(Op::JUMP_IF_FALSE);
+
+        if(!p_lexer->advance(true))
+            return false;
+        if(p_lexer->get_current_token() != Token::REPEAT_LITERAL)
+            return fail("a WHILE literal and a REPEAT literal must be on the same line");
+
+        if(!newlines("REPEAT must be followed by a newline") || !p_lexer->advance() || !statements())
+            return false;
+
+        emit(Op::JUMP, start);
+        patch(exit);
+
+        if(!p_lexer->advance())
+            return false;
+        if(p_lexer->get_current_token() != Token::ENDWHILE_LITERAL)
+            return fail("Cannot find the end of while_statement");
+        return true;
+    }
+
+    // <assignment>	::= <id> = <expression>
+    constexpr bool assignment()
+    {
+        if(p_lexer->get_current_token() != Token::ID)
+            return fail("Target of assignment must be an identifier");
+        else if(!declared(p_lexer->get_current_text()))
+            return fail("Attempt to assign to an undeclared identifier");
+
+        std::uint32_t slot = find(p_lexer->get_current_text());
+
+        if(!p_lexer->advance())
+            return false;
+        if(p_lexer->get_current_token() != Token::ASSIGNMENT_SYMBOL)
+            return fail("Unexpected token in assignment");
+
+        if(!p_lexer->advance() || !expression()) // Move past assignment symbol
+            return false;
+        emit(Op::STORE, slot);
+        return true;
+    }
+
+    // <expression> 	::= <exp> | <exp> ('+'|'-'|'*'|'/'|'mod') <exp>
+    constexpr bool expression()
+    {
+        if(!exp() || !p_lexer->advance()) // Move past the exp
+            return false;
+
+        Op op = Op::ADD;
+        switch(p_lexer->get_current_token())
+        {
+        case Token::PLUS_SYMBOL:
+            op = Op::ADD;
+            break;
+        case Token::MINUS_SYMBOL:
+            op = Op::SUB;
+            break;
+        case Token::MUL_SYMBOL:
+            op = Op::MUL;
+            break;
+        case Token::DIV_SYMBOL:
+            op = Op::DIV;
+            break;
+        case Token::MOD_SYMBOL:
+            op = Op::MOD;
+            break;
+        default:
+            p_lexer->move_back();
+            return true;
+        }
+
+        if(!p_lexer->advance() || !exp()) // Move past the symbol
+            return false;
+        emit(op);
+        return true;
+    }
+
+    // <exp>	:= <id>|<number>
+    constexpr bool exp()
+    {
+        if(p_lexer->get_current_token() != Token::ID)
+            return number();
+
+        if(!declared(p_lexer->get_current_text()))
+            return fail("Attempt to handle an undeclared identifier in exp");
+
+        emit(Op::LOAD, find(p_lexer->get_current_text()));
+        return true;
+    }
+
+    // <number>	::= '-'<num>|'+'<num>| <num>
+    constexpr bool number()
+    {
+        bool negative = false;
+
+        switch(p_lexer->get_current_token())
+        {
+        case Token::MINUS_SYMBOL:
+        case Token::PLUS_SYMBOL:
+            negative = p_lexer->get_current_token() == Token::MINUS_SYMBOL;
+
+            if(!p_lexer->advance())
+                return false;
+            if(p_lexer->get_current_token() != Token::NUM)
+                return fail("Unexpected tokens in number");
+            break;
+
+        case Token::NUM:
+            break;
+
+        default:
+            return fail("Unexpected tokens in number");
+        }
+
+        Value value;
+        if(!literal(p_lexer->get_current_text(), value))
+            return false;
+        if(negative)
+        {
+            value.integer = -value.integer;
+            value.number = -value.number;
+        }
+
+        p_result->constants.push_back(value);
+        emit(Op::PUSH, std::uint32_t(p_result->constants.size() - 1));
+        return true;
+    }
+
+    // Value of a numeric literal, by the rule of tiny_literal.hpp
+    constexpr bool literal(std::string_view text, Value& value)
+    {
+        Literal literal;
+        if(!read_literal(text, literal))
+            return fail("Invalid number ", text);
+        if(!literal.exact)
+            return fail("Floating literal not exactly convertible at compile time ", text);
+
+        value = Value{literal.real, literal.integer, literal.number};
+        return true;
+    }
+
+    // <condition>	::= <expression> <compare> <expression>
+    constexpr bool condition()
+    {
+        if(!expression() || !p_lexer->advance())
+            return false;
+
+        Op op = Op::GREATER;
+        switch(p_lexer->get_current_token())
+        {
+        case Token::GREATER_SYMBOL:
+            op = Op::GREATER;
+            break;
+        case Token::LESS_SYMBOL:
+            op = Op::LESS;
+            break;
+        case Token::GREATER_EQUAL_SYMBOL:
+            op = Op::GREATER_EQUAL;
+            break;
+        case Token::LESS_EQUAL_SYMBOL:
+            op = Op::LESS_EQUAL;
+            break;
+        case Token::EQUAL_SYMBOL:
+            op = Op::EQUAL;
+            break;
+        default:
+            return fail("Unexpected tokens in condition");
+        }
+
+        if(!p_lexer->advance() || !expression()) // move past the symbol
+            return false;
+        emit(op);
+        return true;
+    }
+};
+
+// Program compiled at compile time, in arrays of its exact sizes. strings and variables view the template argument
+// of compile_static, which lives for the whole program
+template<std::size_t Code, std::size_t Constants, std::size_t Strings, std::size_t Variables>
+struct Static_Program
+{
+    std::array<Instruction, Code> code;
+    std::array<Value, Constants> constants;
+    std::array<std::string_view, Strings> strings;
+    std::array<std::string_view, Variables> variables;
+
+    // Copy for the VM
+    Bytecode to_bytecode() const
+    {
+        Bytecode bytecode;
+        bytecode.code.assign(code.begin(), code.end());
+        bytecode.constants.assign(constants.begin(), constants.end());
+        for(std::string_view text : strings)
+            bytecode.strings.emplace_back(text);
+        for(std::string_view name : variables)
+            bytecode.variables.emplace_back(name);
+        return bytecode;
+    }
+};
+
+// Program text given as template argument to compile_static
+template<std::size_t N>
+struct Static_Source
+{
+    char text[N];
+
+    consteval Static_Source(const char (&literal)[N])
+    {
+        for(std::size_t i = 0; i < N; i++)
+            text[i] = literal[i];
+    }
+
+    constexpr std::string_view view() const { return std::string_view(text, N - 1); }
+};
+
+namespace detail
+{
+// "line N: <kind>: <message><detail>" of an error, empty for none, as a template argument shown by the compiler
+struct Static_Error_Text
+{
+    char text[160] = {};
+
+    constexpr void append(std::size_t& length, std::string_view part)
+    {
+        for(std::size_t i = 0; i < part.size() && length + 1 < sizeof text; i++)
+            text[length++] = part[i];
+    }
+};
+
+constexpr Static_Error_Text error_text(const Static_Error& error)
+{
+    Static_Error_Text result;
+    if(!error.kind)
+        return result;
+
+    char digits[24] = {};
+    std::size_t count = 0;
+    for(std::size_t line = error.line; count == 0 || line != 0; line /= 10)
+        digits[count++] = char('0' + line % 10);
+    for(std::size_t i = 0; i < count / 2; i++)
+    {
+        char c = digits[i];
+        digits[i] = digits[count - 1 - i];
+        digits[count - 1 - i] = c;
+    }
+
+    std::size_t length = 0;
+    result.append(length, "line ");
+    result.append(length, std::string_view(digits, count));
+    result.append(length, ": ");
+    result.append(length, error.kind);
+    result.append(length, ": ");
+    result.append(length, error.message);
+    result.append(length, error.detail);
+    return result;
+}
+
+struct Static_Summary
+{
+    std::size_t code = 0;
+    std::size_t constants = 0;
+    std::size_t strings = 0;
+    std::size_t variables = 0;
+    Static_Error_Text error;
+};
+
+constexpr Static_Summary summarize(std::string_view source)
+{
+    Static_Result result = Static_Compiler().compile(source);
+    return Static_Summary{result.code.size(), result.constants.size(), result.strings.size(), result.variables.size(),
+                          error_text(result.error)};
+}
+}
+
+// Instantiated with Ok false when an embedded program does not compile: the error is the text of Error
+template<detail::Static_Error_Text Error, bool Ok>
+struct Embedded_Program_Error
+{
+    static_assert(Ok, "the embedded TINY program does not compile, its error is the argument of Embedded_Program_Error");
+};
+
+// Compile an embedded program at compile time
+template<Static_Source Source>
+consteval auto compile_static()
+{
+    constexpr detail::Static_Summary summary = detail::summarize(Source.view());
+    Embedded_Program_Error<summary.error, summary.error.text[0] == '\0'>{};
+
+    Static_Program<summary.code, summary.constants, summary.strings, summary.variables> program{};
+    if constexpr(summary.error.text[0] == '\0')
+    {
+        Static_Result result = Static_Compiler().compile(Source.view());
+        for(std::size_t i = 0; i < summary.code; i++)
+            program.code[i] = result.code[i];
+        for(std::size_t i = 0; i < summary.constants; i++)
+            program.constants[i] = result.constants[i];
+        for(std::size_t i = 0; i < summary.strings; i++)
+            program.strings[i] = result.strings[i];
+        for(std::size_t i = 0; i < summary.variables; i++)
+            program.variables[i] = result.variables[i];
+    }
+    return program;
+}
+}
+
+#endif // TINY_CONSTEXPR_HPP_INCLUDED
@@ -0,0 +1,624 @@
+#ifndef TINY_DAEMON_HPP_INCLUDED
+#define TINY_DAEMON_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_vm.hpp"
+#include "tiny_cache.hpp"
+#include "tiny_batch.hpp"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace TINY
+{
+// Errors of the connection between a client and the daemon
+using Connection_Error = Error<3>;
+
+// Wire format, all integers are little endian:
+//   frame    = u32 length, then length bytes of payload
+//   request  = u8 kind, u32 size + program text, u32 size + program input (only used by RUN)
+//   response = u8 status (0 ok, 1 failed), u32 size + output, u32 size + diagnostics
+// The output of TRANSLATE is the C++ code, the output of RUN is what the program printed, CHECK has no output.
+// A connection carries any number of request/response pairs. SHUTDOWN stops the daemon once answered
+enum class Request_Kind : char { TRANSLATE = 'T', CHECK = 'C', RUN = 'R', SHUTDOWN = 'Q' };
+
+struct Request
+{
+    Request_Kind kind = Request_Kind::TRANSLATE;
+    std::string source;
+    std::string input;
+};
+
+struct Response
+{
+    bool ok = false;
+    std::string output;
+    std::string diagnostics;
+};
+
+namespace detail
+{
+// Frames larger than this are refused, they can only come from a broken peer
+const std::uint32_t max_frame = 1u << 30;
+
+inline void put_u32(std::string& out, std::uint32_t value)
+{
+    for(int i = 0; i < 4; i++)
+        out += char((value >> (8 * i)) & 0xff);
+}
+
+inline void put_field(std::string& out, const std::string& field)
+{
+    put_u32(out, std::uint32_t(field.size()));
+    out += field;
+}
+
+inline std::uint32_t get_u32(const std::string& in, std::size_t& pos)
+{
+    if(in.size() - pos < 4)
+        throw Connection_Error{"truncated message"};
+
+    std::uint32_t value = 0;
+    for(int i = 0; i < 4; i++)
+        value |= std::uint32_t(static_cast<unsigned char>(in[pos + i])) << (8 * i);
+    pos += 4;
+    return value;
+}
+
+inline std::string get_field(const std::string& in, std::size_t& pos)
+{
+    std::uint32_t size = get_u32(in, pos);
+    if(in.size() - pos < size)
+        throw Connection_Error{"truncated message"};
+
+    std::string field(in, pos, size);
+    pos += size;
+    return field;
+}
+
+inline void write_all(int fd, const char* data, std::size_t size)
+{
+    while(size > 0)
+    {
+        // MSG_NOSIGNAL: a vanished peer is an error for this connection, not a SIGPIPE for the whole process
+        ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            throw Connection_Error{std::string("write failed: ") + std::strerror(errno)};
+        data += written;
+        size -= std::size_t(written);
+    }
+}
+
+// Returns false on a clean end of stream before the first byte
+inline bool read_all(int fd, char* data, std::size_t size)
+{
+    std::size_t done = 0;
+    while(done < size)
+    {
+        ssize_t got = ::read(fd, data + done, size - done);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got == 0 && done == 0)
+            return false;
+        if(got <= 0)
+            throw Connection_Error{"connection closed in the middle of a message"};
+        done += std::size_t(got);
+    }
+    return true;
+}
+
+inline void write_frame(int fd, const std::string& payload)
+{
+    std::string header;
+    put_u32(header, std::uint32_t(payload.size()));
+    write_all(fd, header.data(), header.size());
+    write_all(fd, payload.data(), payload.size());
+}
+
+// Returns false when the peer closed the connection between frames
+inline bool read_frame(int fd, std::string& payload)
+{
+    std::string header(4, '\0');
+    if(!read_all(fd, &header[0], 4))
+        return false;
+
+    std::size_t pos = 0;
+    std::uint32_t size = get_u32(header, pos);
+    if(size > max_frame)
+        throw Connection_Error{"message too large"};
+
+    payload.resize(size);
+    if(size != 0 && !read_all(fd, &payload[0], size))
+        throw Connection_Error{"connection closed in the middle of a message"};
+    return true;
+}
+
+inline std::string encode(const Request& request)
+{
+    std::string payload(1, char(request.kind));
+    put_field(payload, request.source);
+    put_field(payload, request.input);
+    return payload;
+}
+
+inline Request decode_request(const std::string& payload)
+{
+    if(payload.empty())
+        throw Connection_Error{"empty request"};
+
+    Request request;
+    request.kind = Request_Kind(payload[0]);
+    std::size_t pos = 1;
+    request.source = get_field(payload, pos);
+    request.input = get_field(payload, pos);
+    return request;
+}
+
+inline std::string encode(const Response& response)
+{
+    std::string payload(1, char(response.ok ? 0 : 1));
+    put_field(payload, response.output);
+    put_field(payload, response.diagnostics);
+    return payload;
+}
+
+inline Response decode_response(const std::string& payload)
+{
+    if(payload.empty())
+        throw Connection_Error{"empty response"};
+
+    Response response;
+    response.ok = payload[0] == 0;
+    std::size_t pos = 1;
+    response.output = get_field(payload, pos);
+    response.diagnostics = get_field(payload, pos);
+    return response;
+}
+
+inline sockaddr_un socket_address(const std::string& path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof address.sun_path)
+        throw Connection_Error{"socket path too long: " + path};
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Diagnostics of a translator, compiler or VM sent to out for a scope, and back to std::cerr when it is left, even by
+// an exception: pooled states must not keep pointing at a stream of a finished request
+template<class Target>
+class Diagnostics_Scope
+{
+    Target& target;
+
+ public:
+    Diagnostics_Scope(Target& target, std::ostream& out) : target(target) { target.set_diagnostics(out); }
+    ~Diagnostics_Scope() { target.set_diagnostics(std::cerr); }
+
+    Diagnostics_Scope(const Diagnostics_Scope&) = delete;
+};
+}
+
+struct Daemon_Options
+{
+    std::size_t cache_bytes = std::size_t(64) << 20; // Memory for memoized results and compiled programs
+    std::uint64_t step_limit = 100000000;           // Instructions a RUN may execute, 0 for no limit
+};
+
+// Long running translation server listening on a UNIX domain socket.
+// Translators, compilers and VMs are pooled and reused across requests and connections. Each translator allocates
+// from the pool of its state, which keeps the memory of earlier translations for the next ones. Results are memoized
+// by program content: a file translated again costs one hash and one lookup
+class Daemon
+{
+ protected:
+    struct Warm_State
+    {
+        std::pmr::unsynchronized_pool_resource pool; // Used by one request at a time, the Lease holding the state
+        Translator translator;
+        Compiler compiler;
+        VM vm;
+
+        Warm_State() { translator.set_memory(&pool); }
+    };
+
+    std::string socket_path;
+    Daemon_Options options;
+    int listen_fd;
+
+    std::mutex states_mutex;
+    std::vector<std::unique_ptr<Warm_State>> idle_states;
+
+    Content_Cache<Response> results;   // Keyed by request kind and program text
+    Content_Cache<Bytecode> programs;  // Compiled programs for RUN, keyed by program text
+
+    std::mutex connections_mutex;
+    std::condition_variable connection_closed;
+    std::set<int> connections; // Open connections, each served by a detached thread
+    std::atomic<bool> stopping;
+
+ public:
+    Daemon(std::string path, Daemon_Options daemon_options = Daemon_Options())
+        : socket_path(std::move(path)), options(daemon_options), listen_fd(-1),
+          results(daemon_options.cache_bytes / 2), programs(daemon_options.cache_bytes / 2), stopping(false) {}
+
+    Daemon(const Daemon&) = delete;
+    Daemon(Daemon&&) = delete;
+
+    ~Daemon()
+    {
+        if(listen_fd >= 0)
+        {
+            ::close(listen_fd);
+            ::unlink(socket_path.c_str());
+        }
+    }
+
+    // Bind the socket. A stale socket file left by a dead daemon is replaced, a live daemon is an error
+    void listen()
+    {
+        sockaddr_un address = detail::socket_address(socket_path);
+
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0;
+        if(probe >= 0)
+            ::close(probe);
+        if(alive)
+            throw Connection_Error{"a daemon is already listening on " + socket_path};
+        ::unlink(socket_path.c_str());
+
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0
+           || ::listen(listen_fd, 128) != 0)
+            throw Connection_Error{"cannot listen on " + socket_path + ": " + std::strerror(errno)};
+    }
+
+    // Accept connections until a SHUTDOWN request, each connection is served by its own thread
+    void serve()
+    {
+        while(!stopping)
+        {
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if(fd < 0)
+            {
+                if(errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            if(stopping)
+            {
+                ::close(fd);
+                break;
+            }
+            connections.insert(fd);
+            std::thread([this, fd] { serve_connection(fd); }).detach();
+        }
+
+        // Wake up connections waiting for their next request and wait for all of them to finish
+        std::unique_lock<std::mutex> lock(connections_mutex);
+        for(int fd : connections)
+            ::shutdown(fd, SHUT_RDWR);
+        connection_closed.wait(lock, [this] { return connections.empty(); });
+    }
+
+    // Answer one request, using the memoized result when the same program was seen before
+    Response handle(const Request& request)
+    {
+        if(request.kind == Request_Kind::RUN)
+            return run(request);
+
+        if(request.kind != Request_Kind::TRANSLATE && request.kind != Request_Kind::CHECK)
+        {
+            Response response;
+            response.diagnostics = "Unknown request\n";
+            return response;
+        }
+
+        std::string key(1, char(request.kind));
+        key += request.source;
+        if(std::shared_ptr<const Response> cached = results.find(key))
+            return *cached;
+
+        auto response = std::make_shared<Response>();
+        {
+            Lease state(*this);
+            std::ostringstream diagnostics;
+            detail::Diagnostics_Scope diagnostics_scope(state->translator, diagnostics);
+
+            std::stringstream input(request.source);
+            if(request.kind == Request_Kind::TRANSLATE)
+            {
+                std::ostringstream output;
+                response->ok = state->translator.translate(input, output);
+                if(response->ok)
+                    response->output = output.str();
+            }
+            else
+            {
+                std::ostream discard(nullptr);
+                response->ok = state->translator.translate(input, discard);
+            }
+
+            response->diagnostics = diagnostics.str();
+        }
+
+        results.insert(key, response, response->output.size() + response->diagnostics.size());
+        return *response;
+    }
+
+    std::size_t cache_hits() const { return results.get_hits() + programs.get_hits(); }
+    std::size_t cache_misses() const { return results.get_misses() + programs.get_misses(); }
+
+ private:
+    // Borrow a warm state from the pool for the duration of a request
+    class Lease
+    {
+        Daemon& daemon;
+        std::unique_ptr<Warm_State> state;
+
+     public:
+        explicit Lease(Daemon& owner) : daemon(owner)
+        {
+            std::lock_guard<std::mutex> lock(daemon.states_mutex);
+            if(daemon.idle_states.empty())
+            {
+                state = std::make_unique<Warm_State>();
+            }
+            else
+            {
+                state = std::move(daemon.idle_states.back());
+                daemon.idle_states.pop_back();
+            }
+        }
+
+        ~Lease()
+        {
+            std::lock_guard<std::mutex> lock(daemon.states_mutex);
+            daemon.idle_states.push_back(std::move(state));
+        }
+
+        Warm_State* operator->() const { return state.get(); }
+    };
+
+    Response run(const Request& request)
+    {
+        Response response;
+        Lease state(*this);
+
+        std::shared_ptr<const Bytecode> program = programs.find(request.source);
+        if(!program)
+        {
+            std::ostringstream diagnostics;
+            detail::Diagnostics_Scope diagnostics_scope(state->compiler, diagnostics);
+
+            auto code = std::make_shared<Bytecode>();
+            std::stringstream source(request.source);
+            if(!state->compiler.compile(source, *code))
+            {
+                response.diagnostics = diagnostics.str();
+                return response;
+            }
+
+            programs.insert(request.source, code, code->code.size() * sizeof(Instruction) + code->constants.size() * sizeof(Value));
+            program = code;
+        }
+
+        std::ostringstream diagnostics;
+        std::istringstream input(request.input);
+        std::ostringstream output;
+
+        detail::Diagnostics_Scope diagnostics_scope(state->vm, diagnostics);
+        state->vm.set_step_limit(options.step_limit);
+        response.ok = state->vm.run(*program, input, output);
+
+        response.output = output.str();
+        response.diagnostics = diagnostics.str();
+        return response;
+    }
+
+    void serve_connection(int fd)
+    {
+        try
+        {
+            std::string payload;
+            while(detail::read_frame(fd, payload))
+            {
+                Request request = detail::decode_request(payload);
+                if(request.kind == Request_Kind::SHUTDOWN)
+                {
+                    Response response;
+                    response.ok = true;
+                    detail::write_frame(fd, detail::encode(response));
+                    stop();
+                    break;
+                }
+
+                // A request that fails (out of memory on a large program) is answered like an invalid one, the
+                // daemon carries on
+                Response response;
+                try
+                {
+                    response = handle(request);
+                }
+                catch(std::exception& er)
+                {
+                    response = Response();
+                    response.diagnostics = std::string("Internal error: ") + er.what() + "\n";
+                }
+                detail::write_frame(fd, detail::encode(response));
+            }
+        }
+        catch(Connection_Error&)
+        {
+            // A broken client only loses its own connection
+        }
+        catch(std::exception&)
+        {
+            // And so does one whose frames cannot be held in memory
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        connections.erase(fd);
+        ::close(fd);
+        connection_closed.notify_all();
+    }
+
+    void stop()
+    {
+        stopping = true;
+        ::shutdown(listen_fd, SHUT_RDWR);
+    }
+};
+
+// Client side of the daemon protocol, one connection
+class Daemon_Client
+{
+ protected:
+    int fd;
+
+ public:
+    explicit Daemon_Client(const std::string& socket_path) : fd(::socket(AF_UNIX, SOCK_STREAM, 0))
+    {
+        sockaddr_un address = detail::socket_address(socket_path);
+        if(fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0)
+        {
+            std::string reason = std::strerror(errno);
+            if(fd >= 0)
+                ::close(fd);
+            throw Connection_Error{"cannot connect to " + socket_path + ": " + reason};
+        }
+    }
+
+    Daemon_Client(const Daemon_Client&) = delete;
+    Daemon_Client(Daemon_Client&&) = delete;
+
+    ~Daemon_Client() { ::close(fd); }
+
+    Response call(const Request& request)
+    {
+        detail::write_frame(fd, detail::encode(request));
+
+        std::string payload;
+        if(!detail::read_frame(fd, payload))
+            throw Connection_Error{"daemon closed the connection"};
+        return detail::decode_response(payload);
+    }
+};
+
+// Same as translate_batch (or a check batch with options.check_only), with the work done by a daemon.
+// Outputs are written and diagnostics reported exactly as the one-shot translator does
+inline Batch_Result translate_batch_remote(const std::string& socket_path, const std::vector<std::string>& inputs,
+                                           const Batch_Options& options = Batch_Options())
+{
+    Batch_Result batch;
+    batch.files.resize(inputs.size());
+
+    std::size_t workers = options.jobs == 0 ? Work_Stealing_Scheduler::default_size() : options.jobs;
+    {
+        Work_Stealing_Scheduler scheduler(std::min(workers, std::max<std::size_t>(inputs.size(), 1)));
+        std::vector<std::unique_ptr<Daemon_Client>> clients(scheduler.size());
+
+        std::vector<std::pair<std::uint64_t, Work_Stealing_Scheduler::Task>> tasks;
+        for(std::size_t i = 0; i < inputs.size(); i++)
+        {
+            File_Result& result = batch.files[i];
+            result.path = inputs[i];
+
+            std::error_code ec;
+            std::uintmax_t size = std::filesystem::file_size(inputs[i], ec);
+            tasks.emplace_back(ec ? 0 : size, [&, i]
+            {
+                File_Result& result = batch.files[i];
+                const std::string& path = result.path;
+
+                std::ifstream file(path, std::ios::binary);
+                if(path.size() < 4 || !file)
+                {
+                    result.diagnostics = "Invalid file path\n";
+                    return;
+                }
+                if(!options.check_only && path.compare(path.size() - 4, 4, ".txt") != 0)
+                {
+                    result.diagnostics = "Invalid file extension\n";
+                    return;
+                }
+
+                Request request;
+                request.kind = options.check_only ? Request_Kind::CHECK : Request_Kind::TRANSLATE;
+                request.source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+                Response response;
+                try
+                {
+                    // One connection per worker, kept for the whole batch
+                    std::unique_ptr<Daemon_Client>& client = clients[std::size_t(scheduler.current_worker())];
+                    if(!client)
+                        client = std::make_unique<Daemon_Client>(socket_path);
+
+                    response = client->call(request);
+                }
+                catch(Connection_Error& er)
+                {
+                    result.diagnostics = std::string("Connection Error: ") + er.what() + "\n";
+                    return;
+                }
+                result.ok = response.ok;
+                result.diagnostics = response.diagnostics;
+
+                if(options.check_only)
+                    return;
+
+                std::string outfile_path = path.substr(0, path.size() - 4) + ".cpp";
+                if(result.ok)
+                {
+                    std::ofstream output(outfile_path, std::ios::trunc | std::ios::binary);
+                    output << response.output;
+                    result.ok = bool(output);
+                }
+                else
+                {
+                    std::remove(outfile_path.c_str());
+                }
+            });
+        }
+
+        scheduler.seed(std::move(tasks));
+        scheduler.wait();
+        batch.workers = scheduler.stats();
+    }
+
+    for(const File_Result& result : batch.files)
+    {
+        if(!result.ok)
+            batch.failed++;
+    }
+
+    return batch;
+}
+}
+
+#endif // TINY_DAEMON_HPP_INCLUDED
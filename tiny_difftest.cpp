@@ -0,0 +1,812 @@
+// Differential testing of the code the translator emits: random TINY programs and their input are run by the VM,
+// the reference, and by the C++ emitted in each mode, built with the C++ compiler. Outputs must match byte for byte.
+//
+// Usage: tiny_difftest [options]                         test random programs
+//        tiny_difftest --program <file> [--input <file>] test one program
+//
+// Build: g++ -std=c++17 -O2 -pthread tiny_difftest.cpp -o tiny_difftest
+//
+// Modes: plain     Translator::translate
+//        split     top level statements translated one by one with translate_fragment, as the batch does with the
+//                  pieces of large files
+//        count     Profile_Mode::COUNT instrumentation
+//        sample    Profile_Mode::SAMPLE instrumentation
+//
+// A program whose output differs in some mode, or whose code is rejected or does not build, is reduced by removing
+// statements and lines for as long as the difference remains, and the reproducer is written to the failures directory.
+// The time each mode's programs run for is reported too, so the harness doubles as a comparison of the modes' speed.
+// Exit status: 0, 1 when a mode diverged from the reference, 2 on usage errors
+
+#include "tiny_language (1).hpp"
+#include "tiny_vm.hpp"
+#include "tiny_batch.hpp"
+#include "tiny_json.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include <stdlib.h>
+
+namespace
+{
+enum class Mode { PLAIN, SPLIT, COUNT, SAMPLE, COUNT_OF_MODES };
+
+const char* mode_name(Mode mode)
+{
+    static const char* const names[] = {"plain", "split", "count", "sample"};
+    return names[int(mode)];
+}
+
+struct Difftest_Options
+{
+    std::size_t programs = 20;
+    std::uint64_t seed = 0;
+    bool seeded = false;            // Seed given, otherwise drawn at random and printed
+    std::vector<Mode> modes = {Mode::PLAIN, Mode::SPLIT, Mode::COUNT, Mode::SAMPLE};
+    std::string cxx;                // $CXX or g++ by default
+    std::string cxxflags = "-O2";
+    std::size_t runs = 3;           // Runs of each program in each mode, the fastest is kept
+    std::string failures = "difftest-failures";
+    bool minimize = true;
+    std::string output;             // JSON results, none when empty
+
+    std::string program;            // With --program
+    std::string input;
+};
+
+// Result of running a program in one mode (or on the VM)
+struct Outcome
+{
+    bool ok = false;
+    std::string output;
+    std::string error;              // Why there is no output
+    double seconds = 0;             // Fastest run
+};
+
+// Totals of a mode over the programs
+struct Mode_Totals
+{
+    std::size_t programs = 0;
+    std::size_t divergences = 0;
+    double seconds = 0;
+};
+
+// Instructions the VM runs a program for at most. Reduced programs can loop forever, they are then dropped
+const std::uint64_t step_limit = 10000000;
+
+// CPU seconds a built program runs for at most
+const int cpu_limit = 10;
+
+void usage(std::ostream& out)
+{
+    out << "Usage: tiny_difftest [options]\n"
+        << "       tiny_difftest --program FILE [--input FILE] [options]\n"
+        << "\n"
+        << "Options:\n"
+        << "  -n, --programs N      random programs to test (default: 20)\n"
+        << "      --seed S          seed of the first program, program i uses S + i (default: random)\n"
+        << "      --modes LIST      modes compared to the VM, of plain,split,count,sample (default: all)\n"
+        << "      --cxx COMPILER    C++ compiler to build the emitted code with (default: $CXX or g++)\n"
+        << "      --cxxflags FLAGS  flags of the C++ compiler (default: -O2)\n"
+        << "      --runs N          runs of each program in each mode, the fastest is kept (default: 3)\n"
+        << "      --failures DIR    where reduced reproducers are written (default: difftest-failures)\n"
+        << "      --no-minimize     write diverging programs as they are\n"
+        << "      --program FILE    test FILE instead of random programs\n"
+        << "      --input FILE      input of the program given with --program\n"
+        << "  -o, --output FILE     write the totals of each mode to FILE as JSON\n"
+        << "  -h, --help            show this help" << std::endl;
+}
+
+int parse_arguments(int argc, char* argv[], Difftest_Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        auto value = [&](std::string& text) -> bool
+        {
+            if(i + 1 == argc)
+            {
+                std::cerr << "tiny_difftest: " << arg << " expects a value" << std::endl;
+                return false;
+            }
+            text = argv[++i];
+            return true;
+        };
+        auto count = [&](std::uint64_t& result) -> bool
+        {
+            std::string text;
+            if(!value(text))
+                return false;
+            char* end = nullptr;
+            result = std::strtoull(text.c_str(), &end, 10);
+            if(end == text.c_str() || *end != '\0')
+            {
+                std::cerr << "tiny_difftest: " << arg << " expects a number" << std::endl;
+                return false;
+            }
+            return true;
+        };
+
+        std::uint64_t figure = 0;
+        if(arg == "-h" || arg == "--help")
+        {
+            usage(std::cout);
+            return -1;
+        }
+        else if(arg == "-n" || arg == "--programs")
+        {
+            if(!count(figure))
+                return 2;
+            options.programs = std::size_t(figure);
+        }
+        else if(arg == "--seed")
+        {
+            if(!count(options.seed))
+                return 2;
+            options.seeded = true;
+        }
+        else if(arg == "--modes")
+        {
+            std::string list;
+            if(!value(list))
+                return 2;
+            options.modes.clear();
+            std::istringstream names(list);
+            std::string name;
+            while(std::getline(names, name, ','))
+            {
+                int mode = 0;
+                while(mode < int(Mode::COUNT_OF_MODES) && name != mode_name(Mode(mode)))
+                    mode++;
+                if(mode == int(Mode::COUNT_OF_MODES))
+                {
+                    std::cerr << "tiny_difftest: unknown mode " << name << std::endl;
+                    return 2;
+                }
+                options.modes.push_back(Mode(mode));
+            }
+        }
+        else if(arg == "--cxx")
+        {
+            if(!value(options.cxx))
+                return 2;
+        }
+        else if(arg == "--cxxflags")
+        {
+            if(!value(options.cxxflags))
+                return 2;
+        }
+        else if(arg == "--runs")
+        {
+            if(!count(figure) || figure == 0)
+                return 2;
+            options.runs = std::size_t(figure);
+        }
+        else if(arg == "--failures")
+        {
+            if(!value(options.failures))
+                return 2;
+        }
+        else if(arg == "--no-minimize")
+            options.minimize = false;
+        else if(arg == "--program")
+        {
+            if(!value(options.program))
+                return 2;
+        }
+        else if(arg == "--input")
+        {
+            if(!value(options.input))
+                return 2;
+        }
+        else if(arg == "-o" || arg == "--output")
+        {
+            if(!value(options.output))
+                return 2;
+        }
+        else
+        {
+            std::cerr << "tiny_difftest: unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool read_file(const std::string& path, std::string& content)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return bool(file);
+}
+
+std::string shell_quote(const std::string& text)
+{
+    std::string quoted = "'";
+    for(char c : text)
+    {
+        if(c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+}
+
+// Run a shell command, returning its duration in seconds or a negative number when it failed
+double timed_system(const std::string& command)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int status = std::system(command.c_str());
+    double seconds = seconds_since(start);
+    return status == 0 ? seconds : -1;
+}
+
+// Random programs accepted by both the translator and the VM, that end, and whose C++ has no undefined behaviour:
+// - every variable is declared at the top level, before any block, so it is in scope wherever it is used
+// - values stay below 1000 in magnitude after each assignment (mod 1000), so int arithmetic never overflows
+// - divisors are non zero integer literals, and mod is only applied to variables
+// - each WHILE counts a counter of its own from 0 to a small bound, and only its loop assigns it
+// INPUT only appears at the top level, so the program reads exactly the values generated with it
+class Program_Generator
+{
+ protected:
+    static const int variables = 6;
+    static const int max_depth = 3;
+
+    std::mt19937_64 random;
+    std::string source;
+    std::string input;
+    int statements_left;
+
+ public:
+    explicit Program_Generator(std::uint64_t seed) : random(seed), statements_left(0) {}
+
+    void generate(std::string& program, std::string& values)
+    {
+        source = "BEGIN\n";
+        input.clear();
+        for(int i = 0; i < variables; i++)
+        {
+            if(chance(2))
+            {
+                source += "INPUT v" + std::to_string(i) + "\n";
+                input += std::to_string(between(-1000, 1000)) + "\n";
+            }
+            else
+            {
+                source += "LET v" + std::to_string(i) + " = " + std::to_string(between(-1000, 1000)) + "\n";
+            }
+        }
+        for(int depth = 1; depth <= max_depth; depth++)
+            source += "LET c" + std::to_string(depth) + " = 0\n";
+
+        statements_left = between(10, 40);
+        while(statements_left > 0)
+            statement(0, "");
+        source += "END\n";
+
+        program.swap(source);
+        values.swap(input);
+    }
+
+ private:
+    int between(int low, int high) { return std::uniform_int_distribution<int>(low, high)(random); }
+
+    bool chance(int one_in) { return between(1, one_in) == 1; }
+
+    std::string variable() { return "v" + std::to_string(between(0, variables - 1)); }
+
+    std::string divisor()
+    {
+        return (chance(4) ? "-" : "") + std::to_string(between(1, 9));
+    }
+
+    // Literal, variable, or counter of an enclosing loop
+    std::string operand(int depth)
+    {
+        switch(between(0, 4))
+        {
+        case 0:
+            return std::to_string(between(-20, 20));
+        case 1:
+            return std::to_string(between(0, 99)) + "." + std::to_string(between(0, 9));
+        case 2:
+            if(depth > 0)
+                return "c" + std::to_string(between(1, depth));
+            return variable();
+        default:
+            return variable();
+        }
+    }
+
+    // Expression, and whether its value must be brought back below 1000
+    std::string expression(int depth, bool& grows)
+    {
+        static const char* const operators[] = {" + ", " - ", " * "};
+
+        grows = false;
+        switch(between(0, 5))
+        {
+        case 0:
+            return operand(depth);
+        case 1:
+            return variable() + " mod " + divisor();
+        case 2:
+            return operand(depth) + " / " + divisor();
+        default:
+            grows = true;
+            std::string left = operand(depth);
+            return left + operators[between(0, 2)] + operand(depth);
+        }
+    }
+
+    std::string condition(int depth)
+    {
+        static const char* const comparisons[] = {" > ", " < ", " == ", " >= ", " <= "};
+
+        bool grows;
+        std::string left = expression(depth, grows);
+        std::string comparison = comparisons[between(0, 4)];
+        return left + comparison + expression(depth, grows);
+    }
+
+    void block(int depth, const std::string& indent)
+    {
+        for(int count = between(1, 3); count > 0; count--)
+            statement(depth, indent);
+    }
+
+    void statement(int depth, const std::string& indent)
+    {
+        statements_left--;
+        int kind = between(0, 9);
+        if(depth < max_depth && kind < 2)
+        {
+            source += indent + "IF " + condition(depth) + "\n";
+            block(depth, indent + "   ");
+            while(chance(3))
+            {
+                source += indent + "ELSEIF " + condition(depth) + "\n";
+                block(depth, indent + "   ");
+            }
+            if(chance(2))
+            {
+                source += indent + "ELSE\n";
+                block(depth, indent + "   ");
+            }
+            source += indent + "ENDIF\n";
+        }
+        else if(depth < max_depth && kind < 4)
+        {
+            std::string counter = "c" + std::to_string(depth + 1);
+            source += indent + "LET " + counter + " = 0\n"
+                      + indent + "WHILE " + counter + " < " + std::to_string(between(1, 8)) + " REPEAT\n";
+            block(depth + 1, indent + "   ");
+            source += indent + "   LET " + counter + " = " + counter + " + 1\n"
+                      + indent + "ENDWHILE\n";
+        }
+        else if(kind < 7)
+        {
+            static const char* const words[] = {"a", "value", "is", "TINY", "x", "loop", "then"};
+            if(chance(3))
+            {
+                std::string text;
+                for(int count = between(0, 3); count > 0; count--)
+                    text += std::string(words[between(0, 6)]) + " ";
+                source += indent + "PRINT \"" + text + "\"\n";
+            }
+            else
+            {
+                source += indent + "PRINT " + (depth > 0 && chance(3) ? "c" + std::to_string(depth) : variable()) + "\n";
+            }
+        }
+        else
+        {
+            bool grows;
+            std::string target = variable();
+            source += indent + "LET " + target + " = " + expression(depth, grows) + "\n";
+            if(grows)
+                source += indent + "LET " + target + " = " + target + " mod 1000\n";
+        }
+    }
+};
+
+// Run source on the VM. Returns false when it is rejected or fails at run time
+bool run_reference(const std::string& source, const std::string& input, std::size_t runs, Outcome& outcome)
+{
+    std::ostringstream diagnostics;
+    TINY::Compiler compiler;
+    compiler.set_diagnostics(diagnostics);
+    TINY::VM vm;
+    vm.set_diagnostics(diagnostics);
+    vm.set_step_limit(step_limit);
+
+    TINY::Bytecode code;
+    std::stringstream program(source);
+    outcome = Outcome();
+    if(!compiler.compile(program, code))
+    {
+        outcome.error = diagnostics.str();
+        return false;
+    }
+
+    for(std::size_t run = 0; run < runs; run++)
+    {
+        std::istringstream values(input);
+        std::ostringstream output;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(!vm.run(code, values, output))
+        {
+            outcome.error = diagnostics.str();
+            return false;
+        }
+        double seconds = seconds_since(start);
+        outcome.seconds = run == 0 ? seconds : std::min(outcome.seconds, seconds);
+        outcome.output = output.str();
+    }
+    outcome.ok = true;
+    return true;
+}
+
+// C++ of source in mode. Returns false, with the diagnostics in error, when the translator rejects it
+bool emit(const std::string& source, Mode mode, std::string& code, std::string& error)
+{
+    TINY::Translator translator;
+    std::ostringstream diagnostics;
+    translator.set_diagnostics(diagnostics);
+    std::ostringstream output;
+    bool ok = true;
+
+    std::vector<TINY::Program_Piece> pieces;
+    if(mode == Mode::SPLIT && TINY::split_program(source, 1, pieces))
+    {
+        TINY::Translator::begin_output(output);
+        TINY::Translator::begin_main(output);
+        for(const TINY::Program_Piece& piece : pieces)
+        {
+            std::stringstream fragment(source.substr(piece.begin, piece.end - piece.begin));
+            ok = translator.translate_fragment(fragment, output, piece.declared) && ok;
+        }
+        TINY::Translator::end_main(output);
+    }
+    else
+    {
+        if(mode == Mode::COUNT)
+            translator.set_profiling(TINY::Translator::Profile_Mode::COUNT);
+        else if(mode == Mode::SAMPLE)
+            translator.set_profiling(TINY::Translator::Profile_Mode::SAMPLE);
+        std::stringstream program(source);
+        ok = translator.translate(program, output);
+    }
+
+    code = output.str();
+    error = diagnostics.str();
+    return ok;
+}
+
+// Translate source in mode, build its code in directory and run it on input
+Outcome run_mode(const Difftest_Options& options, const std::string& directory, const std::string& source,
+                 const std::string& input, Mode mode)
+{
+    Outcome outcome;
+    std::string code;
+    if(!emit(source, mode, code, outcome.error))
+    {
+        outcome.error = "rejected by the translator: " + outcome.error;
+        return outcome;
+    }
+
+    std::string base = directory + "/" + mode_name(mode);
+    std::ofstream(base + ".cpp", std::ios::binary) << code;
+    std::ofstream(directory + "/input", std::ios::binary) << input;
+
+    std::string cxx = options.cxx;
+    if(cxx.empty())
+        cxx = std::getenv("CXX") ? std::getenv("CXX") : "g++";
+    if(timed_system(shell_quote(cxx) + " " + options.cxxflags + " -o " + shell_quote(base) + " " + shell_quote(base + ".cpp")
+                    + " 2> " + shell_quote(base + ".err")) < 0)
+    {
+        read_file(base + ".err", outcome.error);
+        outcome.error = "emitted code does not build:\n" + outcome.error;
+        return outcome;
+    }
+
+    // The profiles the instrumented modes write stay in the directory
+    std::string command = "ulimit -t " + std::to_string(cpu_limit) + "; TINY_PROFILE=" + shell_quote(base + ".prof")
+                          + " TINY_SAMPLES=" + shell_quote(base + ".folded") + " " + shell_quote(base) + " < "
+                          + shell_quote(directory + "/input") + " > " + shell_quote(base + ".out") + " 2> /dev/null";
+    for(std::size_t run = 0; run < options.runs; run++)
+    {
+        double seconds = timed_system(command);
+        if(seconds < 0)
+        {
+            outcome.error = "emitted code failed or ran for more than " + std::to_string(cpu_limit) + " s";
+            return outcome;
+        }
+        outcome.seconds = run == 0 ? seconds : std::min(outcome.seconds, seconds);
+    }
+    read_file(base + ".out", outcome.output);
+    outcome.ok = true;
+    return outcome;
+}
+
+// Whether mode gives another outcome than the VM for source. Sources the VM rejects or cannot run do not diverge
+bool diverges(const Difftest_Options& options, const std::string& directory, const std::string& source,
+              const std::string& input, Mode mode)
+{
+    Outcome reference;
+    if(!run_reference(source, input, 1, reference))
+        return false;
+
+    Difftest_Options once = options;
+    once.runs = 1;
+    Outcome outcome = run_mode(once, directory, source, input, mode);
+    return !outcome.ok || outcome.output != reference.output;
+}
+
+// Last line of the statement starting at line begin (its ENDIF or ENDWHILE for blocks), npos when no statement starts
+// there
+std::size_t statement_end(const std::vector<std::string>& lines, std::size_t begin)
+{
+    auto keyword = [&](std::size_t i)
+    {
+        std::string word;
+        std::istringstream(lines[i]) >> word;
+        return word;
+    };
+
+    std::string first = keyword(begin);
+    if(first == "PRINT" || first == "INPUT" || first == "LET")
+        return begin;
+    if(first != "IF" && first != "WHILE")
+        return std::string::npos;
+
+    int depth = 0;
+    for(std::size_t i = begin; i < lines.size(); i++)
+    {
+        std::string word = keyword(i);
+        if(word == "IF" || word == "WHILE")
+            depth++;
+        else if((word == "ENDIF" || word == "ENDWHILE") && --depth == 0)
+            return i;
+    }
+    return std::string::npos;
+}
+
+// Reduce source for as long as mode still diverges: remove whole statements, last to first so that the uses of a
+// variable go before its declaration, then replace blocks by their body, then remove chunks of lines halving them down
+// to single lines (ddmin)
+std::string minimize(const Difftest_Options& options, const std::string& directory, const std::string& source,
+                     const std::string& input, Mode mode)
+{
+    std::vector<std::string> lines;
+    std::istringstream text(source);
+    for(std::string line; std::getline(text, line); )
+        lines.push_back(line + "\n");
+
+    auto join = [](const std::vector<std::string>& parts)
+    {
+        std::string joined;
+        for(const std::string& part : parts)
+            joined += part;
+        return joined;
+    };
+
+    for(bool reduced = true; reduced; )
+    {
+        reduced = false;
+        for(std::size_t begin = lines.size(); begin-- > 0; )
+        {
+            std::size_t end = begin < lines.size() ? statement_end(lines, begin) : std::string::npos;
+            if(end == std::string::npos)
+                continue;
+
+            std::vector<std::string> candidate(lines.begin(), lines.begin() + begin);
+            candidate.insert(candidate.end(), lines.begin() + end + 1, lines.end());
+            if(diverges(options, directory, join(candidate), input, mode))
+            {
+                lines.swap(candidate);
+                reduced = true;
+                continue;
+            }
+
+            if(end == begin)
+                continue;
+            candidate.assign(lines.begin(), lines.begin() + begin);
+            candidate.insert(candidate.end(), lines.begin() + begin + 1, lines.begin() + end);
+            candidate.insert(candidate.end(), lines.begin() + end + 1, lines.end());
+            if(diverges(options, directory, join(candidate), input, mode))
+            {
+                lines.swap(candidate);
+                reduced = true;
+            }
+        }
+    }
+
+    std::size_t chunks = 2;
+    while(lines.size() >= 2)
+    {
+        std::size_t size = (lines.size() + chunks - 1) / chunks;
+        bool reduced = false;
+        for(std::size_t begin = 0; begin < lines.size(); begin += size)
+        {
+            std::vector<std::string> candidate(lines.begin(), lines.begin() + begin);
+            candidate.insert(candidate.end(), lines.begin() + std::min(begin + size, lines.size()), lines.end());
+            if(diverges(options, directory, join(candidate), input, mode))
+            {
+                lines.swap(candidate);
+                chunks = std::max<std::size_t>(chunks - 1, 2);
+                reduced = true;
+                break;
+            }
+        }
+
+        if(!reduced)
+        {
+            if(size == 1)
+                break;
+            chunks = std::min(chunks * 2, lines.size());
+        }
+    }
+    return join(lines);
+}
+
+// Compare every mode to the VM on one program. Returns false when a mode diverged
+bool test_program(const Difftest_Options& options, const std::string& directory, const std::string& name,
+                  const std::string& source, const std::string& input, Mode_Totals& reference_totals,
+                  std::vector<Mode_Totals>& totals)
+{
+    Outcome reference;
+    if(!run_reference(source, input, options.runs, reference))
+    {
+        std::cerr << "tiny_difftest: " << name << ": skipped, the VM cannot run it: " << reference.error;
+        return true;
+    }
+    reference_totals.programs++;
+    reference_totals.seconds += reference.seconds;
+
+    bool same = true;
+    for(std::size_t i = 0; i < options.modes.size(); i++)
+    {
+        Mode mode = options.modes[i];
+        Outcome outcome = run_mode(options, directory, source, input, mode);
+        totals[i].programs++;
+        totals[i].seconds += outcome.seconds;
+        if(outcome.ok && outcome.output == reference.output)
+            continue;
+
+        same = false;
+        totals[i].divergences++;
+        std::cerr << "tiny_difftest: " << name << ": " << mode_name(mode) << " diverges from the VM: "
+                  << (outcome.ok ? "different output" : outcome.error) << std::endl;
+
+        std::string reduced = options.minimize ? minimize(options, directory, source, input, mode) : source;
+        std::error_code ec;
+        std::filesystem::create_directories(options.failures, ec);
+        std::string base = options.failures + "/" + name + "-" + mode_name(mode);
+        std::ofstream(base + ".txt", std::ios::binary) << reduced;
+        std::ofstream(base + ".in", std::ios::binary) << input;
+        std::cerr << "tiny_difftest: reproducer written to " << base << ".txt (input: " << base << ".in)" << std::endl;
+    }
+    return same;
+}
+
+std::string results_json(const Difftest_Options& options, const Mode_Totals& reference,
+                         const std::vector<Mode_Totals>& totals)
+{
+    char number[128];
+    std::snprintf(number, sizeof number, "{\"seed\":%llu,\"programs\":%zu,\"modes\":[",
+                  static_cast<unsigned long long>(options.seed), reference.programs);
+    std::string json = number;
+    for(std::size_t i = 0; i <= totals.size(); i++)
+    {
+        const Mode_Totals& mode = i == 0 ? reference : totals[i - 1];
+        json += i ? ",\n" : "\n";
+        json += "{\"name\":";
+        TINY::put_json_string(json, i == 0 ? "vm" : mode_name(options.modes[i - 1]));
+        std::snprintf(number, sizeof number, ",\"programs\":%zu,\"divergences\":%zu,\"seconds\":%.6g}", mode.programs,
+                      mode.divergences, mode.seconds);
+        json += number;
+    }
+    return json + "\n]}\n";
+}
+
+int run_difftest(Difftest_Options& options)
+{
+    if(!options.seeded)
+        options.seed = std::random_device()();
+
+    char directory_template[] = "/tmp/tiny_difftest.XXXXXX";
+    if(!mkdtemp(directory_template))
+    {
+        std::cerr << "tiny_difftest: cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    std::string directory = directory_template;
+
+    Mode_Totals reference;
+    std::vector<Mode_Totals> totals(options.modes.size());
+    bool same = true;
+    if(!options.program.empty())
+    {
+        std::string source;
+        std::string input;
+        if(!read_file(options.program, source) || (!options.input.empty() && !read_file(options.input, input)))
+        {
+            std::cerr << "tiny_difftest: cannot read " << options.program << " or its input" << std::endl;
+            return 1;
+        }
+        same = test_program(options, directory, std::filesystem::path(options.program).stem().string(), source,
+                            input, reference, totals);
+    }
+    else
+    {
+        std::cout << "seed " << options.seed << ", " << options.programs << " programs" << std::endl;
+        for(std::size_t i = 0; i < options.programs; i++)
+        {
+            std::string source;
+            std::string input;
+            Program_Generator(options.seed + i).generate(source, input);
+            same = test_program(options, directory, "random-" + std::to_string(options.seed + i), source, input,
+                                reference, totals) && same;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+
+    // Run times of the VM and of each mode over the same programs
+    std::printf("%-8s %9s %12s %12s %10s\n", "mode", "programs", "divergences", "run (ms)", "vs plain");
+    double plain = -1;
+    for(std::size_t i = 0; i < options.modes.size(); i++)
+        if(options.modes[i] == Mode::PLAIN)
+            plain = totals[i].seconds;
+    for(std::size_t i = 0; i <= totals.size(); i++)
+    {
+        const Mode_Totals& mode = i == 0 ? reference : totals[i - 1];
+        char ratio[32] = "-";
+        if(plain > 0)
+            std::snprintf(ratio, sizeof ratio, "%.2fx", mode.seconds / plain);
+        std::printf("%-8s %9zu %12zu %12.3f %10s\n", i == 0 ? "vm" : mode_name(options.modes[i - 1]), mode.programs,
+                    mode.divergences, 1000 * mode.seconds, ratio);
+    }
+    std::fflush(stdout);
+
+    if(!options.output.empty() && !(std::ofstream(options.output) << results_json(options, reference, totals)))
+    {
+        std::cerr << "tiny_difftest: cannot write " << options.output << std::endl;
+        return 1;
+    }
+    return same ? 0 : 1;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    Difftest_Options options;
+    int status = parse_arguments(argc, argv, options);
+    if(status != 0)
+        return status < 0 ? 0 : status;
+
+    return run_difftest(options);
+}
@@ -0,0 +1,318 @@
+// Fuzz targets of the front end, for libFuzzer, on in-memory input
+//
+// Build: clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined tiny_fuzz.cpp -o tiny_fuzz
+//        clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DTINY_FUZZ_LEXER tiny_fuzz.cpp -o tiny_fuzz_lexer
+// Run:   ./tiny_fuzz -dict=fuzz/tiny.dict fuzz/corpus samples
+//
+// The translation target translates the input through View_Streambuf, whose putback goes to an overlay, and through
+// a stringstream: both must give the same result. The VM's compiler must accept the input exactly when the translator
+// does. Built as C++20, Static_Compiler (tiny_constexpr.hpp), run at run time, must also accept it exactly then, unless
+// for a floating literal it cannot convert, and give the Compiler's instructions or error. The lexer target reads every token, moves back and reads it again, which must give the same token.
+//
+// Without libFuzzer, -DTINY_FUZZ_STANDALONE adds a main() that runs the corpus, then random mutations of it, and
+// reports the executions per second, the throughput of the front end on small malformed inputs:
+//
+//        g++ -std=c++17 -O2 -DTINY_FUZZ_STANDALONE tiny_fuzz.cpp -o tiny_fuzz
+//        ./tiny_fuzz -runs=200000 -o fuzz.json fuzz/corpus samples
+//
+// fuzz.json is in the format of tiny_bench, so that tiny_bench --compare tracks the executions per second.
+
+#include "tiny_language (1).hpp"
+#include "tiny_vm.hpp"
+#include "tiny_stream.hpp"
+#if __cplusplus >= 202002L
+#include "tiny_constexpr.hpp"
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+
+namespace
+{
+// Report a broken property with the input that broke it, and crash so that the fuzzer keeps the input
+[[noreturn]] void fail(const char* what, const std::string& input)
+{
+    std::cerr << "tiny_fuzz: " << what << "\n--- input (" << input.size() << " bytes) ---\n" << input << "\n---"
+              << std::endl;
+    std::abort();
+}
+}
+
+#ifndef TINY_FUZZ_LEXER
+namespace
+{
+struct Translation
+{
+    bool ok;
+    std::string code;
+    std::string diagnostics;
+};
+
+Translation translate(std::iostream& input)
+{
+    static TINY::Translator translator;
+    std::ostringstream diagnostics;
+    translator.set_diagnostics(diagnostics);
+
+    Translation translation;
+    std::string code;
+    TINY::String_Streambuf output_buffer(code);
+    std::ostream output(&output_buffer);
+    translation.ok = translator.translate(input, output);
+    output.flush();
+    translation.code = code;
+    translation.diagnostics = diagnostics.str();
+    return translation;
+}
+
+void fuzz_translation(const std::string& source)
+{
+    TINY::View_Streambuf view_buffer(source.data(), source.size());
+    std::iostream view(&view_buffer);
+    Translation from_view = translate(view);
+
+    std::stringstream stream(source);
+    Translation from_stream = translate(stream);
+
+    if(from_view.ok != from_stream.ok || from_view.code != from_stream.code
+       || from_view.diagnostics != from_stream.diagnostics)
+        fail("View_Streambuf and stringstream translate differently", source);
+
+    static TINY::Compiler compiler;
+    std::ostringstream diagnostics;
+    compiler.set_diagnostics(diagnostics);
+    TINY::Bytecode code;
+    std::stringstream program(source);
+    if(compiler.compile(program, code) != from_view.ok)
+        fail(from_view.ok ? "the translator accepts what the VM rejects" : "the VM accepts what the translator rejects",
+             source);
+
+#if __cplusplus >= 202002L
+    TINY::Static_Result result = TINY::Static_Compiler().compile(source);
+    if(!result.ok())
+    {
+        std::string message = std::string(result.error.kind) + ": " + result.error.message + std::string(result.error.detail);
+        if(message.rfind("Syntax Error: Floating literal not exactly convertible", 0) == 0)
+            return;
+        if(from_view.ok)
+            fail("the translator accepts what Static_Compiler rejects", source);
+        if(message + "\n" != diagnostics.str())
+            fail("Static_Compiler and the VM report different errors", source);
+    }
+    else if(!from_view.ok)
+    {
+        fail("Static_Compiler accepts what the translator rejects", source);
+    }
+    else if(!std::equal(result.code.begin(), result.code.end(), code.code.begin(), code.code.end(),
+                        [](const TINY::Instruction& a, const TINY::Instruction& b)
+                        { return a.op == b.op && a.operand == b.operand; })
+            || !std::equal(result.constants.begin(), result.constants.end(), code.constants.begin(), code.constants.end(),
+                           [](const TINY::Value& a, const TINY::Value& b)
+                           { return a.real == b.real && a.integer == b.integer && a.number == b.number; }))
+    {
+        fail("Static_Compiler and the VM emit different instructions", source);
+    }
+#endif
+}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    fuzz_translation(std::string(reinterpret_cast<const char*>(data), size));
+    return 0;
+}
+#else
+// Friend of the translator, to use its lexer directly
+struct TINY::Lexer_Fuzz
+{
+    using Token = Translator::Token;
+
+    static void run(const std::string& source)
+    {
+        View_Streambuf buffer(source.data(), source.size());
+        std::iostream input(&buffer);
+        Translator::Lexer lexer(input);
+
+        // Every token takes at least one character, the bound only guards against a lexer that stops moving
+        try
+        {
+            for(std::size_t tokens = 0; tokens <= source.size(); tokens++)
+            {
+                lexer.advance(tokens % 2 == 0);
+                Token token = lexer.get_current_token();
+                std::string text = lexer.get_current_text();
+                std::size_t line = lexer.get_line();
+                if(token == Token::EOFSTREAM)
+                    return;
+
+                lexer.move_back();
+                lexer.advance(tokens % 2 == 0);
+                if(lexer.get_current_token() != token || lexer.get_current_text() != text || lexer.get_line() != line)
+                    fail("reading a token again after move_back gives another token", source);
+            }
+            fail("the lexer does not reach the end of the input", source);
+        }
+        catch(Lexical_Error&)
+        {
+        }
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    TINY::Lexer_Fuzz::run(std::string(reinterpret_cast<const char*>(data), size));
+    return 0;
+}
+#endif
+
+#ifdef TINY_FUZZ_STANDALONE
+#include <fstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+
+#include "tiny_json.hpp"
+
+namespace
+{
+// Tokens inserted by the mutations, as in fuzz/tiny.dict
+const char* const dictionary[] = {"BEGIN", "END", "PRINT", "INPUT", "LET", "IF", "ELSEIF", "ELSE", "ENDIF", "WHILE",
+                                  "REPEAT", "ENDWHILE", "mod", "=", "==", "<=", ">=", "<", ">", "+", "-", "*", "/",
+                                  "\"", "\n", " ", ".", "e", "1.5e+3", "x"};
+
+// One of libFuzzer's simple mutations: change, insert or erase bytes, insert a token, or splice another input in
+std::string mutate(std::string input, const std::vector<std::string>& corpus, std::mt19937_64& random)
+{
+    auto below = [&](std::size_t bound) { return bound ? std::size_t(random() % bound) : 0; };
+
+    switch(below(6))
+    {
+    case 0:
+        if(!input.empty())
+            input[below(input.size())] = char(random());
+        break;
+    case 1:
+        input.insert(below(input.size() + 1), 1, char(random()));
+        break;
+    case 2:
+        if(!input.empty())
+        {
+            std::size_t at = below(input.size());
+            input.erase(at, 1 + below(std::min<std::size_t>(8, input.size() - at)));
+        }
+        break;
+    case 3:
+    case 4:
+        input.insert(below(input.size() + 1), dictionary[below(sizeof dictionary / sizeof *dictionary)]);
+        break;
+    default:
+    {
+        const std::string& other = corpus[below(corpus.size())];
+        std::size_t from = below(other.size() + 1);
+        input.insert(below(input.size() + 1), other, from, below(other.size() - from + 1));
+        break;
+    }
+    }
+    return input;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    std::uint64_t runs = 100000;
+    std::uint64_t seed = 1;
+    std::string output;
+    std::vector<std::string> corpus;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg.rfind("-runs=", 0) == 0)
+            runs = std::strtoull(arg.c_str() + 6, nullptr, 10);
+        else if(arg.rfind("-seed=", 0) == 0)
+            seed = std::strtoull(arg.c_str() + 6, nullptr, 10);
+        else if(arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else if(arg.rfind("-", 0) == 0)
+            std::cerr << "tiny_fuzz: ignoring " << arg << std::endl;
+        else
+        {
+            std::vector<std::filesystem::path> paths;
+            std::error_code ec;
+            if(std::filesystem::is_directory(arg, ec))
+            {
+                for(const auto& entry : std::filesystem::directory_iterator(arg, ec))
+                    if(entry.is_regular_file())
+                        paths.push_back(entry.path());
+                std::sort(paths.begin(), paths.end());
+            }
+            else
+            {
+                paths.push_back(arg);
+            }
+
+            for(const auto& path : paths)
+            {
+                std::ifstream file(path, std::ios::binary);
+                std::ostringstream content;
+                content << file.rdbuf();
+                corpus.push_back(content.str());
+            }
+        }
+    }
+
+    if(corpus.empty())
+        corpus.push_back("BEGIN\nEND\n");
+
+    auto start = std::chrono::steady_clock::now();
+    for(const std::string& input : corpus)
+        LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+
+    std::mt19937_64 random(seed);
+    for(std::uint64_t run = 0; run < runs; run++)
+    {
+        std::string input = corpus[random() % corpus.size()];
+        for(std::size_t mutations = 1 + random() % 4; mutations > 0; mutations--)
+            input = mutate(input, corpus, random);
+        LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::uint64_t executions = corpus.size() + runs;
+    double rate = seconds > 0 ? double(executions) / seconds : 0;
+    std::printf("tiny_fuzz: %llu executions in %.3f s, %.0f exec/s\n", static_cast<unsigned long long>(executions),
+                seconds, rate);
+
+    if(!output.empty())
+    {
+#ifdef TINY_FUZZ_LEXER
+        const char* name = "fuzz/lexer";
+#else
+        const char* name = "fuzz/translate";
+#endif
+        char figures[128];
+        std::string json = "{\"version\":";
+        TINY::put_json_string(json, TINY_TRANSLATOR_VERSION);
+        json += ",\"benchmarks\":[\n{\"name\":";
+        TINY::put_json_string(json, name);
+        std::snprintf(figures, sizeof figures, ",\"value\":%.6g,\"unit\":\"exec/s\",\"executions\":%llu,\"seconds\":%.6g}",
+                      rate, static_cast<unsigned long long>(executions), seconds);
+        json += figures;
+        json += "\n]}\n";
+        if(!(std::ofstream(output) << json))
+        {
+            std::cerr << "tiny_fuzz: cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif
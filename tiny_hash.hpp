@@ -0,0 +1,37 @@
+#ifndef TINY_HASH_HPP_INCLUDED
+#define TINY_HASH_HPP_INCLUDED
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace TINY
+{
+// 64 bit FNV-1a hash of a byte range, used to address sources and results by content
+inline std::uint64_t content_hash(const char* data, std::size_t size, std::uint64_t seed = 14695981039346656037ull)
+{
+    std::uint64_t hash = seed;
+    for(std::size_t i = 0; i < size; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline std::uint64_t content_hash(const std::string& data)
+{
+    return content_hash(data.data(), data.size());
+}
+
+// Fixed width hexadecimal form of a hash
+inline std::string hash_string(std::uint64_t hash)
+{
+    char text[17];
+    std::snprintf(text, sizeof text, "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+}
+
+#endif // TINY_HASH_HPP_INCLUDED
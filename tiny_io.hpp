@@ -0,0 +1,753 @@
+#ifndef TINY_IO_HPP_INCLUDED
+#define TINY_IO_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_batch.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define TINY_HAVE_IO_URING 1
+#else
+#define TINY_HAVE_IO_URING 0
+#endif
+
+namespace TINY
+{
+// Failures of the I/O layer itself, as opposed to a file that cannot be read or written
+using Io_Error = Error<4>;
+
+// Content of an input file, or the errno that prevented reading it
+struct Loaded_File
+{
+    std::string content;
+    int error = 0;
+};
+
+// Reads and writes many whole files at once, counting the system calls it makes
+class Bulk_Io
+{
+ protected:
+    std::uint64_t syscalls;
+
+ public:
+    Bulk_Io() : syscalls(0) {}
+    virtual ~Bulk_Io() {}
+
+    virtual const char* name() const = 0;
+
+    // files[i] receives the content of paths[i]
+    virtual void read_files(const std::vector<std::string>& paths, std::vector<Loaded_File>& files) = 0;
+
+    // Create or truncate paths[i] with *contents[i], errors[i] receives 0 or the errno of the failure
+    virtual void write_files(const std::vector<std::string>& paths, const std::vector<const std::string*>& contents,
+                             std::vector<int>& errors) = 0;
+
+    std::uint64_t get_syscalls() const { return syscalls; }
+};
+
+// Plain open/fstat/read/write/close, one file after the other. Works everywhere
+class Posix_Io : public Bulk_Io
+{
+ public:
+    const char* name() const override { return "posix"; }
+
+    void read_files(const std::vector<std::string>& paths, std::vector<Loaded_File>& files) override
+    {
+        files.assign(paths.size(), Loaded_File());
+        for(std::size_t i = 0; i < paths.size(); i++)
+        {
+            syscalls++;
+            int fd = ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+            {
+                files[i].error = errno;
+                continue;
+            }
+
+            struct stat info;
+            syscalls++;
+            if(::fstat(fd, &info) == 0)
+                files[i].content.resize(std::size_t(info.st_size));
+
+            std::size_t done = 0;
+            while(true)
+            {
+                if(done == files[i].content.size())
+                    files[i].content.resize(done + 4096); // Grown since fstat, or not a regular file
+
+                syscalls++;
+                ssize_t got = ::read(fd, &files[i].content[done], files[i].content.size() - done);
+                if(got < 0 && errno == EINTR)
+                    continue;
+                if(got < 0)
+                    files[i].error = errno;
+                if(got <= 0)
+                    break;
+                done += std::size_t(got);
+            }
+            files[i].content.resize(done);
+
+            syscalls++;
+            ::close(fd);
+        }
+    }
+
+    void write_files(const std::vector<std::string>& paths, const std::vector<const std::string*>& contents,
+                     std::vector<int>& errors) override
+    {
+        errors.assign(paths.size(), 0);
+        for(std::size_t i = 0; i < paths.size(); i++)
+        {
+            syscalls++;
+            int fd = ::open(paths[i].c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(fd < 0)
+            {
+                errors[i] = errno;
+                continue;
+            }
+
+            const std::string& content = *contents[i];
+            std::size_t done = 0;
+            while(done < content.size())
+            {
+                syscalls++;
+                ssize_t written = ::write(fd, content.data() + done, content.size() - done);
+                if(written < 0 && errno == EINTR)
+                    continue;
+                if(written <= 0)
+                {
+                    errors[i] = errno;
+                    break;
+                }
+                done += std::size_t(written);
+            }
+
+            syscalls++;
+            ::close(fd);
+        }
+    }
+};
+
+#if TINY_HAVE_IO_URING
+// io_uring without liburing. Files are handled in groups: one io_uring_enter submits the opens (and statx) of the
+// whole group and waits for them, a second one its reads or writes, a third one its closes. A group of n files
+// costs 3 system calls instead of about 4n. Each read asks for one byte more than statx reported, so a read shorter
+// than that proves the end of the file without another call
+class Uring_Io : public Bulk_Io
+{
+ protected:
+    int ring_fd;
+    unsigned entries;
+
+    void* sq_ring;
+    void* cq_ring;
+    std::size_t sq_ring_size;
+    std::size_t cq_ring_size;
+    io_uring_sqe* sqes;
+    std::size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    Uring_Io() : ring_fd(-1), entries(0), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sq_ring_size(0), cq_ring_size(0),
+                 sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), sqes_size(0) {}
+
+ public:
+    // nullptr when the kernel (or a seccomp policy, as in many containers) does not allow io_uring, or lacks one of
+    // the operations used here
+    static std::unique_ptr<Uring_Io> create(unsigned ring_entries = 256)
+    {
+        std::unique_ptr<Uring_Io> uring(new Uring_Io());
+        if(!uring->setup(ring_entries))
+            return nullptr;
+        return uring;
+    }
+
+    Uring_Io(const Uring_Io&) = delete;
+    Uring_Io(Uring_Io&&) = delete;
+
+    ~Uring_Io() override
+    {
+        if(sqes != MAP_FAILED)
+            ::munmap(sqes, sqes_size);
+        if(cq_ring != MAP_FAILED && cq_ring != sq_ring)
+            ::munmap(cq_ring, cq_ring_size);
+        if(sq_ring != MAP_FAILED)
+            ::munmap(sq_ring, sq_ring_size);
+        if(ring_fd >= 0)
+            ::close(ring_fd);
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    void read_files(const std::vector<std::string>& paths, std::vector<Loaded_File>& files) override
+    {
+        files.assign(paths.size(), Loaded_File());
+        std::size_t group = entries / 2; // An open and a statx per file
+
+        for(std::size_t first = 0; first < paths.size(); first += group)
+        {
+            std::size_t count = std::min(group, paths.size() - first);
+            std::vector<int> fds(count, -1);
+            std::vector<struct statx> infos(count);
+
+            for(std::size_t i = 0; i < count; i++)
+            {
+                io_uring_sqe* sqe = next_sqe(IORING_OP_OPENAT, 2 * i);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<std::uintptr_t>(paths[first + i].c_str());
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+                sqe = next_sqe(IORING_OP_STATX, 2 * i + 1);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<std::uintptr_t>(paths[first + i].c_str());
+                sqe->len = STATX_SIZE;
+                sqe->off = reinterpret_cast<std::uintptr_t>(&infos[i]);
+            }
+            for_each_completion(2 * count, [&](std::uint64_t tag, int result)
+            {
+                std::size_t i = tag / 2;
+                if(tag % 2 == 0)
+                {
+                    if(result < 0)
+                        files[first + i].error = -result;
+                    else
+                        fds[i] = result;
+                }
+                else if(result == 0)
+                {
+                    files[first + i].content.resize(std::size_t(infos[i].stx_size) + 1);
+                }
+            });
+
+            std::size_t reads = 0;
+            for(std::size_t i = 0; i < count; i++)
+            {
+                if(fds[i] < 0 || files[first + i].content.empty())
+                    continue;
+                io_uring_sqe* sqe = next_sqe(IORING_OP_READ, i);
+                sqe->fd = fds[i];
+                sqe->addr = reinterpret_cast<std::uintptr_t>(&files[first + i].content[0]);
+                sqe->len = unsigned(files[first + i].content.size());
+                sqe->off = 0;
+                reads++;
+            }
+            std::vector<std::size_t> got(count, 0);
+            for_each_completion(reads, [&](std::uint64_t i, int result)
+            {
+                if(result < 0)
+                    files[first + i].error = -result;
+                else
+                    got[i] = std::size_t(result);
+            });
+
+            for(std::size_t i = 0; i < count; i++)
+            {
+                if(fds[i] < 0)
+                    continue;
+
+                // A read filling the buffer means the file grew since statx, and a file without statx has no read
+                // yet: those are finished synchronously
+                Loaded_File& file = files[first + i];
+                if(file.error == 0 && (file.content.empty() || got[i] == file.content.size()))
+                    finish_read(fds[i], file, got[i]);
+                else
+                    file.content.resize(got[i]);
+            }
+
+            close_all(fds);
+        }
+    }
+
+    void write_files(const std::vector<std::string>& paths, const std::vector<const std::string*>& contents,
+                     std::vector<int>& errors) override
+    {
+        errors.assign(paths.size(), 0);
+
+        for(std::size_t first = 0; first < paths.size(); first += entries)
+        {
+            std::size_t count = std::min<std::size_t>(entries, paths.size() - first);
+            std::vector<int> fds(count, -1);
+
+            for(std::size_t i = 0; i < count; i++)
+            {
+                io_uring_sqe* sqe = next_sqe(IORING_OP_OPENAT, i);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<std::uintptr_t>(paths[first + i].c_str());
+                sqe->len = 0644;
+                sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            }
+            for_each_completion(count, [&](std::uint64_t i, int result)
+            {
+                if(result < 0)
+                    errors[first + i] = -result;
+                else
+                    fds[i] = result;
+            });
+
+            std::size_t writes = 0;
+            for(std::size_t i = 0; i < count; i++)
+            {
+                if(fds[i] < 0 || contents[first + i]->empty())
+                    continue;
+                io_uring_sqe* sqe = next_sqe(IORING_OP_WRITE, i);
+                sqe->fd = fds[i];
+                sqe->addr = reinterpret_cast<std::uintptr_t>(contents[first + i]->data());
+                sqe->len = unsigned(contents[first + i]->size());
+                sqe->off = 0;
+                writes++;
+            }
+            for_each_completion(writes, [&](std::uint64_t i, int result)
+            {
+                if(result < 0)
+                {
+                    errors[first + i] = -result;
+                    return;
+                }
+
+                // Short writes are finished synchronously
+                const std::string& content = *contents[first + i];
+                std::size_t done = std::size_t(result);
+                while(done < content.size())
+                {
+                    syscalls++;
+                    ssize_t written = ::pwrite(fds[i], content.data() + done, content.size() - done, off_t(done));
+                    if(written <= 0)
+                    {
+                        errors[first + i] = errno;
+                        break;
+                    }
+                    done += std::size_t(written);
+                }
+            });
+
+            close_all(fds);
+        }
+    }
+
+ private:
+    bool setup(unsigned ring_entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof params);
+
+        syscalls++;
+        ring_fd = int(::syscall(__NR_io_uring_setup, ring_entries, &params));
+        if(ring_fd < 0)
+            return false;
+        entries = params.sq_entries;
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if(params.features & IORING_FEAT_SINGLE_MMAP)
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+        syscalls++;
+        sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if(sq_ring == MAP_FAILED)
+            return false;
+
+        if(params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            cq_ring = sq_ring;
+        }
+        else
+        {
+            syscalls++;
+            cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if(cq_ring == MAP_FAILED)
+                return false;
+        }
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        syscalls++;
+        void* mapped = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if(mapped == MAP_FAILED)
+            return false;
+        sqes = static_cast<io_uring_sqe*>(mapped);
+
+        char* sq = static_cast<char*>(sq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return probe_operations();
+    }
+
+    // Whether the kernel has every operation used here. IORING_REGISTER_PROBE came with the same kernel (5.6) as
+    // IORING_OP_OPENAT and IORING_OP_READ, so a kernel without it lacks them too
+    bool probe_operations()
+    {
+        const unsigned char used[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE};
+        const unsigned ops = 256;
+        std::vector<std::uint64_t> buffer((sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op)) / sizeof(std::uint64_t) + 1);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+        syscalls++;
+        if(::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, ops) < 0)
+            return false;
+        for(unsigned char op : used)
+        {
+            if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                return false;
+        }
+        return true;
+    }
+
+    // Queue a submission, published to the kernel by the next enter. Callers never queue more than entries at once
+    io_uring_sqe* next_sqe(unsigned char opcode, std::uint64_t tag)
+    {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof *sqe);
+        sqe->opcode = opcode;
+        sqe->user_data = tag;
+
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    // Submit everything queued, wait for count completions and hand each of them to handle(tag, result)
+    template<class Handler>
+    void for_each_completion(std::size_t count, Handler handle)
+    {
+        unsigned to_submit = *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        std::size_t done = 0;
+
+        while(done < count)
+        {
+            syscalls++;
+            int entered = int(::syscall(__NR_io_uring_enter, ring_fd, to_submit, unsigned(count - done), IORING_ENTER_GETEVENTS, nullptr, 0));
+            if(entered < 0 && errno != EINTR)
+                throw Io_Error{std::string("io_uring_enter failed: ") + std::strerror(errno)};
+            if(entered > 0)
+                to_submit -= unsigned(entered);
+
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for(; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = cqes[head & *cq_mask];
+                handle(cqe.user_data, cqe.res);
+                done++;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    void finish_read(int fd, Loaded_File& file, std::size_t done)
+    {
+        while(true)
+        {
+            if(done == file.content.size())
+                file.content.resize(done + 4096);
+
+            syscalls++;
+            ssize_t got = ::pread(fd, &file.content[done], file.content.size() - done, off_t(done));
+            if(got < 0 && errno == EINTR)
+                continue;
+            if(got < 0)
+                file.error = errno;
+            if(got <= 0)
+                break;
+            done += std::size_t(got);
+        }
+        file.content.resize(done);
+    }
+
+    void close_all(const std::vector<int>& fds)
+    {
+        std::size_t closes = 0;
+        for(std::size_t i = 0; i < fds.size(); i++)
+        {
+            if(fds[i] < 0)
+                continue;
+            io_uring_sqe* sqe = next_sqe(IORING_OP_CLOSE, i);
+            sqe->fd = fds[i];
+            closes++;
+        }
+        for_each_completion(closes, [](std::uint64_t, int) {});
+    }
+};
+#endif
+
+enum class Io_Backend { FSTREAM, POSIX, URING };
+
+// io_uring when requested and available, plain system calls otherwise. nullptr for FSTREAM, which is the
+// translator's own file handling
+inline std::unique_ptr<Bulk_Io> make_bulk_io(Io_Backend backend)
+{
+#if TINY_HAVE_IO_URING
+    if(backend == Io_Backend::URING)
+    {
+        if(std::unique_ptr<Uring_Io> uring = Uring_Io::create())
+            return uring;
+    }
+#endif
+    if(backend == Io_Backend::FSTREAM)
+        return nullptr;
+    return std::unique_ptr<Bulk_Io>(new Posix_Io());
+}
+
+// Where the time of a bulk batch went
+struct Io_Report
+{
+    std::string backend;
+    std::size_t files = 0;
+    std::uint64_t syscalls = 0;
+    bool syscalls_estimated = false; // fstream calls are not visible to us, see read_proc_io_calls
+    std::string failure;             // Why the backend failed mid-batch, the groups left went through Posix_Io
+    double read_seconds = 0;
+    double translate_seconds = 0;
+    double write_seconds = 0;
+    double wall_seconds = 0;
+};
+
+// read(2) and write(2) calls made by this process so far (syscr + syscw of /proc/self/io), 0 when unavailable
+inline std::uint64_t read_proc_io_calls()
+{
+    std::ifstream proc("/proc/self/io");
+    std::string key;
+    std::uint64_t value, total = 0;
+    while(proc >> key >> value)
+    {
+        if(key == "syscr:" || key == "syscw:")
+            total += value;
+    }
+    return total;
+}
+
+inline void print_io_report(const Io_Report& report, std::ostream& out)
+{
+    char line[160];
+    std::snprintf(line, sizeof line, "io: %s, %zu files, %llu syscalls%s, ", report.backend.c_str(), report.files,
+                  static_cast<unsigned long long>(report.syscalls),
+                  report.syscalls_estimated ? " (estimated: reads and writes counted, 3 opens and 3 closes assumed per file)" : "");
+    out << line;
+
+    // The fstream path interleaves reading, translating and writing, there are no phases to tell apart
+    if(!report.syscalls_estimated)
+    {
+        std::snprintf(line, sizeof line, "read %.3fs, translate %.3fs, write %.3fs, ", report.read_seconds,
+                      report.translate_seconds, report.write_seconds);
+        out << line;
+    }
+    std::snprintf(line, sizeof line, "wall %.3fs\n", report.wall_seconds);
+    out << line << std::flush;
+}
+
+// Translate a batch with all file access going through io: inputs are read group by group, translated in memory on
+// the scheduler, and the outputs of the group written together. Diagnostics are the ones of translate_batch.
+// Files are always translated whole, --parallel-lex does not apply
+inline Batch_Result translate_batch_bulk(const std::vector<std::string>& inputs, const Batch_Options& options,
+                                         Bulk_Io& io, Io_Report& report, std::size_t group_size = 4096)
+{
+    using clock = std::chrono::steady_clock;
+    auto seconds = [](clock::duration duration) { return std::chrono::duration<double>(duration).count(); };
+    clock::time_point start = clock::now();
+
+    Batch_Result batch;
+    batch.files.resize(inputs.size());
+
+    std::size_t workers = options.jobs == 0 ? Work_Stealing_Scheduler::default_size() : options.jobs;
+    Work_Stealing_Scheduler scheduler(std::min(workers, std::max<std::size_t>(inputs.size(), 1)));
+
+    // When the backend fails (io_uring_enter refused), the group it failed on is done again and the groups after it
+    // go through plain system calls. Reading and writing a group twice gives the same files. Descriptors the failed
+    // backend had opened stay open until the process exits
+    Bulk_Io* p_io = &io;
+    std::unique_ptr<Bulk_Io> fallback;
+    auto fall_back = [&](const Io_Error& er)
+    {
+        if(fallback)
+            throw er;
+        report.failure = er.what();
+        fallback.reset(new Posix_Io());
+        p_io = fallback.get();
+    };
+    auto read_files = [&](const std::vector<std::string>& paths, std::vector<Loaded_File>& files)
+    {
+        try
+        {
+            p_io->read_files(paths, files);
+        }
+        catch(Io_Error& er)
+        {
+            fall_back(er);
+            p_io->read_files(paths, files);
+        }
+    };
+    auto write_files = [&](const std::vector<std::string>& paths, const std::vector<const std::string*>& contents,
+                           std::vector<int>& errors)
+    {
+        try
+        {
+            p_io->write_files(paths, contents, errors);
+        }
+        catch(Io_Error& er)
+        {
+            fall_back(er);
+            p_io->write_files(paths, contents, errors);
+        }
+    };
+
+    for(std::size_t first = 0; first < inputs.size(); first += group_size)
+    {
+        std::size_t count = std::min(group_size, inputs.size() - first);
+        std::vector<std::string> paths(inputs.begin() + first, inputs.begin() + first + count);
+
+        clock::time_point phase = clock::now();
+        std::vector<Loaded_File> sources;
+        read_files(paths, sources);
+        report.read_seconds += seconds(clock::now() - phase);
+
+        phase = clock::now();
+        std::vector<std::string> outputs(count);
+        std::vector<std::pair<std::uint64_t, Work_Stealing_Scheduler::Task>> tasks;
+        for(std::size_t i = 0; i < count; i++)
+        {
+            File_Result& result = batch.files[first + i];
+            result.path = paths[i];
+            tasks.emplace_back(sources[i].content.size(), [&, i]
+            {
+                File_Result& result = batch.files[first + i];
+                if(result.path.size() < 4 || sources[i].error != 0)
+                {
+                    result.diagnostics = "Invalid file path\n";
+                    return;
+                }
+                if(result.path.compare(result.path.size() - 4, 4, ".txt") != 0)
+                {
+                    result.diagnostics = "Invalid file extension\n";
+                    return;
+                }
+
+                Translator& translator = worker_translator();
+                Profiling_Scope profiling(translator, options.profile);
+                std::ostringstream diagnostics;
+                translator.set_diagnostics(diagnostics);
+
+                std::stringstream input(std::move(sources[i].content));
+                std::ostringstream output;
+                result.ok = translator.translate(input, output);
+                result.diagnostics = diagnostics.str();
+                if(result.ok)
+                    outputs[i] = output.str();
+
+                translator.set_diagnostics(std::cerr);
+            });
+        }
+        scheduler.seed(std::move(tasks));
+        scheduler.wait();
+        report.translate_seconds += seconds(clock::now() - phase);
+
+        if(options.check_only)
+            continue;
+
+        phase = clock::now();
+        std::vector<std::string> output_paths;
+        std::vector<const std::string*> contents;
+        std::vector<std::size_t> owners;
+        for(std::size_t i = 0; i < count; i++)
+        {
+            const File_Result& result = batch.files[first + i];
+            if(result.path.size() < 4 || result.path.compare(result.path.size() - 4, 4, ".txt") != 0 || sources[i].error != 0)
+                continue;
+
+            std::string output_path = result.path.substr(0, result.path.size() - 4) + ".cpp";
+            if(result.ok)
+            {
+                output_paths.push_back(output_path);
+                contents.push_back(&outputs[i]);
+                owners.push_back(first + i);
+            }
+            else
+            {
+                // Like the translator, a failed translation leaves no output behind
+                std::remove(output_path.c_str());
+            }
+        }
+
+        std::vector<int> errors;
+        write_files(output_paths, contents, errors);
+        for(std::size_t i = 0; i < errors.size(); i++)
+        {
+            if(errors[i] != 0)
+            {
+                batch.files[owners[i]].ok = false;
+                batch.files[owners[i]].diagnostics += std::string("Cannot write output: ") + std::strerror(errors[i]) + "\n";
+            }
+        }
+        report.write_seconds += seconds(clock::now() - phase);
+    }
+
+    batch.workers = scheduler.stats();
+    for(const File_Result& result : batch.files)
+    {
+        if(!result.ok)
+            batch.failed++;
+    }
+
+    report.backend = io.name();
+    if(fallback)
+        report.backend += std::string(", then ") + fallback->name();
+    report.files = inputs.size();
+    report.syscalls = io.get_syscalls() + (fallback ? fallback->get_syscalls() : 0);
+    report.wall_seconds = seconds(clock::now() - start);
+    return batch;
+}
+
+// translate_batch with the translator's own fstreams, measured the same way for comparison. Reads and writes are
+// taken from /proc/self/io, which does not count opens and closes: 6 per file are added as an estimate, 3 opens (the
+// translator opens the input twice, to check it and to read it, and the output once) and their 3 closes
+inline Batch_Result translate_batch_fstream(const std::vector<std::string>& inputs, const Batch_Options& options,
+                                            Io_Report& report)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::uint64_t calls = read_proc_io_calls();
+
+    Batch_Result batch = translate_batch(inputs, options);
+
+    report.backend = "fstream";
+    report.files = inputs.size();
+    report.syscalls = read_proc_io_calls() - calls + 6 * inputs.size();
+    report.syscalls_estimated = true;
+    report.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return batch;
+}
+}
+
+#endif // TINY_IO_HPP_INCLUDED
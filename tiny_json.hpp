@@ -0,0 +1,589 @@
+#ifndef TINY_JSON_HPP_INCLUDED
+#define TINY_JSON_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_scheduler.hpp"
+#include "tiny_daemon.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <iostream>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+namespace TINY
+{
+// Malformed JSON or requests
+using Json_Error = Error<7>;
+
+// Just enough JSON for the request/response protocol below
+struct Json_Value
+{
+    enum class Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = Type::NUL;
+    bool boolean = false;
+    double number = 0;
+    std::string string; // For a NUMBER, its text as parsed, written back as is
+    std::vector<Json_Value> array;
+    std::vector<std::pair<std::string, Json_Value>> object;
+
+    // Member of an object, nullptr when missing
+    const Json_Value* find(const std::string& key) const
+    {
+        for(const auto& member : object)
+        {
+            if(member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+namespace detail
+{
+class Json_Parser
+{
+    const std::string& text;
+    std::size_t pos;
+
+ public:
+    explicit Json_Parser(const std::string& json) : text(json), pos(0) {}
+
+    Json_Value parse_document()
+    {
+        Json_Value value = parse_value(0);
+        skip_space();
+        if(pos != text.size())
+            fail("unexpected characters after the value");
+        return value;
+    }
+
+ private:
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        throw Json_Error{message + " at offset " + std::to_string(pos)};
+    }
+
+    void skip_space()
+    {
+        while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+            pos++;
+    }
+
+    void expect(const char* word)
+    {
+        for(; *word; word++, pos++)
+        {
+            if(pos == text.size() || text[pos] != *word)
+                fail("invalid literal");
+        }
+    }
+
+    Json_Value parse_value(int depth)
+    {
+        if(depth > 64)
+            fail("nesting too deep");
+
+        skip_space();
+        if(pos == text.size())
+            fail("unexpected end of input");
+
+        Json_Value value;
+        char c = text[pos];
+        if(c == '{')
+        {
+            value.type = Json_Value::Type::OBJECT;
+            pos++;
+            skip_space();
+            if(pos < text.size() && text[pos] == '}')
+            {
+                pos++;
+                return value;
+            }
+            while(true)
+            {
+                skip_space();
+                if(pos == text.size() || text[pos] != '"')
+                    fail("expected a member name");
+                std::string key = parse_string();
+                skip_space();
+                if(pos == text.size() || text[pos] != ':')
+                    fail("expected ':'");
+                pos++;
+                value.object.emplace_back(std::move(key), parse_value(depth + 1));
+                skip_space();
+                if(pos < text.size() && text[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                if(pos < text.size() && text[pos] == '}')
+                {
+                    pos++;
+                    return value;
+                }
+                fail("expected ',' or '}'");
+            }
+        }
+        else if(c == '[')
+        {
+            value.type = Json_Value::Type::ARRAY;
+            pos++;
+            skip_space();
+            if(pos < text.size() && text[pos] == ']')
+            {
+                pos++;
+                return value;
+            }
+            while(true)
+            {
+                value.array.push_back(parse_value(depth + 1));
+                skip_space();
+                if(pos < text.size() && text[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                if(pos < text.size() && text[pos] == ']')
+                {
+                    pos++;
+                    return value;
+                }
+                fail("expected ',' or ']'");
+            }
+        }
+        else if(c == '"')
+        {
+            value.type = Json_Value::Type::STRING;
+            value.string = parse_string();
+        }
+        else if(c == 't' || c == 'f')
+        {
+            value.type = Json_Value::Type::BOOLEAN;
+            value.boolean = c == 't';
+            expect(value.boolean ? "true" : "false");
+        }
+        else if(c == 'n')
+        {
+            expect("null");
+        }
+        else if(c == '-' || (c >= '0' && c <= '9'))
+        {
+            value.type = Json_Value::Type::NUMBER;
+            value.string = scan_number();
+            value.number = std::strtod(value.string.c_str(), nullptr);
+            if(!std::isfinite(value.number))
+                fail("number out of range");
+        }
+        else
+        {
+            fail("unexpected character");
+        }
+        return value;
+    }
+
+    // Text of the number at pos, by the JSON grammar: strtod alone would also take hexadecimal, inf and nan
+    std::string scan_number()
+    {
+        std::size_t begin = pos;
+        auto digits = [&]
+        {
+            std::size_t first = pos;
+            while(pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+                pos++;
+            if(pos == first)
+                fail("invalid number");
+        };
+
+        if(text[pos] == '-')
+            pos++;
+        if(pos < text.size() && text[pos] == '0')
+            pos++;
+        else
+            digits();
+        if(pos < text.size() && text[pos] == '.')
+        {
+            pos++;
+            digits();
+        }
+        if(pos < text.size() && (text[pos] == 'e' || text[pos] == 'E'))
+        {
+            pos++;
+            if(pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+                pos++;
+            digits();
+        }
+        return text.substr(begin, pos - begin);
+    }
+
+    unsigned parse_hex4()
+    {
+        if(text.size() - pos < 4)
+            fail("truncated escape");
+        unsigned code = 0;
+        for(int i = 0; i < 4; i++, pos++)
+        {
+            char c = text[pos];
+            code <<= 4;
+            if(c >= '0' && c <= '9')
+                code |= unsigned(c - '0');
+            else if(c >= 'a' && c <= 'f')
+                code |= unsigned(c - 'a' + 10);
+            else if(c >= 'A' && c <= 'F')
+                code |= unsigned(c - 'A' + 10);
+            else
+                fail("invalid escape");
+        }
+        return code;
+    }
+
+    static void put_utf8(std::string& out, unsigned code)
+    {
+        if(code < 0x80)
+            out += char(code);
+        else if(code < 0x800)
+        {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else if(code < 0x10000)
+        {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            out += char(0xf0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3f));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    std::string parse_string()
+    {
+        std::string out;
+        pos++; // Opening quote
+        while(true)
+        {
+            if(pos == text.size())
+                fail("unterminated string");
+            char c = text[pos++];
+            if(c == '"')
+                return out;
+            if(c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if(pos == text.size())
+                fail("unterminated string");
+            switch(text[pos++])
+            {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    unsigned code = parse_hex4();
+                    if(code >= 0xd800 && code < 0xdc00 && text.compare(pos, 2, "\\u") == 0)
+                    {
+                        pos += 2;
+                        unsigned low = parse_hex4();
+                        if(low < 0xdc00 || low >= 0xe000)
+                            fail("invalid surrogate pair");
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    put_utf8(out, code);
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+            }
+        }
+    }
+};
+}
+
+inline Json_Value parse_json(const std::string& text)
+{
+    return detail::Json_Parser(text).parse_document();
+}
+
+// Append text as a JSON string. Bytes above 0x7f are copied as they are
+inline void put_json_string(std::string& out, const std::string& text)
+{
+    out += '"';
+    for(char c : text)
+    {
+        switch(c)
+        {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escape[8];
+                    std::snprintf(escape, sizeof escape, "\\u%04x", unsigned(c));
+                    out += escape;
+                }
+                else
+                {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+inline void put_json(std::string& out, const Json_Value& value)
+{
+    switch(value.type)
+    {
+        case Json_Value::Type::NUL: out += "null"; break;
+        case Json_Value::Type::BOOLEAN: out += value.boolean ? "true" : "false"; break;
+        case Json_Value::Type::NUMBER:
+        {
+            if(!value.string.empty())
+            {
+                out += value.string;
+                break;
+            }
+            char number[32];
+            std::snprintf(number, sizeof number, "%.17g", value.number);
+            out += number;
+            break;
+        }
+        case Json_Value::Type::STRING: put_json_string(out, value.string); break;
+        case Json_Value::Type::ARRAY:
+            out += '[';
+            for(std::size_t i = 0; i < value.array.size(); i++)
+            {
+                if(i != 0)
+                    out += ',';
+                put_json(out, value.array[i]);
+            }
+            out += ']';
+            break;
+        case Json_Value::Type::OBJECT:
+            out += '{';
+            for(std::size_t i = 0; i < value.object.size(); i++)
+            {
+                if(i != 0)
+                    out += ',';
+                put_json_string(out, value.object[i].first);
+                out += ':';
+                put_json(out, value.object[i].second);
+            }
+            out += '}';
+            break;
+    }
+}
+
+// JSON lines protocol, one request per input line and one response per output line:
+//   request  = {"id": any, "program": "...", "backend": "cpp" | "vm", "check": bool, "input": "..."}
+//   response = {"id": same, "ok": bool, "output": "...", "diagnostics": "...", "timings": {"queue_ms": n, "process_ms": n}}
+// The cpp backend translates the program to C++ (only reports errors with "check": true), the vm backend runs it
+// with "input" as its standard input ("check" is an error there). Only "program" is required. Blank lines are ignored; a line that is not a valid
+// request gets a response with ok false and the reason in diagnostics
+struct Json_Lines_Options
+{
+    std::size_t jobs = 0;      // Workers, 0 for one per core
+    std::size_t window = 256;  // Requests read ahead of the oldest unanswered one
+    bool ordered = false;      // Answer in request order instead of as soon as done
+    Daemon_Options engine;     // Caches and step limit of the request handling
+};
+
+namespace detail
+{
+// Turn a JSON request into the daemon's request. Returns false with the reason in error when it is not valid
+inline bool decode_json_request(const Json_Value& json, Request& request, std::string& error)
+{
+    if(json.type != Json_Value::Type::OBJECT)
+    {
+        error = "Invalid request: not an object";
+        return false;
+    }
+
+    const Json_Value* program = json.find("program");
+    if(!program || program->type != Json_Value::Type::STRING)
+    {
+        error = "Invalid request: \"program\" must be a string";
+        return false;
+    }
+    request.source = program->string;
+
+    bool check = false;
+    if(const Json_Value* value = json.find("check"))
+        check = value->type == Json_Value::Type::BOOLEAN && value->boolean;
+
+    request.kind = check ? Request_Kind::CHECK : Request_Kind::TRANSLATE;
+    if(const Json_Value* backend = json.find("backend"))
+    {
+        if(backend->type == Json_Value::Type::STRING && backend->string == "vm")
+        {
+            if(check)
+            {
+                error = "Invalid request: \"check\" only applies to the cpp backend";
+                return false;
+            }
+            request.kind = Request_Kind::RUN;
+        }
+        else if(backend->type != Json_Value::Type::STRING || backend->string != "cpp")
+        {
+            error = "Invalid request: \"backend\" must be \"cpp\" or \"vm\"";
+            return false;
+        }
+    }
+
+    if(const Json_Value* input = json.find("input"))
+    {
+        if(input->type != Json_Value::Type::STRING)
+        {
+            error = "Invalid request: \"input\" must be a string";
+            return false;
+        }
+        request.input = input->string;
+    }
+    return true;
+}
+}
+
+// Answer JSON line requests read from in on out until the end of in. Requests are handled concurrently by a daemon
+// engine (pooled translators and VMs, memoized results) without its socket. At most window requests are in flight,
+// so a response is never written more than window positions away from its request, and with ordered the responses
+// come in request order. Output is flushed whenever no response is ready
+inline void serve_json_lines(std::istream& in, std::ostream& out, const Json_Lines_Options& options = Json_Lines_Options())
+{
+    using clock = std::chrono::steady_clock;
+
+    Daemon engine(std::string(), options.engine);
+    Work_Stealing_Scheduler scheduler(options.jobs);
+    std::size_t window = options.window == 0 ? 1 : options.window;
+
+    std::mutex mutex;
+    std::condition_variable slot_free;
+    std::size_t in_flight = 0;
+    std::uint64_t next_to_write = 0;
+    std::map<std::uint64_t, std::string> ready; // Finished responses waiting for their turn in ordered mode
+
+    // Called with the mutex held
+    auto write_ready = [&]
+    {
+        while(!ready.empty() && (!options.ordered || ready.begin()->first == next_to_write))
+        {
+            out << ready.begin()->second;
+            ready.erase(ready.begin());
+            next_to_write++;
+            in_flight--;
+        }
+        out.flush();
+        slot_free.notify_all();
+    };
+
+    // Reading std::cin flushes the stream tied to it, std::cout, which the workers write under the mutex
+    std::ostream* tied = in.tie(nullptr);
+
+    std::string line;
+    for(std::uint64_t sequence = 0; std::getline(in, line); )
+    {
+        if(line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_free.wait(lock, [&] { return in_flight < window; });
+            in_flight++;
+        }
+
+        clock::time_point received = clock::now();
+        scheduler.submit([&, sequence, received, text = std::move(line)]
+        {
+            clock::time_point started = clock::now();
+
+            Json_Value id;
+            Request request;
+            Response response;
+            std::string error;
+            try
+            {
+                Json_Value json = parse_json(text);
+                if(json.type == Json_Value::Type::OBJECT)
+                {
+                    if(const Json_Value* value = json.find("id"))
+                        id = *value;
+                }
+                if(detail::decode_json_request(json, request, error))
+                    response = engine.handle(request);
+                else
+                    response.diagnostics = error + "\n";
+            }
+            catch(Json_Error& er)
+            {
+                response.diagnostics = std::string("Invalid request: ") + er.what() + "\n";
+            }
+            // Every request must be answered, or in_flight never gets back under the window
+            catch(Connection_Error& er)
+            {
+                response = Response();
+                response.diagnostics = std::string("Internal error: ") + er.what() + "\n";
+            }
+            catch(std::exception& er)
+            {
+                response = Response();
+                response.diagnostics = std::string("Internal error: ") + er.what() + "\n";
+            }
+            catch(...)
+            {
+                response = Response();
+                response.diagnostics = "Internal error\n";
+            }
+
+            clock::time_point finished = clock::now();
+            auto milliseconds = [](clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+            std::string json = "{\"id\":";
+            put_json(json, id);
+            json += ",\"ok\":";
+            json += response.ok ? "true" : "false";
+            json += ",\"output\":";
+            put_json_string(json, response.output);
+            json += ",\"diagnostics\":";
+            put_json_string(json, response.diagnostics);
+
+            char timings[96];
+            std::snprintf(timings, sizeof timings, ",\"timings\":{\"queue_ms\":%.3f,\"process_ms\":%.3f}}\n",
+                          milliseconds(started - received), milliseconds(finished - started));
+            json += timings;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.emplace(sequence, std::move(json));
+            write_ready();
+        });
+        sequence++;
+    }
+
+    scheduler.wait();
+    in.tie(tied);
+}
+}
+
+#endif // TINY_JSON_HPP_INCLUDED
@@ -8,6 +8,16 @@
 #include <fstream>
 #include <cstdio>
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <memory_resource>
+
+#include "tiny_stats.hpp"
+#include "tiny_literal.hpp"
+
+// Version of the generated code. Change it whenever the C++ written for a given program changes,
+// so that incremental builds know their outputs are stale
+#define TINY_TRANSLATOR_VERSION "1.2"
 
 namespace TINY
 {
@@ -16,10 +26,14 @@ template<int N>
 class Error : std::exception
 {
  protected:
-    std::string msg;
+    std::pmr::string msg;
 
  public:
-    explicit Error(const std::string& msg) : msg(msg) {}
+    explicit Error(const char* msg) : msg(msg) {}
+    explicit Error(const std::string& msg) : msg(msg.data(), msg.size()) {}
+    // Message allocated from a memory resource, as the translator does with its own. The error must not outlive it
+    Error(const char* msg, std::pmr::memory_resource* memory) : msg(msg, memory) {}
+    Error(const char* msg, const char* more, std::pmr::memory_resource* memory) : msg(msg, memory) { this->msg += more; }
 
     const char* what() const noexcept
     {
@@ -37,8 +51,21 @@ class Error : std::exception
 using Lexical_Error = Error<0>;
 using Syntax_Error = Error<1>;
 
+// Compiles TINY to bytecode for the VM (tiny_vm.hpp), reusing the lexer of the translator
+class Compiler;
+// Fuzz target of the lexer alone (tiny_fuzz.cpp)
+struct Lexer_Fuzz;
+
 class Translator
 {
+ // The compiler shares the tokens and the lexer
+ friend class Compiler;
+ friend struct Lexer_Fuzz;
+
+ // Token texts, identifiers and indentation prefixes, allocated from the memory resource of the translator
+ using Text = std::pmr::string;
+ using Id_Set = std::pmr::set<Text>;
+
  // Enum class to present specific tokens
  enum class Token : char {
     ID, STRING, NUM,
@@ -55,6 +82,10 @@ class Translator
     ELSE_LITERAL, ELSEIF_LITERAL
  };
 
+ public:
+    // Instrumentation of the generated code, see set_profiling
+    enum class Profile_Mode { NONE, COUNT, SAMPLE };
+
  private:
     // Class to look for next characters in stream and transfer them to tokens
     class Lexer
@@ -68,12 +99,18 @@ class Translator
         // Data member to hold the currently processed token
         Token cur_token;
 
-        std::string soft_buffer; // Buffer to store text only, ignore whitespace
-        std::string hard_buffer; // Buffer to store every read characters, including whitespace. Mainly used to move the stream back to the previous state
+        // Line of the current token, counted from 1 with the newlines read (and not moved back) so far
+        std::size_t line;
+
+        Text soft_buffer; // Buffer to store text only, ignore whitespace
+        Text hard_buffer; // Buffer to store every read characters, including whitespace. Mainly used to move the stream back to the previous state
 
      public:
-        explicit Lexer(std::iostream& instream) : p_stream(&instream), owns_stream(false) {}
-        explicit Lexer(std::iostream* instream) : p_stream(instream), owns_stream(true) {}
+        // Both buffers allocate from memory
+        explicit Lexer(std::iostream& instream, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : p_stream(&instream), owns_stream(false), line(1), soft_buffer(memory), hard_buffer(memory) {}
+        explicit Lexer(std::iostream* instream, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : p_stream(instream), owns_stream(true), line(1), soft_buffer(memory), hard_buffer(memory) {}
 
         // Each Lexer should work with its own stream
         Lexer(const Lexer&) = delete;
@@ -84,34 +121,50 @@ class Translator
         // Get currently processed token
         Token get_current_token() const { return cur_token; }
         // Get currently processed text saved in soft_buffer
-        std::string get_current_text() const { return soft_buffer; }
+        std::string get_current_text() const { return std::string(soft_buffer.data(), soft_buffer.size()); }
+        // Same without a copy, valid until the next advance
+        const Text& current_text() const { return soft_buffer; }
+        // Line of the current token in the source (that of the following line for NEWLINE)
+        std::size_t get_line() const { return line; }
 
         // Method to advance the lexer to handle the next token in the stream with optional newline_check: True to also handle newline or False to skip newline
-        void advance(bool newline_check) { cur_token = get_token(newline_check); }
+        void advance(bool newline_check)
+        {
+            cur_token = get_token(newline_check);
+            line += std::count(hard_buffer.begin(), hard_buffer.end(), '\n');
+        }
         // Convenient overloading when newline is ignored
         void advance() { advance(false); }
 
         // Method to move back the stream to its previous state. cur_tok and buffer stay the same
         void move_back()
         {
+            // Reading up to the end of the stream sets failbit as well, which putback does not clear
+            if(!hard_buffer.empty())
+                p_stream->clear(p_stream->rdstate() & std::ios::badbit);
             for(auto r_iter = hard_buffer.rbegin(); r_iter != hard_buffer.rend(); r_iter++)
                 p_stream->putback(*r_iter);
+            line -= std::count(hard_buffer.begin(), hard_buffer.end(), '\n');
         }
 
      private:
+        std::pmr::memory_resource* memory() const { return soft_buffer.get_allocator().resource(); }
+
         // Main method to process next characters in stream
         Token get_token(bool newline_check)
         {
+            Phase_Scope scope(Phase::LEX);
+
             // Lambda expression presents the condition to skip all whitespace characters (except newline if attempt to check for newline)
             auto cond = [&](char c) -> bool
             {
                 if(newline_check)
                 {
-                    return std::isspace(c) && c != '\n';
+                    return std::isspace(static_cast<unsigned char>(c)) && c != '\n';
                 }
                 else
                 {
-                    return std::isspace(c);
+                    return std::isspace(static_cast<unsigned char>(c));
                 }
             };
 
@@ -144,14 +197,14 @@ class Translator
             // Next, we look for an identifier or literal (a special case is MOD literal since it is actually a symbol). Both start with a letter.
             // We handle this by looking for an identifier first. Then, we check what we have found against the literals.
 
-            else if(std::isalpha(c))
+            else if(std::isalpha(static_cast<unsigned char>(c)))
             {
                 soft_buffer += c;
                 hard_buffer += c;
                 c = input.get();
 
                 // Look for zero or more letters or digits
-                while(std::isalnum(c))
+                while(std::isalnum(static_cast<unsigned char>(c)))
                 {
                     soft_buffer += c;
                     hard_buffer += c;
@@ -192,15 +245,15 @@ class Translator
             }
 
             // Look for a number
-            else if(std::isdigit(c) || c == '.')
+            else if(std::isdigit(static_cast<unsigned char>(c)) || c == '.')
             {
                 // Number of form: n or n.m
-                if(std::isdigit(c))
+                if(std::isdigit(static_cast<unsigned char>(c)))
                 {
                     soft_buffer += c;
                     hard_buffer += c;
                     c = input.get();
-                    while(std::isdigit(c))
+                    while(std::isdigit(static_cast<unsigned char>(c)))
                     {
                         soft_buffer += c;
                         hard_buffer += c;
@@ -212,7 +265,7 @@ class Translator
                         soft_buffer += c;
                         hard_buffer += c;
                         c = input.get();
-                        while(std::isdigit(c))
+                        while(std::isdigit(static_cast<unsigned char>(c)))
                         {
                             soft_buffer += c;
                             hard_buffer += c;
@@ -226,12 +279,12 @@ class Translator
                     soft_buffer += c;
                     hard_buffer += c;
                     c = input.get();
-                    if(!std::isdigit(c))
+                    if(!std::isdigit(static_cast<unsigned char>(c)))
                     {
-                        throw Lexical_Error{"no digits after decimal point"};
+                        throw Lexical_Error{"no digits after decimal point", memory()};
                     }
 
-                    while(std::isdigit(c))
+                    while(std::isdigit(static_cast<unsigned char>(c)))
                     {
                         soft_buffer += c;
                         hard_buffer += c;
@@ -253,12 +306,12 @@ class Translator
                         c = input.get();
                     }
 
-                    if(!std::isdigit(c))
+                    if(!std::isdigit(static_cast<unsigned char>(c)))
                     {
-                        throw Lexical_Error{"no digits in exponent part"};
+                        throw Lexical_Error{"no digits in exponent part", memory()};
                     }
 
-                    while(std::isdigit(c))
+                    while(std::isdigit(static_cast<unsigned char>(c)))
                     {
                         soft_buffer += c;
                         hard_buffer += c;
@@ -354,9 +407,9 @@ class Translator
                 while(c != '\"')
                 {
                     // If character is neither digit, char, punctuation nor space
-                    if(c != ' ' && !std::isalnum(c) && !std::ispunct(c))
+                    if(c != ' ' && !std::isalnum(static_cast<unsigned char>(c)) && !std::ispunct(static_cast<unsigned char>(c)))
                         // Throw an error
-                        throw Lexical_Error{"unexpected character in string " + soft_buffer};
+                        throw Lexical_Error{"unexpected character in string ", soft_buffer.c_str(), memory()};
 
                     soft_buffer += c;
                     hard_buffer += c;
@@ -370,7 +423,7 @@ class Translator
             }
 
             // Anything else is an error
-            throw Lexical_Error{soft_buffer};
+            throw Lexical_Error{soft_buffer.c_str(), memory()};
         }
     };
 
@@ -378,22 +431,81 @@ class Translator
     // A translator owns a lexer
     Lexer* p_lexer;
 
-    // Variable to keep track of all declared variables
-    std::set<std::string> id_set;
+    // Variable to keep track of all declared variables, owned by the running translation like the lexer
+    Id_Set* p_id_set;
+
+    // Stream receiving error messages. Defaults to std::cerr, batch drivers redirect it to collect diagnostics per file
+    std::ostream* p_diagnostics;
+
+    // Where everything the translator allocates comes from: the lexer buffers, the declared identifiers, prefixes
+    // and error messages. Defaults to the default resource (new and delete)
+    std::pmr::memory_resource* p_memory;
+    // Where the lexer buffers and the declared identifiers come from instead, when told apart with set_memory(Component)
+    std::pmr::memory_resource* p_token_memory;
+    std::pmr::memory_resource* p_symbol_memory;
+
+    // Instrument the generated code to profile it by TINY line, see set_profiling
+    Profile_Mode profiling;
+
+    // With Profile_Mode::SAMPLE, the statements of the running translation by line, with the line of the statement
+    // they are nested in (0 for main()), to tell the sampler the block path of every line
+    struct Frame
+    {
+        std::size_t line;
+        std::size_t parent;
+        Token token;
+    };
+    using Frames = std::pmr::vector<Frame>;
+    Frames* p_frames;
+    std::size_t enclosing_line; // Statement the statements being parsed are nested in
 
  public:
-    Translator() : p_lexer(nullptr), id_set() {}
+    explicit Translator(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : p_lexer(nullptr), p_id_set(nullptr), p_diagnostics(&std::cerr), p_memory(memory),
+          p_token_memory(memory), p_symbol_memory(memory), profiling(Profile_Mode::NONE), p_frames(nullptr), enclosing_line(0) {}
 
     // Each translator should use its own resources
     Translator(const Translator&) = delete;
     Translator(Translator&&) = delete;
 
+    // Redirect error messages to another stream (e.g. a std::ostringstream to collect them)
+    void set_diagnostics(std::ostream& out) { p_diagnostics = &out; }
+
+    // Allocate from another memory resource (e.g. a pool, or an Accounting_Resource to count allocations).
+    // Not while translating; the resource must outlive the translations using it
+    void set_memory(std::pmr::memory_resource* memory) { p_memory = p_token_memory = p_symbol_memory = memory; }
+    std::pmr::memory_resource* get_memory() const { return p_memory; }
+
+    // Allocate one component from its own resource (e.g. the resources of a Memory_Tracker), to measure it alone.
+    // TOKENS are the lexer buffers, SYMBOLS the declared identifiers and IR everything else. The source and the output
+    // belong to the caller, setting them does nothing
+    void set_memory(Component component, std::pmr::memory_resource* memory)
+    {
+        if(component == Component::TOKENS)
+            p_token_memory = memory;
+        else if(component == Component::SYMBOLS)
+            p_symbol_memory = memory;
+        else if(component == Component::IR)
+            p_memory = memory;
+    }
+
+    // Write instrumented code. Applies to translate() only, fragments are never instrumented.
+    // COUNT: every statement counts its executions and adds up the time they took (including the statements nested in
+    // it) by TINY line, line 0 standing for the whole program. The program writes these figures when it exits, one
+    // "line count seconds" line per executed statement, to $TINY_PROFILE or tiny.prof (see print_profile_report in
+    // tiny_profile.hpp).
+    // SAMPLE: every statement only stores its line in a marker, which a SIGPROF handler samples $TINY_SAMPLE_HZ times
+    // (default 1000) per second of CPU time. When it exits, the program writes the samples to $TINY_SAMPLES or
+    // tiny.folded as folded stacks ("main;WHILE:6;IF:7;PRINT:8 34"), the block path of each line being known when
+    // translating. Needs POSIX signals and interval timers
+    void set_profiling(Profile_Mode mode) { profiling = mode; }
+
     // Main method for outside world to interact with objects of this class
     bool operator()(std::string file_path)
     {
         if(file_path.size() < 4 || !std::ifstream(file_path))
         {
-            std::cerr << "Invalid file path" << std::endl;
+            *p_diagnostics << "Invalid file path" << std::endl;
             return false;
         }
 
@@ -401,45 +513,287 @@ class Translator
         std::string infile_extension(file_path.end() - 4, file_path.end());
         if(infile_extension != ".txt")
         {
-            std::cerr << "Invalid file extension" << std::endl;
+            *p_diagnostics << "Invalid file extension" << std::endl;
             return false;
         }
         std::string outfile_path = infile_name + ".cpp";
 
         std::fstream input_file(file_path);
         std::ofstream output_file(outfile_path, std::ios::trunc);
-        p_lexer = new Lexer(input_file);
 
-        bool result = program(output_file);
+        bool result = translate(input_file, output_file);
         if(result == false)
         {
             remove(outfile_path.c_str());
         }
 
-        delete p_lexer;
+        return result;
+    }
+
+    // Translate a whole program read from input, writing the C++ code to output. Returns false on error, like operator()
+    bool translate(std::iostream& input, std::ostream& output)
+    {
+        Phase_Scope scope(Phase::PARSE);
+        Lexer lexer(input, p_token_memory);
+        p_lexer = &lexer;
+        Id_Set id_set(p_symbol_memory);
+        p_id_set = &id_set;
+        Frames frames(p_memory);
+        p_frames = &frames;
+
+        bool result = program(output);
+
+        p_lexer = nullptr;
+        p_id_set = nullptr;
+        p_frames = nullptr;
+
+        return result;
+    }
+
+    // Translate a fragment made of complete statements only (no BEGIN/END), as found between BEGIN and END at the top level
+    // Identifiers in declared are treated as already declared by the statements preceding the fragment
+    // Only the statements are written, indented as in main(). Returns false on error, like operator()
+    bool translate_fragment(std::iostream& input, std::ostream& output, const std::set<std::string>& declared)
+    {
+        Phase_Scope scope(Phase::PARSE);
+        Lexer lexer(input, p_token_memory);
+        p_lexer = &lexer;
+        Id_Set id_set(p_symbol_memory);
+        for(const std::string& name : declared)
+            id_set.emplace(name.data(), name.size());
+        p_id_set = &id_set;
+        Profile_Mode mode = profiling;
+        profiling = Profile_Mode::NONE;
+
+        bool result = true;
+        try
+        {
+            p_lexer->advance();
+            statements(output, "\t");
+
+            p_lexer->advance();
+            // Nothing but statements may appear in a fragment
+            if(p_lexer->get_current_token() != Token::EOFSTREAM)
+            {
+                throw Syntax_Error{"Unexpected tokens in fragment", p_memory};
+            }
+        }
+        catch(Lexical_Error& er)
+        {
+            *p_diagnostics << "Lexical Error: " << er << std::endl;
+            result = false;
+        }
+        catch(Syntax_Error& er)
+        {
+            *p_diagnostics << "Syntax Error: " << er << std::endl;
+            result = false;
+        }
+
         p_lexer = nullptr;
-        id_set.clear();
+        p_id_set = nullptr;
+        profiling = mode;
 
         return result;
     }
 
+    // Code written before the first statement of a translated program
+    static void begin_output(std::ostream& file)
+    {
+        file << "#include <iostream>" << "\n" << "\n"
+             << "using namespace std;" << "\n" << std::endl;
+    }
+
+    static void begin_main(std::ostream& file)
+    {
+        file << "int main(int argc, char *argv[])" << "\n"
+             << "{" << std::endl;
+    }
+
+    // Code written after the last statement of a translated program
+    static void end_main(std::ostream& file)
+    {
+        file << "\t" << "return 0;" << "\n"
+             << "}" << std::endl;
+    }
+
+    // Counters of instrumented code, declared before main() and defined after it, once the number of lines is known
+    static void begin_profile(std::ostream& file)
+    {
+        file << "#include <chrono>" << "\n"
+             << "#include <cstdio>" << "\n"
+             << "#include <cstdlib>" << "\n" << "\n"
+             << "namespace tiny_profile" << "\n"
+             << "{" << "\n"
+             << "extern unsigned long long counts[];" << "\n"
+             << "extern double seconds[];" << "\n"
+             << "extern std::chrono::steady_clock::time_point starts[];" << "\n"
+             << "inline void begin(unsigned line) { starts[line] = std::chrono::steady_clock::now(); }" << "\n"
+             << "inline void end(unsigned line)" << "\n"
+             << "{" << "\n"
+             << "\t" << "seconds[line] += std::chrono::duration<double>(std::chrono::steady_clock::now() - starts[line]).count();" << "\n"
+             << "\t" << "counts[line]++;" << "\n"
+             << "}" << "\n"
+             << "}" << "\n" << std::endl;
+    }
+
+    // Marker of sampled code, declared before main() like the counters of COUNT
+    static void begin_sample(std::ostream& file)
+    {
+        file << "#include <csignal>" << "\n" << "\n"
+             << "namespace tiny_sample" << "\n"
+             << "{" << "\n"
+             << "extern volatile std::sig_atomic_t line; // TINY line running now" << "\n"
+             << "}" << "\n" << std::endl;
+    }
+
+    // Sampler of sampled code: the frame of every line and the parent of its statement, then the signal handler
+    // counting the samples of the marked line, started before main() and writing the folded stacks after it
+    void end_sample(std::ostream& file, std::size_t lines)
+    {
+        std::vector<const Frame*> by_line(lines + 1, nullptr);
+        for(const Frame& frame : *p_frames)
+            if(frame.line <= lines)
+                by_line[frame.line] = &frame;
+
+        file << "\n"
+             << "#include <cstdio>" << "\n"
+             << "#include <cstdlib>" << "\n"
+             << "#include <sys/time.h>" << "\n" << "\n"
+             << "namespace tiny_sample" << "\n"
+             << "{" << "\n"
+             << "volatile std::sig_atomic_t line = 0;" << "\n"
+             << "const int parents[" << lines + 1 << "] = {";
+        for(std::size_t i = 0; i <= lines; i++)
+            file << (i % 16 ? " " : "\n\t") << (by_line[i] ? by_line[i]->parent : 0) << (i < lines ? "," : "");
+        file << "\n" << "};" << "\n"
+             << "const char* const names[" << lines + 1 << "] = {";
+        for(std::size_t i = 0; i <= lines; i++)
+        {
+            file << (i % 8 ? " " : "\n\t") << '"';
+            if(i == 0)
+                file << "main";
+            else if(by_line[i])
+                file << keyword(by_line[i]->token) << ':' << i;
+            file << '"' << (i < lines ? "," : "");
+        }
+        file << "\n" << "};" << "\n"
+             << "unsigned long long samples[" << lines + 1 << "];" << "\n" << "\n"
+             << "void record(int)" << "\n"
+             << "{" << "\n"
+             << "\t" << "samples[line]++;" << "\n"
+             << "}" << "\n" << "\n"
+             << "void put_frames(std::FILE* out, int at)" << "\n"
+             << "{" << "\n"
+             << "\t" << "if(at != 0)" << "\n"
+             << "\t" << "{" << "\n"
+             << "\t\t" << "put_frames(out, parents[at]);" << "\n"
+             << "\t\t" << "std::fputc(';', out);" << "\n"
+             << "\t" << "}" << "\n"
+             << "\t" << "std::fputs(names[at], out);" << "\n"
+             << "}" << "\n" << "\n"
+             << "struct Sampler" << "\n"
+             << "{" << "\n"
+             << "\t" << "Sampler()" << "\n"
+             << "\t" << "{" << "\n"
+             << "\t\t" << "const char* rate = std::getenv(\"TINY_SAMPLE_HZ\");" << "\n"
+             << "\t\t" << "long hz = rate ? std::atol(rate) : 0;" << "\n"
+             << "\t\t" << "long period = 1000000 / (hz > 0 && hz <= 1000000 ? hz : 1000);" << "\n"
+             << "\t\t" << "struct sigaction action = {};" << "\n"
+             << "\t\t" << "action.sa_handler = record;" << "\n"
+             << "\t\t" << "action.sa_flags = SA_RESTART;" << "\n"
+             << "\t\t" << "sigaction(SIGPROF, &action, nullptr);" << "\n"
+             << "\t\t" << "itimerval timer = {};" << "\n"
+             << "\t\t" << "timer.it_interval.tv_sec = period / 1000000;" << "\n"
+             << "\t\t" << "timer.it_interval.tv_usec = period % 1000000;" << "\n"
+             << "\t\t" << "timer.it_value = timer.it_interval;" << "\n"
+             << "\t\t" << "setitimer(ITIMER_PROF, &timer, nullptr);" << "\n"
+             << "\t" << "}" << "\n" << "\n"
+             << "\t" << "~Sampler()" << "\n"
+             << "\t" << "{" << "\n"
+             << "\t\t" << "itimerval off = {};" << "\n"
+             << "\t\t" << "setitimer(ITIMER_PROF, &off, nullptr);" << "\n"
+             << "\t\t" << "const char* path = std::getenv(\"TINY_SAMPLES\");" << "\n"
+             << "\t\t" << "std::FILE* out = std::fopen(path ? path : \"tiny.folded\", \"w\");" << "\n"
+             << "\t\t" << "if(!out)" << "\n"
+             << "\t\t\t" << "return;" << "\n"
+             << "\t\t" << "for(int at = 0; at < " << lines + 1 << "; at++)" << "\n"
+             << "\t\t" << "{" << "\n"
+             << "\t\t\t" << "if(samples[at] == 0)" << "\n"
+             << "\t\t\t\t" << "continue;" << "\n"
+             << "\t\t\t" << "put_frames(out, at);" << "\n"
+             << "\t\t\t" << "std::fprintf(out, \" %llu\\n\", samples[at]);" << "\n"
+             << "\t\t" << "}" << "\n"
+             << "\t\t" << "std::fclose(out);" << "\n"
+             << "\t" << "}" << "\n"
+             << "} sampler;" << "\n"
+             << "}" << std::endl;
+    }
+
+    // Keyword of a statement token, as in the frames of sampled code
+    static const char* keyword(Token token)
+    {
+        switch(token)
+        {
+        case Token::PRINT_LITERAL:
+            return "PRINT";
+        case Token::INPUT_LITERAL:
+            return "INPUT";
+        case Token::LET_LITERAL:
+            return "LET";
+        case Token::IF_LITERAL:
+            return "IF";
+        case Token::WHILE_LITERAL:
+            return "WHILE";
+        default:
+            return "?";
+        }
+    }
+
+    static void end_profile(std::ostream& file, std::size_t lines)
+    {
+        file << "\n"
+             << "namespace tiny_profile" << "\n"
+             << "{" << "\n"
+             << "unsigned long long counts[" << lines + 1 << "];" << "\n"
+             << "double seconds[" << lines + 1 << "];" << "\n"
+             << "std::chrono::steady_clock::time_point starts[" << lines + 1 << "];" << "\n"
+             << "struct Writer" << "\n"
+             << "{" << "\n"
+             << "\t" << "~Writer()" << "\n"
+             << "\t" << "{" << "\n"
+             << "\t\t" << "const char* path = std::getenv(\"TINY_PROFILE\");" << "\n"
+             << "\t\t" << "std::FILE* out = std::fopen(path ? path : \"tiny.prof\", \"w\");" << "\n"
+             << "\t\t" << "if(!out)" << "\n"
+             << "\t\t\t" << "return;" << "\n"
+             << "\t\t" << "for(unsigned line = 0; line < " << lines + 1 << "; line++)" << "\n"
+             << "\t\t\t" << "if(counts[line])" << "\n"
+             << "\t\t\t\t" << "std::fprintf(out, \"%u %llu %.9f\\n\", line, counts[line], seconds[line]);" << "\n"
+             << "\t\t" << "std::fclose(out);" << "\n"
+             << "\t" << "}" << "\n"
+             << "} writer;" << "\n"
+             << "}" << std::endl;
+    }
+
  private:
     /* The lexer always advances first (either normal advance or newline_check advance) and the current token in the lexer is processed after that */
 
     // Main method to handle the program
     // <program>	::= 'BEGIN' <newlines> <statements> <newlines> 'END'
-    bool program(std::ofstream& file)
+    bool program(std::ostream& file)
     {
         Token current_token;
         // Special variable used for the case where no character follow END literal, which means the final token will be EOFSTREAM although the text is END
-        std::string temp_text;
+        Text temp_text(p_memory);
 
         try
         {
             ////////////////////////////////////////////////////////
             // include standard library and using namespace std
-            file << "#include <iostream>" << "\n" << "\n"
-                 << "using namespace std;" << "\n" << std::endl;
+            begin_output(file);
+            if(profiling == Profile_Mode::COUNT)
+                begin_profile(file);
+            else if(profiling == Profile_Mode::SAMPLE)
+                begin_sample(file);
             ////////////////////////////////////////////////////////
             p_lexer->advance();
 
@@ -447,13 +801,14 @@ class Translator
             // a BEGIN is a must
             if(current_token != Token::BEGIN_LITERAL)
             {
-                throw Syntax_Error{"Cannot find the beginning of the program"};
+                throw Syntax_Error{"Cannot find the beginning of the program", p_memory};
             }
 
             ////////////////////////////
             // create main()
-            file << "int main(int argc, char *argv[])" << "\n"
-                 << "{" << std::endl;
+            begin_main(file);
+            enclosing_line = 0;
+            begin_statement(file, "\t", 0); // Line 0 stands for the whole program
             ////////////////////////////
 
             newlines("BEGIN");
@@ -466,7 +821,7 @@ class Translator
             {
                 statements(file, "\t");
 
-                temp_text = p_lexer->get_current_text();
+                temp_text = p_lexer->current_text();
                 p_lexer->advance();
             }
 
@@ -474,58 +829,74 @@ class Translator
             // an END is a must
             if((current_token != Token::END_LITERAL) && !(current_token == Token::EOFSTREAM && temp_text == "END"))
             {
-                throw Syntax_Error{"Cannot find the end of the program"};
+                throw Syntax_Error{"Cannot find the end of the program", p_memory};
             }
             p_lexer->advance();
 
             ///////////////////////////////////
             // create end of main
-            file << "\t" << "return 0;" << "\n"
-                 << "}" << std::endl;
+            end_statement(file, "\t", 0, 0);
+            end_main(file);
+            if(profiling == Profile_Mode::COUNT)
+                end_profile(file, p_lexer->get_line());
+            else if(profiling == Profile_Mode::SAMPLE)
+                end_sample(file, p_lexer->get_line());
             ///////////////////////////////////
 
             current_token = p_lexer->get_current_token();
             // END must be the end of program
             if(current_token != Token::EOFSTREAM)
             {
-                throw Syntax_Error{"Unexpected tokens after END"};
+                throw Syntax_Error{"Unexpected tokens after END", p_memory};
             }
 
             return true;
         }
         catch(Lexical_Error& er)
         {
-            std::cerr << "Lexical Error: " << er << std::endl;
+            *p_diagnostics << "Lexical Error: " << er << std::endl;
             return false;
         }
         catch(Syntax_Error& er)
         {
-            std::cerr << "Syntax Error: " << er << std::endl;
+            *p_diagnostics << "Syntax Error: " << er << std::endl;
             return false;
         }
     }
 
     // Helper method with lexer newline_check advance to look for newline
-    void newlines(std::string name)
+    void newlines(const char* name)
     {
         p_lexer->advance(true);
         if(p_lexer->get_current_token() != Token::NEWLINE)
         {
-            throw Syntax_Error{name + " must be followed by a newline"};
+            throw Syntax_Error{name, " must be followed by a newline", p_memory};
         }
     }
 
+    // Prefix of the statements nested one level deeper
+    Text indent(const Text& prefix) const
+    {
+        Text deeper(prefix, p_memory);
+        deeper += '\t';
+        return deeper;
+    }
+
     // Method to handle statements. In this method, the lexer only advances to the last available 'newlines'
     // <statements>	::= <print_statement><newline><statements>|<input_statement><newline><statements>
     //                  |<let_statement><newline><statements>|<if_statement><newline><statements>|<while_statement><newline><statements>|empty
-    void statements(std::ofstream& file, std::string prefix)
+    void statements(std::ostream& file, const Text& prefix)
     {
         while(true)
         {
+            std::size_t line = p_lexer->get_line();
+            std::size_t enclosing;
             switch(p_lexer->get_current_token())
             {
             case Token::PRINT_LITERAL:
+                enclosing = begin_statement(file, prefix, line);
                 print_statement(file, prefix);
+                end_statement(file, prefix, line, enclosing);
                 newlines("print_statement");
 
                 p_lexer->advance(); // Move past the newline
@@ -533,7 +904,9 @@ class Translator
                 break;
 
             case Token::INPUT_LITERAL:
+                enclosing = begin_statement(file, prefix, line);
                 input_statement(file, prefix);
+                end_statement(file, prefix, line, enclosing);
                 newlines("input_statement");
 
                 p_lexer->advance(); // Move past the newline
@@ -541,7 +914,9 @@ class Translator
                 break;
 
             case Token::LET_LITERAL:
+                enclosing = begin_statement(file, prefix, line);
                 let_statement(file, prefix);
+                end_statement(file, prefix, line, enclosing);
                 newlines("let_statement");
 
                 p_lexer->advance(); // Move past the newline
@@ -549,7 +924,9 @@ class Translator
                 break;
 
             case Token::IF_LITERAL:
+                enclosing = begin_statement(file, prefix, line);
                 if_statement(file, prefix);
+                end_statement(file, prefix, line, enclosing);
                 newlines("if_statement");
 
                 p_lexer->advance(); // Move past the newline
@@ -557,7 +934,9 @@ class Translator
                 break;
 
             case Token::WHILE_LITERAL:
+                enclosing = begin_statement(file, prefix, line);
                 while_statement(file, prefix);
+                end_statement(file, prefix, line, enclosing);
                 newlines("print_statement");
 
                 p_lexer->advance(); // Move past the newline
@@ -573,9 +952,35 @@ class Translator
         }
     }
 
+    // Probes around each statement of instrumented code. The statement at line encloses those parsed until
+    // end_statement, which is given back the enclosing statement begin_statement returned
+    std::size_t begin_statement(std::ostream& file, const Text& prefix, std::size_t line)
+    {
+        std::size_t enclosing = enclosing_line;
+        if(profiling == Profile_Mode::COUNT)
+        {
+            file << prefix << "tiny_profile::begin(" << line << ");" << "\n";
+        }
+        else if(profiling == Profile_Mode::SAMPLE)
+        {
+            file << prefix << "tiny_sample::line = " << line << ";" << "\n";
+            if(line != 0)
+                p_frames->push_back(Frame{line, enclosing, p_lexer->get_current_token()});
+        }
+        enclosing_line = line;
+        return enclosing;
+    }
+
+    void end_statement(std::ostream& file, const Text& prefix, std::size_t line, std::size_t enclosing)
+    {
+        if(profiling == Profile_Mode::COUNT)
+            file << prefix << "tiny_profile::end(" << line << ");" << "\n";
+        enclosing_line = enclosing;
+    }
+
     // Method to handle print statements. In this method, the lexer only advances to the last component (string or ID)
     // <print_statement>	::= 'PRINT' <string>|'PRINT' id
-    void print_statement(std::ofstream& file, std::string prefix)
+    void print_statement(std::ostream& file, const Text& prefix)
     {
         p_lexer->advance(); // move past PRINT literal
 
@@ -585,26 +990,26 @@ class Translator
         switch(p_lexer->get_current_token())
         {
         case Token::STRING:
-            file << '\"' << p_lexer->get_current_text() << '\"' << ';' << std::endl;
+            file << '\"' << p_lexer->current_text() << '\"' << ';' << std::endl;
             return;
         case Token::ID:
-            if(id_set.find(p_lexer->get_current_text()) == id_set.end())
+            if(p_id_set->find(p_lexer->current_text()) == p_id_set->end())
             {
-                throw Syntax_Error{"Attempt to print an undeclared identifier"};
+                throw Syntax_Error{"Attempt to print an undeclared identifier", p_memory};
             }
 
-            file << p_lexer->get_current_text() << ';' << std::endl;
+            file << p_lexer->current_text() << ';' << std::endl;
             return;
 
         default:
             // anything else is an error
-            throw Syntax_Error{"Unexpected tokens after PRINT"};
+            throw Syntax_Error{"Unexpected tokens after PRINT", p_memory};
         }
     }
 
     // Method to handle input statements. In this method, the lexer only advances to the ID
     // <input_statement>	::= 'INPUT' <id>
-    void input_statement(std::ofstream& file, std::string prefix)
+    void input_statement(std::ostream& file, const Text& prefix)
     {
         p_lexer->advance(); // move past INPUT literal
 
@@ -612,37 +1017,37 @@ class Translator
         if(p_lexer->get_current_token() == Token::ID)
         {
             // If variables has not been declared, declare it
-            if(id_set.find(p_lexer->get_current_text()) == id_set.end())
+            if(p_id_set->find(p_lexer->current_text()) == p_id_set->end())
             {
-                file << prefix << "int " << p_lexer->get_current_text() << ';' << "\n";
+                file << prefix << "int " << p_lexer->current_text() << ';' << "\n";
                 // Assign it to the set of already declared variables
-                id_set.insert(p_lexer->get_current_text());
+                p_id_set->insert(p_lexer->current_text());
             }
 
-            file << prefix << "cin >> " << p_lexer->get_current_text() << ';' << std::endl;
+            file << prefix << "cin >> " << p_lexer->current_text() << ';' << std::endl;
             return;
         }
         else
         {
             // anything else is an error
-            throw Syntax_Error{"Unexpected tokens after INPUT"};
+            throw Syntax_Error{"Unexpected tokens after INPUT", p_memory};
         }
     }
 
     // Method to handle let statements. In this method, the lexer only advances to the assignment
     // <let_statement>	::= 'LET' <assignment>
-    void let_statement(std::ofstream& file, std::string prefix)
+    void let_statement(std::ostream& file, const Text& prefix)
     {
         file << prefix;
 
         p_lexer->advance(); // move past LET literal
 
-        // If variables has not been declared, declare it
-        if(id_set.find(p_lexer->get_current_text()) == id_set.end())
+        // If variables has not been declared, declare it. Anything but an identifier is left to assignment to report
+        if(p_lexer->get_current_token() == Token::ID && p_id_set->find(p_lexer->current_text()) == p_id_set->end())
         {
             file << "int ";
             // Assign it to the set of already declared variables
-            id_set.insert(p_lexer->get_current_text());
+            p_id_set->insert(p_lexer->current_text());
         }
 
         assignment(file, "");
@@ -650,7 +1055,7 @@ class Translator
 
     // Method to handle if statements. In this method, the lexer only advances to ENDIF
     // <if_statement>	:= 'IF' <condition> <newline> <statements> <newline> 'ENDIF'
-    void if_statement(std::ofstream& file, std::string prefix)
+    void if_statement(std::ostream& file, const Text& prefix)
     {
         file << prefix << "if(";
 
@@ -664,7 +1069,7 @@ class Translator
              << prefix << "{" << "\n";
 
         p_lexer->advance(); // move past newline literal
-        statements(file, prefix + "\t");
+        statements(file, indent(prefix));
 
         // I think the following looking for endline should be removed since statements() has already look for endline
 
@@ -693,7 +1098,7 @@ class Translator
                  << prefix << "{" << "\n";
 
             p_lexer->advance(); // move past newline literal
-            statements(file, prefix + "\t");
+            statements(file, indent(prefix));
 
             file << prefix << "}" << std::endl;
 
@@ -710,7 +1115,7 @@ class Translator
                  << prefix << "{" << "\n";
 
             p_lexer->advance(); // move past newline literal
-            statements(file, prefix + "\t");
+            statements(file, indent(prefix));
 
             file << prefix << "}" << std::endl;
 
@@ -723,20 +1128,25 @@ class Translator
         // an ENDIF is a must
         if(current_token != Token::ENDIF_LITERAL)
         {
-            throw Syntax_Error{"Cannot find the end of if_statement"};
+            throw Syntax_Error{"Cannot find the end of if_statement", p_memory};
         }
     }
 
     // Method to handle while statements. In this method, the lexer only advances to ENDWHILE
     // <while_statement>	:= 'WHILE' <condition> REPEAT<newline> <statements> <newline> 'ENDWHILE'
-    void while_statement(std::ofstream& file, std::string prefix)
+    void while_statement(std::ostream& file, const Text& prefix)
     {
         file << prefix << "while(";
+        // Sampled code marks the line again each time the condition is evaluated, after the body
+        if(profiling == Profile_Mode::SAMPLE)
+            file << "(tiny_sample::line = " << p_lexer->get_line() << ", ";
 
         Token current_token;
         p_lexer->advance(); // move past WHILE literal
 
         condition(file, "");
+        if(profiling == Profile_Mode::SAMPLE)
+            file << ")";
 
         file << ")" << "\n"
              << prefix << "{" << "\n";
@@ -749,13 +1159,13 @@ class Translator
         // a REPEAT is a must
         if(current_token != Token::REPEAT_LITERAL)
         {
-            throw Syntax_Error{"a WHILE literal and a REPEAT literal must be on the same line"};
+            throw Syntax_Error{"a WHILE literal and a REPEAT literal must be on the same line", p_memory};
         }
 
         newlines("REPEAT");
 
         p_lexer->advance(); // move past newline literal
-        statements(file, prefix + "\t");
+        statements(file, indent(prefix));
 
         // I think the following looking for endline should be removed since statements() has already look for endline
 
@@ -770,30 +1180,30 @@ class Translator
         // an ENDWHILE is a must
         if(current_token != Token::ENDWHILE_LITERAL)
         {
-            throw Syntax_Error{"Cannot find the end of while_statement"};
+            throw Syntax_Error{"Cannot find the end of while_statement", p_memory};
         }
     }
 
     // Method to handle assignment. In this method, the lexer only advances to the expression
     // <assignment>	::= <id> = <expression>
-    void assignment(std::ofstream& file, std::string prefix)
+    void assignment(std::ostream& file, const Text& prefix)
     {
         if(p_lexer->get_current_token() != Token::ID)
         {
-            throw Syntax_Error{"Target of assignment must be an identifier"};
+            throw Syntax_Error{"Target of assignment must be an identifier", p_memory};
         }
-        else if(id_set.find(p_lexer->get_current_text()) == id_set.end())
+        else if(p_id_set->find(p_lexer->current_text()) == p_id_set->end())
         {
-            throw Syntax_Error{"Attempt to assign to an undeclared identifier"};
+            throw Syntax_Error{"Attempt to assign to an undeclared identifier", p_memory};
         }
 
-        file << prefix << p_lexer->get_current_text();
+        file << prefix << p_lexer->current_text();
 
         p_lexer->advance();
         // '=' is a must
         if(p_lexer->get_current_token() != Token::ASSIGNMENT_SYMBOL)
         {
-            throw Syntax_Error{"Unexpected token in assignment"};
+            throw Syntax_Error{"Unexpected token in assignment", p_memory};
         }
 
         file << " = ";
@@ -805,7 +1215,7 @@ class Translator
 
     // Method to handle expressions. In this method, the lexer only advances to the last available 'exp'
     // <expression> 	::= ( <id>|<num> ) <exp>| <exp> '+' <exp>| <exp> '-' <exp>| <exp> '*' <exp>| <exp> '/' <exp>| <exp> 'mod' <exp>
-    void expression(std::ofstream& file, std::string prefix)
+    void expression(std::ostream& file, const Text& prefix)
     {
         file << prefix;
 
@@ -856,18 +1266,18 @@ class Translator
 
     // Method to handle 'exp'. In this method, the lexer only advances to the last component of 'exp'
     // <exp>	:= <id>|<number>
-    void exp(std::ofstream& file, std::string prefix)
+    void exp(std::ostream& file, const Text& prefix)
     {
         file << prefix;
 
         if(p_lexer->get_current_token() == Token::ID)
         {
-            if(id_set.find(p_lexer->get_current_text()) == id_set.end())
+            if(p_id_set->find(p_lexer->current_text()) == p_id_set->end())
             {
-                throw Syntax_Error{"Attempt to handle an undeclared identifier in exp"};
+                throw Syntax_Error{"Attempt to handle an undeclared identifier in exp", p_memory};
             }
 
-            file << p_lexer->get_current_text();
+            file << p_lexer->current_text();
         }
         else
         {
@@ -877,7 +1287,7 @@ class Translator
 
     // Method to handle numbers. In this method, the lexer only advances to the 'num' token
     // <number>	::= '-'<num>|'+'<num>| <num>
-    void number(std::ofstream& file, std::string prefix)
+    void number(std::ostream& file, const Text& prefix)
     {
         file << prefix;
 
@@ -893,12 +1303,13 @@ class Translator
             // NUM is a must
             if(current_token == Token::NUM)
             {
-                file << p_lexer->get_current_text();
+                check_number();
+                file << p_lexer->current_text();
                 return;
             }
             else
             {
-                throw Syntax_Error{"Unexpected tokens in number"};
+                throw Syntax_Error{"Unexpected tokens in number", p_memory};
             }
 
         case Token::PLUS_SYMBOL:
@@ -909,27 +1320,41 @@ class Translator
             // NUM is a must
             if(current_token == Token::NUM)
             {
-                file << p_lexer->get_current_text();
+                check_number();
+                file << p_lexer->current_text();
                 return;
             }
             else
             {
-                throw Syntax_Error{"Unexpected tokens in number"};
+                throw Syntax_Error{"Unexpected tokens in number", p_memory};
             }
 
         case Token::NUM:
-            file << p_lexer->get_current_text();
+            check_number();
+            file << p_lexer->current_text();
             return;
 
         default:
             // anything else is an error
-            throw Syntax_Error{"Unexpected tokens in number"};
+            throw Syntax_Error{"Unexpected tokens in number", p_memory};
+        }
+    }
+
+    // Numbers are written as they are, and read by the C++ compiler. Reject what it would not read, by the literal
+    // rule the VM shares (tiny_literal.hpp)
+    void check_number()
+    {
+        const Text& text = p_lexer->current_text();
+        Literal literal;
+        if(!convert_literal(text.c_str(), literal))
+        {
+            throw Syntax_Error{"Invalid number ", text.c_str(), p_memory};
         }
     }
 
     // Method to handle condition. In this method, the lexer only advances to the last expression
     // <condition>	::= <expression> <compare> <expression>
-    void condition(std::ofstream& file, std::string prefix)
+    void condition(std::ostream& file, const Text& prefix)
     {
         file << prefix;
 
@@ -961,7 +1386,7 @@ class Translator
 
         default:
             // anything else is an error
-            throw Syntax_Error{"Unexpected tokens in condition"};
+            throw Syntax_Error{"Unexpected tokens in condition", p_memory};
         }
 
         p_lexer->advance(); // move past the symbol
@@ -0,0 +1,137 @@
+#ifndef TINY_LITERAL_HPP_INCLUDED
+#define TINY_LITERAL_HPP_INCLUDED
+
+// The numeric literal rule of TINY, shared by the translator, the Compiler of the VM (tiny_vm.hpp) and Static_Compiler
+// (tiny_constexpr.hpp) so that they accept the same numbers. Numbers are written to the generated C++ as they are, so
+// a literal is what the C++ compiler reads: with a point or an exponent it is a double, otherwise an integer (where a
+// leading 0 means octal). 8 or 9 in octal and values out of range are rejected.
+
+#include <string_view>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+namespace TINY
+{
+struct Literal
+{
+    bool real = false;
+    bool exact = true;      // false for a floating literal read_literal could not convert, left to convert_literal
+    std::int64_t integer = 0;
+    double number = 0;
+};
+
+// A floating literal is converted with one correctly rounded operation: its significant digits, as an integer of at
+// most 2^53, times or divided by an exactly represented power of ten. Other values are left inexact
+constexpr void real_literal(std::string_view text, Literal& literal)
+{
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    long exponent = 0;
+    bool exact = true;
+    bool fraction = false;
+    std::size_t i = 0;
+    for(; i < text.size() && text[i] != 'e' && text[i] != 'E'; i++)
+    {
+        if(text[i] == '.')
+        {
+            fraction = true;
+            continue;
+        }
+
+        int digit = text[i] - '0';
+        if(mantissa == 0 && digit == 0)
+        {
+            exponent -= fraction;
+        }
+        else if(digits < 19)
+        {
+            mantissa = mantissa * 10 + std::uint64_t(digit);
+            digits++;
+            exponent -= fraction;
+        }
+        else
+        {
+            exponent += !fraction;
+            exact = exact && digit == 0;
+        }
+    }
+
+    if(i < text.size())
+    {
+        bool negative = text[++i] == '-';
+        i += text[i] == '-' || text[i] == '+';
+        long power = 0;
+        for(; i < text.size(); i++)
+            power = power < 100000 ? power * 10 + (text[i] - '0') : power;
+        exponent += negative ? -power : power;
+    }
+
+    literal.number = 0;
+    if(mantissa == 0)
+        return;
+    while(mantissa % 10 == 0)
+    {
+        mantissa /= 10;
+        exponent++;
+    }
+
+    constexpr std::uint64_t max_exact = std::uint64_t(1) << 53;
+    double powers[23] = {1};
+    for(int power = 1; power < 23; power++)
+        powers[power] = powers[power - 1] * 10;
+
+    for(; exponent > 22 && mantissa <= max_exact / 10; exponent--)
+        mantissa *= 10;
+    if(!exact || mantissa > max_exact || exponent > 22 || exponent < -22)
+    {
+        literal.exact = false;
+        return;
+    }
+
+    literal.number = exponent >= 0 ? double(mantissa) * powers[exponent] : double(mantissa) / powers[-exponent];
+}
+
+// Reads text, a number as the lexer gives it (digits, with an optional point and exponent). Returns false when the
+// literal is invalid. Usable at compile time, where a floating literal that does not convert exactly is left with
+// exact false: it is valid only if convert_literal accepts it
+constexpr bool read_literal(std::string_view text, Literal& literal)
+{
+    literal = Literal{};
+    if(text.find_first_of(".eE") != std::string_view::npos)
+    {
+        literal.real = true;
+        real_literal(text, literal);
+        return true;
+    }
+
+    std::uint64_t base = text.size() > 1 && text[0] == '0' ? 8 : 10;
+    std::uint64_t integer = 0;
+    for(char c : text)
+    {
+        std::uint64_t digit = std::uint64_t(c - '0');
+        if(digit >= base || integer > (std::uint64_t(INT64_MAX) - digit) / base)
+            return false;
+        integer = integer * base + digit;
+    }
+    literal.integer = std::int64_t(integer);
+    return true;
+}
+
+// read_literal at run time, where strtod rounds the floating literals it could not convert, and rejects those
+// out of range
+inline bool convert_literal(const char* text, Literal& literal)
+{
+    if(!read_literal(text, literal))
+        return false;
+    if(literal.exact)
+        return true;
+
+    errno = 0;
+    literal.number = std::strtod(text, nullptr);
+    literal.exact = true;
+    return errno != ERANGE;
+}
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef TINY_MANIFEST_HPP_INCLUDED
+#define TINY_MANIFEST_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_batch.hpp"
+#include "tiny_hash.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstdint>
+
+#include <sys/stat.h>
+
+namespace TINY
+{
+// What an output was generated from
+struct Manifest_Entry
+{
+    std::string input;
+    std::uint64_t input_size = 0;
+    std::int64_t input_mtime = 0; // Nanoseconds, lets unchanged inputs be recognized without hashing them
+    std::string input_hash;
+    std::string version;          // TINY_TRANSLATOR_VERSION
+    std::string options;          // Options affecting the generated code
+};
+
+// Record of every output of an incremental build, keyed by output path. Stored as a text file, one tab separated
+// line per output: output, input, input size, input mtime, input hash, translator version, options
+class Manifest
+{
+ protected:
+    std::map<std::string, Manifest_Entry> entries;
+
+ public:
+    // A missing or unreadable manifest is empty: everything gets rebuilt
+    void load(const std::string& path)
+    {
+        entries.clear();
+
+        std::ifstream file(path);
+        std::string line;
+        if(!std::getline(file, line) || line != "tiny-manifest 1")
+            return;
+
+        while(std::getline(file, line))
+        {
+            std::vector<std::string> fields;
+            std::istringstream columns(line);
+            std::string field;
+            while(std::getline(columns, field, '\t'))
+                fields.push_back(field);
+            if(fields.size() != 7)
+                continue;
+
+            Manifest_Entry entry;
+            entry.input = fields[1];
+            entry.input_size = std::strtoull(fields[2].c_str(), nullptr, 10);
+            entry.input_mtime = std::strtoll(fields[3].c_str(), nullptr, 10);
+            entry.input_hash = fields[4];
+            entry.version = fields[5];
+            entry.options = fields[6];
+            entries[fields[0]] = entry;
+        }
+    }
+
+    // Write to a temporary file renamed over path, so an interrupted build never leaves a truncated manifest
+    bool save(const std::string& path) const
+    {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            file << "tiny-manifest 1\n";
+            for(const auto& item : entries)
+            {
+                const Manifest_Entry& entry = item.second;
+                file << item.first << '\t' << entry.input << '\t' << entry.input_size << '\t' << entry.input_mtime << '\t'
+                     << entry.input_hash << '\t' << entry.version << '\t' << entry.options << '\n';
+            }
+            if(!file.flush())
+                return false;
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    const Manifest_Entry* find(const std::string& output) const
+    {
+        auto found = entries.find(output);
+        return found == entries.end() ? nullptr : &found->second;
+    }
+
+    void set(const std::string& output, const Manifest_Entry& entry) { entries[output] = entry; }
+    void erase(const std::string& output) { entries.erase(output); }
+};
+
+namespace detail
+{
+inline bool stat_file(const std::string& path, std::uint64_t& size, std::int64_t& mtime)
+{
+    struct stat info;
+    if(::stat(path.c_str(), &info) != 0)
+        return false;
+    size = std::uint64_t(info.st_size);
+    mtime = std::int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+// Replace the content of path only if it differs, so that an identical output keeps its mtime
+inline bool write_if_changed(const std::string& path, const std::string& content)
+{
+    {
+        std::ifstream existing(path, std::ios::binary);
+        if(existing)
+        {
+            std::string old((std::istreambuf_iterator<char>(existing)), std::istreambuf_iterator<char>());
+            if(old == content)
+                return true;
+        }
+    }
+
+    std::ofstream output(path, std::ios::trunc | std::ios::binary);
+    output << content;
+    return bool(output.flush());
+}
+}
+
+// Options written to the manifest: outputs built with other options are stale
+inline std::string options_key(const Batch_Options& options)
+{
+    switch(options.profile)
+    {
+    case Translator::Profile_Mode::COUNT:
+        return "cpp+profile=count";
+    case Translator::Profile_Mode::SAMPLE:
+        return "cpp+profile=sample";
+    default:
+        return "cpp";
+    }
+}
+
+// Translate only the inputs whose output is missing or was generated from another input content, translator version
+// or options. Inputs are stat'ed and, when their size or mtime changed, hashed in parallel. Up to date outputs are not
+// touched and neither are outputs whose regenerated content is identical, so make does not rebuild what depends on them
+inline Batch_Result translate_batch_incremental(const std::vector<std::string>& inputs, const Batch_Options& options,
+                                                const std::string& manifest_path)
+{
+    Manifest manifest;
+    manifest.load(manifest_path);
+
+    Batch_Result batch;
+    batch.files.resize(inputs.size());
+
+    // Filled by the tasks, merged into the manifest afterwards
+    std::vector<Manifest_Entry> new_entries(inputs.size());
+    std::vector<char> skipped(inputs.size(), 0);
+    const std::string key = options_key(options);
+
+    std::size_t workers = options.jobs == 0 ? Work_Stealing_Scheduler::default_size() : options.jobs;
+    {
+        Work_Stealing_Scheduler scheduler(std::min(workers, std::max<std::size_t>(inputs.size(), 1)));
+
+        std::vector<std::pair<std::uint64_t, Work_Stealing_Scheduler::Task>> tasks;
+        for(std::size_t i = 0; i < inputs.size(); i++)
+        {
+            batch.files[i].path = inputs[i];
+            tasks.emplace_back(1, [&, i]
+            {
+                File_Result& result = batch.files[i];
+                const std::string& path = result.path;
+                Manifest_Entry& entry = new_entries[i];
+
+                if(path.size() < 4 || !detail::stat_file(path, entry.input_size, entry.input_mtime))
+                {
+                    result.diagnostics = "Invalid file path\n";
+                    return;
+                }
+                if(path.compare(path.size() - 4, 4, ".txt") != 0)
+                {
+                    result.diagnostics = "Invalid file extension\n";
+                    return;
+                }
+                std::string output_path = path.substr(0, path.size() - 4) + ".cpp";
+
+                entry.input = path;
+                entry.version = TINY_TRANSLATOR_VERSION;
+                entry.options = key;
+
+                const Manifest_Entry* previous = manifest.find(output_path);
+                bool same_build = previous && previous->input == path && previous->version == entry.version
+                                  && previous->options == entry.options;
+                std::uint64_t output_size;
+                std::int64_t output_mtime;
+                bool output_exists = detail::stat_file(output_path, output_size, output_mtime);
+
+                // Fast path: same size and mtime as recorded, trust the recorded hash
+                if(same_build && output_exists && previous->input_size == entry.input_size
+                   && previous->input_mtime == entry.input_mtime)
+                {
+                    entry.input_hash = previous->input_hash;
+                    result.ok = true;
+                    skipped[i] = 1;
+                    return;
+                }
+
+                std::ifstream file(path, std::ios::binary);
+                std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                entry.input_hash = hash_string(content_hash(source));
+
+                // Touched but not modified
+                if(same_build && output_exists && previous->input_hash == entry.input_hash)
+                {
+                    result.ok = true;
+                    skipped[i] = 1;
+                    return;
+                }
+
+                Translator& translator = worker_translator();
+                Profiling_Scope profiling(translator, options.profile);
+                std::ostringstream diagnostics;
+                translator.set_diagnostics(diagnostics);
+
+                std::stringstream input(source);
+                std::ostringstream output;
+                result.ok = translator.translate(input, output);
+                result.diagnostics = diagnostics.str();
+
+                translator.set_diagnostics(std::cerr);
+
+                if(result.ok)
+                    result.ok = detail::write_if_changed(output_path, output.str());
+                else
+                    std::remove(output_path.c_str());
+            });
+        }
+
+        scheduler.seed(std::move(tasks));
+        scheduler.wait();
+        batch.workers = scheduler.stats();
+    }
+
+    for(std::size_t i = 0; i < inputs.size(); i++)
+    {
+        const File_Result& result = batch.files[i];
+        if(result.path.size() < 4)
+            continue;
+
+        std::string output_path = result.path.substr(0, result.path.size() - 4) + ".cpp";
+        if(result.ok)
+            manifest.set(output_path, new_entries[i]);
+        else
+            manifest.erase(output_path);
+
+        if(!result.ok)
+            batch.failed++;
+        if(skipped[i])
+            batch.skipped++;
+    }
+
+    if(!manifest.save(manifest_path))
+    {
+        // Not fatal for this build, the next one just redoes more work
+        std::cerr << "tiny: cannot write " << manifest_path << std::endl;
+    }
+
+    return batch;
+}
+}
+
+#endif // TINY_MANIFEST_HPP_INCLUDED
@@ -0,0 +1,116 @@
+#ifndef TINY_PERF_HPP_INCLUDED
+#define TINY_PERF_HPP_INCLUDED
+
+#include "tiny_stats.hpp"
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define TINY_HAVE_PERF_EVENTS 1
+#else
+#define TINY_HAVE_PERF_EVENTS 0
+#endif
+
+namespace TINY
+{
+// Hardware counters of the calling thread through perf_event_open, user space only so that the default
+// perf_event_paranoid setting allows them. The counters that can be opened are read together as one group;
+// the others (or all of them, in containers and virtual machines without a PMU) are reported as unavailable.
+// When the kernel multiplexes the group with other users of the PMU, the values are scaled by the time the group was
+// enabled over the time it ran; a group that never ran (the NMI watchdog holding a counter) is reported as unavailable
+class Perf_Counters : public Event_Counters
+{
+ protected:
+    int fds[int(Counter::COUNT)];        // Descriptor of each opened counter
+    int leader;                          // First opened counter, -1 when none could be
+    unsigned opened;                     // Bit i set when Counter i is in the group
+    int position[int(Counter::COUNT)];   // Index of each counter in what the group reads
+    int count;                           // Counters in the group
+    std::string reason;                  // Why the first counter that failed could not be opened
+    bool unscheduled;                    // The last read found that the group never ran
+
+ public:
+    Perf_Counters() : fds(), leader(-1), opened(0), position(), count(0), unscheduled(false)
+    {
+#if TINY_HAVE_PERF_EVENTS
+        static const std::uint32_t types[] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                              PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE};
+        static const std::uint64_t configs[] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+        for(int i = 0; i < int(Counter::COUNT); i++)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof attr);
+            attr.size = sizeof attr;
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if(fd < 0)
+            {
+                if(reason.empty())
+                    reason = std::string(counter_name(Counter(i))) + ": " + std::strerror(errno);
+                continue;
+            }
+            if(leader < 0)
+                leader = fd;
+            opened |= 1u << i;
+            position[i] = count++;
+            fds[i] = fd;
+        }
+#else
+        reason = "perf_event_open is not supported on this system";
+#endif
+    }
+
+    Perf_Counters(const Perf_Counters&) = delete;
+    Perf_Counters(Perf_Counters&&) = delete;
+
+    ~Perf_Counters() override
+    {
+        for(int i = 0; i < int(Counter::COUNT); i++)
+            if(opened & (1u << i))
+                close(fds[i]);
+    }
+
+    unsigned available() const override { return unscheduled ? 0 : opened; }
+
+    // Empty when every counter could be opened and counts
+    const std::string& get_reason() const
+    {
+        static const std::string never_ran = "the counters never ran, another user holds the PMU";
+        return unscheduled && reason.empty() ? never_ran : reason;
+    }
+
+    void read(std::uint64_t values[int(Counter::COUNT)]) override
+    {
+        // Group read format: the number of counters, the times the group was enabled and running, then the values
+        // in the order the counters were opened
+        std::uint64_t group[3 + int(Counter::COUNT)] = {};
+        if(leader < 0 || ::read(leader, group, sizeof(std::uint64_t) * (3 + count)) < 0)
+            std::memset(group, 0, sizeof group);
+
+        std::uint64_t enabled = group[1];
+        std::uint64_t running = group[2];
+        unscheduled = leader >= 0 && enabled != 0 && running == 0;
+        double scale = running != 0 && running < enabled ? double(enabled) / double(running) : 1;
+        for(int i = 0; i < int(Counter::COUNT); i++)
+            values[i] = (opened & (1u << i)) && !unscheduled ? std::uint64_t(double(group[3 + position[i]]) * scale) : 0;
+    }
+};
+}
+
+#endif // TINY_PERF_HPP_INCLUDED
@@ -0,0 +1,91 @@
+#ifndef TINY_PROFILE_HPP_INCLUDED
+#define TINY_PROFILE_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+namespace TINY
+{
+// Executions and time of one TINY line, as written by a program translated with Translator::set_profiling
+struct Line_Profile
+{
+    std::uint64_t count = 0;
+    double seconds = 0;  // Including the statements nested in the line's statement
+};
+
+// Read a profile ("line count seconds" lines) by line number. Returns false when it cannot be read
+inline bool read_profile(const std::string& path, std::map<std::size_t, Line_Profile>& profile)
+{
+    std::ifstream file(path);
+    if(!file)
+        return false;
+
+    std::size_t line;
+    Line_Profile figures;
+    while(file >> line >> figures.count >> figures.seconds)
+        profile[line] = figures;
+    return file.eof();
+}
+
+// Annotated source: every line of the program with the executions and time of the statement it starts, and the share
+// of the program's time. Statements containing others (IF, WHILE) include their time. The hottest lines follow
+inline void print_profile_report(const std::string& source, const std::map<std::size_t, Line_Profile>& profile,
+                                 std::ostream& out, std::size_t hottest = 5)
+{
+    auto whole = profile.find(0);
+    double total = whole != profile.end() ? whole->second.seconds : 0;
+
+    char figures[64];
+    std::snprintf(figures, sizeof figures, "%.3f ms", 1000 * total);
+    out << "program time: " << figures << " (times include the statements nested in a line)\n\n"
+        << "       count    time(ms)      %  line\n";
+
+    std::istringstream lines(source);
+    std::string text;
+    for(std::size_t number = 1; std::getline(lines, text); number++)
+    {
+        if(!text.empty() && text.back() == '\r')
+            text.pop_back();
+
+        auto found = profile.find(number);
+        if(found == profile.end())
+            std::snprintf(figures, sizeof figures, "%12s %11s %6s %5zu  ", "", "", "", number);
+        else
+            std::snprintf(figures, sizeof figures, "%12llu %11.3f %6.1f %5zu  ",
+                          static_cast<unsigned long long>(found->second.count), 1000 * found->second.seconds,
+                          total > 0 ? 100 * found->second.seconds / total : 0.0, number);
+        out << figures << text << "\n";
+    }
+
+    // Hottest lines by time
+    std::vector<std::pair<std::size_t, Line_Profile>> ranked(profile.begin(), profile.end());
+    ranked.erase(std::remove_if(ranked.begin(), ranked.end(), [](const auto& entry) { return entry.first == 0; }),
+                 ranked.end());
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b)
+    {
+        return a.second.seconds > b.second.seconds;
+    });
+    if(ranked.size() > hottest)
+        ranked.resize(hottest);
+
+    out << "\nhottest lines:\n";
+    for(const auto& entry : ranked)
+    {
+        std::snprintf(figures, sizeof figures, "%5zu %11.3f ms %12llu executions\n", entry.first,
+                      1000 * entry.second.seconds, static_cast<unsigned long long>(entry.second.count));
+        out << figures;
+    }
+    out.flush();
+}
+}
+
+#endif // TINY_PROFILE_HPP_INCLUDED
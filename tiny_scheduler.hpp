@@ -0,0 +1,258 @@
+#ifndef TINY_SCHEDULER_HPP_INCLUDED
+#define TINY_SCHEDULER_HPP_INCLUDED
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace TINY
+{
+// What one worker did during the lifetime of a scheduler
+struct Worker_Stats
+{
+    std::size_t tasks = 0;  // Tasks run by this worker
+    std::size_t steals = 0; // Tasks taken from another worker's deque
+    double busy_seconds = 0;
+    double utilization = 0; // busy_seconds over the lifetime of the scheduler
+};
+
+// Pool of workers, each owning a deque of tasks
+// A worker takes tasks from the front of its own deque and, when that is empty, steals from the back of the others.
+// Tasks submitted from inside a task go to the front of the running worker's deque, so work split from a task is
+// picked up right away by the same worker (its data is still hot) while idle workers can still steal it.
+class Work_Stealing_Scheduler
+{
+ public:
+    using Task = std::function<void()>;
+
+ protected:
+    struct Worker
+    {
+        std::mutex deque_mutex;
+        std::deque<Task> tasks;
+
+        // Only written by the worker itself, read once the scheduler is idle
+        std::size_t tasks_run = 0;
+        std::size_t steals = 0;
+        std::chrono::steady_clock::duration busy{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::atomic<std::ptrdiff_t> queued; // Tasks sitting in a deque (may briefly go negative while a push is being announced)
+    std::atomic<std::size_t> pending; // Tasks submitted but not finished
+    std::atomic<std::size_t> next_victim;
+
+    std::mutex sleep_mutex;
+    std::condition_variable work_available; // Signalled when a task is queued or the scheduler stops
+    std::condition_variable all_done;       // Signalled when the last pending task finishes
+    bool stopping;
+
+    std::chrono::steady_clock::time_point start_time;
+
+ public:
+    // A size of 0 means one worker per hardware thread
+    explicit Work_Stealing_Scheduler(std::size_t size = 0) : queued(0), pending(0), next_victim(0), stopping(false)
+    {
+        if(size == 0)
+            size = default_size();
+
+        for(std::size_t i = 0; i < size; i++)
+            workers.push_back(std::make_unique<Worker>());
+
+        start_time = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < size; i++)
+            threads.emplace_back([this, i] { work(i); });
+    }
+
+    // Each scheduler owns its threads
+    Work_Stealing_Scheduler(const Work_Stealing_Scheduler&) = delete;
+    Work_Stealing_Scheduler(Work_Stealing_Scheduler&&) = delete;
+
+    ~Work_Stealing_Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+
+        for(std::thread& thread : threads)
+            thread.join();
+    }
+
+    static std::size_t default_size()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores == 0 ? 1 : cores;
+    }
+
+    std::size_t size() const { return workers.size(); }
+
+    // Index of the worker running the calling thread, or -1 outside of the scheduler
+    int current_worker() const
+    {
+        return current_scheduler() == this ? current_index() : -1;
+    }
+
+    // From a task: push to the front of the running worker's deque. From outside: deal to the workers in turn
+    void submit(Task task)
+    {
+        int self = current_worker();
+        std::size_t target = self >= 0 ? std::size_t(self) : next_victim++ % workers.size();
+
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(workers[target]->deque_mutex);
+            if(self >= 0)
+                workers[target]->tasks.push_front(std::move(task));
+            else
+                workers[target]->tasks.push_back(std::move(task));
+        }
+        wake_one();
+    }
+
+    // Seed a batch of tasks with estimated costs. The most expensive tasks are dealt first, one per worker,
+    // so the giants start immediately and the cheap tasks fill the gaps instead of trailing behind them
+    void seed(std::vector<std::pair<std::uint64_t, Task>> costed_tasks)
+    {
+        std::stable_sort(costed_tasks.begin(), costed_tasks.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        pending += costed_tasks.size();
+        for(std::size_t i = 0; i < costed_tasks.size(); i++)
+        {
+            Worker& worker = *workers[i % workers.size()];
+            std::lock_guard<std::mutex> lock(worker.deque_mutex);
+            worker.tasks.push_back(std::move(costed_tasks[i].second));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            queued += std::ptrdiff_t(costed_tasks.size());
+        }
+        work_available.notify_all();
+    }
+
+    // Block until every submitted task (including tasks submitted by tasks) has finished
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        all_done.wait(lock, [this] { return pending == 0; });
+    }
+
+    // Per worker statistics, only meaningful while no task is running (e.g. after wait())
+    std::vector<Worker_Stats> stats() const
+    {
+        double lifetime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+        std::vector<Worker_Stats> result;
+        for(const std::unique_ptr<Worker>& worker : workers)
+        {
+            Worker_Stats stat;
+            stat.tasks = worker->tasks_run;
+            stat.steals = worker->steals;
+            stat.busy_seconds = std::chrono::duration<double>(worker->busy).count();
+            stat.utilization = lifetime > 0 ? stat.busy_seconds / lifetime : 0;
+            result.push_back(stat);
+        }
+        return result;
+    }
+
+ private:
+    static const Work_Stealing_Scheduler*& current_scheduler()
+    {
+        thread_local const Work_Stealing_Scheduler* scheduler = nullptr;
+        return scheduler;
+    }
+
+    static int& current_index()
+    {
+        thread_local int index = -1;
+        return index;
+    }
+
+    void wake_one()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            queued++;
+        }
+        work_available.notify_one();
+    }
+
+    bool pop_local(std::size_t index, Task& task)
+    {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.deque_mutex);
+        if(worker.tasks.empty())
+            return false;
+
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        queued--;
+        return true;
+    }
+
+    bool steal(std::size_t index, Task& task)
+    {
+        for(std::size_t offset = 1; offset < workers.size(); offset++)
+        {
+            Worker& victim = *workers[(index + offset) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.deque_mutex);
+            if(victim.tasks.empty())
+                continue;
+
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            queued--;
+            workers[index]->steals++;
+            return true;
+        }
+        return false;
+    }
+
+    void work(std::size_t index)
+    {
+        current_scheduler() = this;
+        current_index() = int(index);
+        Worker& self = *workers[index];
+
+        while(true)
+        {
+            Task task;
+            if(pop_local(index, task) || steal(index, task))
+            {
+                auto begin = std::chrono::steady_clock::now();
+                task();
+                self.busy += std::chrono::steady_clock::now() - begin;
+                self.tasks_run++;
+
+                if(--pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(sleep_mutex);
+                    all_done.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            work_available.wait(lock, [this] { return stopping || queued > 0; });
+            if(stopping && queued == 0)
+                return;
+        }
+    }
+};
+}
+
+#endif // TINY_SCHEDULER_HPP_INCLUDED
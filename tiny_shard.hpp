@@ -0,0 +1,591 @@
+#ifndef TINY_SHARD_HPP_INCLUDED
+#define TINY_SHARD_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_batch.hpp"
+#include "tiny_hash.hpp"
+#include "tiny_daemon.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace TINY
+{
+// Result of translating a source, as stored in the shared cache
+struct Shared_Result
+{
+    bool ok = false;
+    std::string output;
+    std::string diagnostics;
+};
+
+// Content addressed cache of translation results in shared memory, used by all the worker processes of a sharded
+// batch at once without locks. Slots are claimed with compare and swap: the process that claims a source translates
+// it and publishes the result, the others wait for it, so a source present in several shards is translated once.
+// A slot claimed by a process that died is taken over by the next one waiting for it.
+// The table and the arena are fixed at creation; when either is full, results are simply not cached
+class Shared_Cache
+{
+ protected:
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+    // Slot state, in the high half of control, the low half holds the pid of the claiming process
+    enum : std::uint64_t { EMPTY = 0, CLAIMED = 1, READY = 2, ABANDONED = 3 };
+
+    struct Slot
+    {
+        std::atomic<std::uint64_t> control;
+        std::atomic<std::uint64_t> key;  // Written by the claiming process right after its claim, never 0 once set
+        std::uint64_t check;             // Second hash of the source, tells 64 bit collisions apart
+        std::uint64_t offset;            // Output then diagnostics, in the arena
+        std::uint32_t output_size;
+        std::uint32_t diagnostics_size;
+        std::uint32_t ok;
+    };
+
+    struct Header
+    {
+        std::atomic<std::uint64_t> arena_top;
+        std::atomic<std::uint64_t> hits;
+        std::atomic<std::uint64_t> misses;
+    };
+
+    void* memory;
+    std::size_t memory_size;
+    Header* header;
+    Slot* slots;
+    std::size_t slot_mask;
+    char* arena;
+    std::size_t arena_size;
+
+    static const std::size_t max_probes = 64;
+
+ public:
+    // A claimed slot, to publish (or abandon) once the source is translated
+    struct Claim
+    {
+        Slot* p_slot = nullptr;
+    };
+
+    // Create the cache in anonymous shared memory, inherited by the processes forked afterwards.
+    // Pages are only backed once touched
+    Shared_Cache(std::size_t entries, std::size_t bytes) : memory(MAP_FAILED), memory_size(0)
+    {
+        std::size_t slot_count = 64;
+        while(slot_count < 2 * entries)
+            slot_count *= 2;
+        slot_mask = slot_count - 1;
+        arena_size = bytes;
+
+        memory_size = sizeof(Header) + slot_count * sizeof(Slot) + arena_size;
+        memory = ::mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(memory == MAP_FAILED)
+            throw Connection_Error{std::string("cannot map the shared cache: ") + std::strerror(errno)};
+
+        // Anonymous mappings are zero filled: every slot is EMPTY and every counter 0
+        header = static_cast<Header*>(memory);
+        slots = reinterpret_cast<Slot*>(static_cast<char*>(memory) + sizeof(Header));
+        arena = reinterpret_cast<char*>(slots + slot_count);
+    }
+
+    Shared_Cache(const Shared_Cache&) = delete;
+    Shared_Cache(Shared_Cache&&) = delete;
+
+    ~Shared_Cache()
+    {
+        if(memory != MAP_FAILED)
+            ::munmap(memory, memory_size);
+    }
+
+    // Look a source up. Returns true with its result when cached (waiting for it if another process is translating
+    // it). Otherwise the caller must translate it and, when claim is set, publish the result
+    bool find_or_claim(const std::string& source, std::uint64_t seed, Shared_Result& result, Claim& claim)
+    {
+        std::uint64_t key = content_hash(source.data(), source.size(), seed);
+        std::uint64_t check = content_hash(source.data(), source.size(), ~seed) ^ source.size();
+        if(key == 0)
+            key = 1;
+
+        std::uint64_t self = std::uint64_t(::getpid());
+        for(std::size_t probe = 0; probe < max_probes; probe++)
+        {
+            Slot& slot = slots[(key + probe) & slot_mask];
+
+            while(true)
+            {
+                std::uint64_t slot_key = slot.key.load(std::memory_order_acquire);
+                std::uint64_t control = slot.control.load(std::memory_order_acquire);
+
+                if(slot_key != 0 && slot_key != key)
+                    break; // Another source, probe on
+
+                std::uint64_t state = control >> 32;
+                if(state == EMPTY)
+                {
+                    std::uint64_t expected = EMPTY;
+                    if(slot.control.compare_exchange_strong(expected, (CLAIMED << 32) | self, std::memory_order_acq_rel))
+                        return claimed(slot, key, check, claim);
+                    continue;
+                }
+                if(state == READY)
+                {
+                    if(slot_key != key || slot.check != check)
+                        break;
+                    copy(slot, result);
+                    header->hits++;
+                    return true;
+                }
+                if(state == ABANDONED)
+                {
+                    if(slot_key != key)
+                        break;
+                    header->misses++;
+                    return false;
+                }
+
+                // Claimed: wait for the result, or take over if the claiming process died
+                pid_t owner = pid_t(control & 0xffffffffu);
+                if(::kill(owner, 0) != 0 && errno == ESRCH)
+                {
+                    if(slot.control.compare_exchange_strong(control, (CLAIMED << 32) | self, std::memory_order_acq_rel))
+                        return claimed(slot, key, check, claim);
+                    continue;
+                }
+                ::sched_yield();
+            }
+        }
+
+        header->misses++;
+        return false;
+    }
+
+    // Store the result of a claimed source. A result that does not fit in the arena is abandoned: processes
+    // waiting for it translate the source themselves
+    void publish(Claim& claim, const Shared_Result& result)
+    {
+        Slot& slot = *claim.p_slot;
+        std::size_t size = result.output.size() + result.diagnostics.size();
+        std::uint64_t offset = header->arena_top.fetch_add(size, std::memory_order_relaxed);
+        if(offset + size > arena_size)
+        {
+            slot.control.store(ABANDONED << 32, std::memory_order_release);
+            return;
+        }
+
+        std::memcpy(arena + offset, result.output.data(), result.output.size());
+        std::memcpy(arena + offset + result.output.size(), result.diagnostics.data(), result.diagnostics.size());
+        slot.offset = offset;
+        slot.output_size = std::uint32_t(result.output.size());
+        slot.diagnostics_size = std::uint32_t(result.diagnostics.size());
+        slot.ok = result.ok;
+        slot.control.store(READY << 32, std::memory_order_release);
+    }
+
+    std::uint64_t get_hits() const { return header->hits; }
+    std::uint64_t get_misses() const { return header->misses; }
+
+ protected:
+    bool claimed(Slot& slot, std::uint64_t key, std::uint64_t check, Claim& claim)
+    {
+        slot.check = check;
+        slot.key.store(key, std::memory_order_release);
+        claim.p_slot = &slot;
+        header->misses++;
+        return false;
+    }
+
+    void copy(const Slot& slot, Shared_Result& result) const
+    {
+        result.ok = slot.ok != 0;
+        result.output.assign(arena + slot.offset, slot.output_size);
+        result.diagnostics.assign(arena + slot.offset + slot.output_size, slot.diagnostics_size);
+    }
+};
+
+struct Shard_Options
+{
+    std::size_t processes = 0;                         // Worker processes, 0 for one per core
+    std::size_t cache_bytes = std::size_t(256) << 20;  // Shared cache arena, only touched pages use memory
+    int max_crashes = 2;                               // Crashes a file may cause before it is reported as failed
+};
+
+// What happened to the worker processes of a sharded batch
+struct Shard_Report
+{
+    std::size_t processes = 0;
+    std::uint64_t cache_hits = 0;
+    std::uint64_t cache_misses = 0;
+    std::size_t crashed_workers = 0;
+    std::size_t reassigned_files = 0;
+};
+
+namespace detail
+{
+// Work of one file in a worker process: same checks, outputs and diagnostics as the translator
+inline void translate_shared(Shared_Cache& cache, const Batch_Options& options, File_Result& result)
+{
+    const std::string& path = result.path;
+    std::ifstream file(path, std::ios::binary);
+    if(path.size() < 4 || !file)
+    {
+        result.diagnostics = "Invalid file path\n";
+        return;
+    }
+    if(!options.check_only && path.compare(path.size() - 4, 4, ".txt") != 0)
+    {
+        result.diagnostics = "Invalid file extension\n";
+        return;
+    }
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Checking, translating and translating with instrumentation give different results, keep them apart
+    std::uint64_t seed = options.check_only ? 0x636865636bull : 14695981039346656037ull;
+    seed += std::uint64_t(options.profile) << 40;
+
+    Shared_Result shared;
+    Shared_Cache::Claim claim;
+    if(!cache.find_or_claim(source, seed, shared, claim))
+    {
+        Translator& translator = worker_translator();
+        Profiling_Scope profiling(translator, options.profile);
+        std::ostringstream diagnostics;
+        translator.set_diagnostics(diagnostics);
+
+        std::stringstream input(std::move(source));
+        std::ostringstream output;
+        if(options.check_only)
+        {
+            std::ostream discard(nullptr);
+            shared.ok = translator.translate(input, discard);
+        }
+        else
+        {
+            shared.ok = translator.translate(input, output);
+            if(shared.ok)
+                shared.output = output.str();
+        }
+        shared.diagnostics = diagnostics.str();
+        translator.set_diagnostics(std::cerr);
+
+        if(claim.p_slot)
+            cache.publish(claim, shared);
+    }
+
+    result.ok = shared.ok;
+    result.diagnostics = shared.diagnostics;
+    if(options.check_only)
+        return;
+
+    std::string outfile_path = path.substr(0, path.size() - 4) + ".cpp";
+    if(result.ok)
+    {
+        std::ofstream output(outfile_path, std::ios::trunc | std::ios::binary);
+        output << shared.output;
+        result.ok = bool(output.flush());
+    }
+    else
+    {
+        std::remove(outfile_path.c_str());
+    }
+}
+
+// Worker process: translate the files of each assignment, reporting every file as soon as it is done.
+// An assignment is a list of u32 input indices, an empty one ends the worker
+[[noreturn]] inline void shard_worker(int fd, Shared_Cache& cache, const Batch_Options& options,
+                                      const std::vector<std::string>& inputs)
+{
+    try
+    {
+        std::string assignment;
+        while(read_frame(fd, assignment) && !assignment.empty())
+        {
+            for(std::size_t pos = 0; pos < assignment.size(); )
+            {
+                std::uint32_t index = get_u32(assignment, pos);
+
+                File_Result result;
+                result.path = inputs[index];
+                translate_shared(cache, options, result);
+
+                std::string report;
+                put_u32(report, index);
+                report += char(result.ok ? 1 : 0);
+                put_field(report, result.diagnostics);
+                write_frame(fd, report);
+            }
+            write_frame(fd, std::string()); // Assignment done
+        }
+    }
+    catch(Connection_Error&)
+    {
+        // The coordinator went away
+    }
+    std::fflush(nullptr);
+    ::_exit(0);
+}
+}
+
+// Translate a batch with worker processes instead of threads, so that a crash only costs the file being translated.
+// Inputs are dealt in small shards, largest files first, to the workers as they become free. Workers share a
+// content addressed cache of results (Shared_Cache), so a source that appears in several files is translated once.
+// When a worker dies, the files of its shard it had not reported are given to a new worker; a file that keeps
+// crashing workers is reported as failed
+inline Batch_Result translate_batch_processes(const std::vector<std::string>& inputs, const Batch_Options& options,
+                                              const Shard_Options& shard_options, Shard_Report& report)
+{
+    Batch_Result batch;
+    batch.files.resize(inputs.size());
+    for(std::size_t i = 0; i < inputs.size(); i++)
+        batch.files[i].path = inputs[i];
+    if(inputs.empty())
+        return batch;
+
+    std::size_t processes = shard_options.processes == 0 ? Work_Stealing_Scheduler::default_size() : shard_options.processes;
+    processes = std::min(processes, inputs.size());
+    report.processes = processes;
+
+    Shared_Cache cache(inputs.size(), shard_options.cache_bytes);
+
+    // Shards of consecutive files by decreasing size, about eight per worker so that free workers find work
+    std::vector<std::pair<std::uintmax_t, std::uint32_t>> order;
+    for(std::size_t i = 0; i < inputs.size(); i++)
+    {
+        std::error_code ec;
+        std::uintmax_t size = std::filesystem::file_size(inputs[i], ec);
+        order.emplace_back(ec ? 0 : size, std::uint32_t(i));
+    }
+    std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::size_t shard_size = std::max<std::size_t>(1, inputs.size() / (processes * 8));
+    std::vector<std::vector<std::uint32_t>> pending;
+    for(std::size_t i = order.size(); i > 0; )
+    {
+        // Built from the end so that pending.back(), handed out first, holds the largest files
+        std::size_t begin = i > shard_size ? i - shard_size : 0;
+        std::vector<std::uint32_t> shard;
+        for(std::size_t j = begin; j < i; j++)
+            shard.push_back(order[j].second);
+        pending.push_back(std::move(shard));
+        i = begin;
+    }
+
+    struct Worker
+    {
+        pid_t pid = -1;
+        int fd = -1;
+        std::vector<std::uint32_t> assigned; // Files of the current shard not reported yet, in order
+    };
+    std::vector<Worker> workers(processes);
+    std::map<std::uint32_t, int> crashes;
+
+    std::fflush(nullptr); // Nothing buffered may be written twice
+    auto start = [&](Worker& worker)
+    {
+        int fds[2];
+        if(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+            throw Connection_Error{std::string("socketpair failed: ") + std::strerror(errno)};
+
+        pid_t pid = ::fork();
+        if(pid < 0)
+            throw Connection_Error{std::string("fork failed: ") + std::strerror(errno)};
+        if(pid == 0)
+        {
+            ::close(fds[0]);
+            for(const Worker& other : workers)
+            {
+                if(other.fd >= 0)
+                    ::close(other.fd);
+            }
+            detail::shard_worker(fds[1], cache, options, inputs);
+        }
+
+        ::close(fds[1]);
+        worker.pid = pid;
+        worker.fd = fds[0];
+        worker.assigned.clear();
+    };
+
+    auto assign = [&](Worker& worker) -> bool
+    {
+        if(pending.empty())
+            return false;
+        worker.assigned = std::move(pending.back());
+        pending.pop_back();
+
+        std::string assignment;
+        for(std::uint32_t index : worker.assigned)
+            detail::put_u32(assignment, index);
+        detail::write_frame(worker.fd, assignment);
+        return true;
+    };
+
+    auto stop = [&](Worker& worker)
+    {
+        ::close(worker.fd);
+        worker.fd = -1;
+        int status;
+        while(::waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+        worker.pid = -1;
+    };
+
+    // A worker died: its unreported files go back to the pending shards, except a file that crashed too often
+    auto recover = [&](Worker& worker)
+    {
+        ::close(worker.fd);
+        worker.fd = -1;
+        int status = 0;
+        while(::waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+        worker.pid = -1;
+        report.crashed_workers++;
+
+        if(!worker.assigned.empty())
+        {
+            // Files are translated in order, the first unreported one was being translated
+            std::uint32_t culprit = worker.assigned.front();
+            if(++crashes[culprit] >= shard_options.max_crashes)
+            {
+                File_Result& result = batch.files[culprit];
+                result.ok = false;
+                result.diagnostics = WIFSIGNALED(status)
+                                   ? "Worker process killed by signal " + std::to_string(WTERMSIG(status)) + "\n"
+                                   : "Worker process exited unexpectedly\n";
+                worker.assigned.erase(worker.assigned.begin());
+            }
+            report.reassigned_files += worker.assigned.size();
+            if(!worker.assigned.empty())
+                pending.push_back(std::move(worker.assigned));
+        }
+        worker.assigned.clear();
+    };
+
+    for(Worker& worker : workers)
+    {
+        start(worker);
+        if(!assign(worker))
+            stop(worker);
+    }
+
+    while(true)
+    {
+        std::vector<pollfd> fds;
+        std::vector<Worker*> polled;
+        for(Worker& worker : workers)
+        {
+            if(worker.fd >= 0)
+            {
+                fds.push_back({worker.fd, POLLIN, 0});
+                polled.push_back(&worker);
+            }
+        }
+        if(fds.empty())
+            break;
+
+        if(::poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw Connection_Error{std::string("poll failed: ") + std::strerror(errno)};
+        }
+
+        for(std::size_t i = 0; i < fds.size(); i++)
+        {
+            if(fds[i].revents == 0)
+                continue;
+            Worker& worker = *polled[i];
+
+            std::string message;
+            bool alive;
+            try
+            {
+                alive = detail::read_frame(worker.fd, message);
+            }
+            catch(Connection_Error&)
+            {
+                alive = false;
+            }
+
+            if(!alive)
+            {
+                recover(worker);
+                if(!pending.empty())
+                {
+                    start(worker);
+                    assign(worker);
+                }
+                continue;
+            }
+
+            if(message.empty())
+            {
+                // Shard done: next one, or no more work for this worker
+                try
+                {
+                    if(assign(worker))
+                        continue;
+                    detail::write_frame(worker.fd, std::string());
+                }
+                catch(Connection_Error&)
+                {
+                    // Died meanwhile, the next poll reports it
+                    continue;
+                }
+                stop(worker);
+                continue;
+            }
+
+            std::size_t pos = 0;
+            std::uint32_t index = detail::get_u32(message, pos);
+            File_Result& result = batch.files[index];
+            result.ok = message[pos++] == 1;
+            result.diagnostics = detail::get_field(message, pos);
+
+            auto reported = std::find(worker.assigned.begin(), worker.assigned.end(), index);
+            if(reported != worker.assigned.end())
+                worker.assigned.erase(reported);
+        }
+
+        // A worker that died with its shard may have left work nobody is running
+        if(!pending.empty())
+        {
+            for(Worker& worker : workers)
+            {
+                if(worker.fd < 0 && !pending.empty())
+                {
+                    start(worker);
+                    assign(worker);
+                }
+            }
+        }
+    }
+
+    report.cache_hits = cache.get_hits();
+    report.cache_misses = cache.get_misses();
+    for(const File_Result& result : batch.files)
+    {
+        if(!result.ok)
+            batch.failed++;
+    }
+    return batch;
+}
+}
+
+#endif // TINY_SHARD_HPP_INCLUDED
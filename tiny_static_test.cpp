@@ -0,0 +1,68 @@
+// Test of tiny_constexpr.hpp: programs compiled while this file is compiled must run on the VM, print what they are
+// expected to, and give what the Compiler gives for the same source at run time.
+//
+// Build: g++ -std=c++20 -O2 tiny_static_test.cpp -o tiny_static_test
+//
+// With -DTINY_STATIC_ERROR the file embeds an invalid program instead and must not compile. ctest builds that variant
+// and expects the build to fail; the error names the line and the message, as the Compiler reports them.
+// Exit status: 0, 1 when a program does not give what it should
+
+#include "tiny_constexpr.hpp"
+#include "tiny_vm.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+#ifndef TINY_STATIC_ERROR
+std::string run(const TINY::Bytecode& code, const char* input)
+{
+    TINY::VM vm;
+    std::istringstream in(input);
+    std::ostringstream out;
+    if(!vm.run(code, in, out))
+        return "<runtime error>";
+    return out.str();
+}
+
+// Run the program compiled at compile time and the one the Compiler gives at run time on input
+template<TINY::Static_Source Source>
+bool check(const char* name, const char* input, const std::string& expected)
+{
+    constexpr auto program = TINY::compile_static<Source>();
+    std::string output = run(program.to_bytecode(), input);
+
+    TINY::Compiler compiler;
+    TINY::Bytecode code;
+    std::stringstream source(std::string(Source.view()));
+    std::string reference = compiler.compile(source, code) ? run(code, input) : "<compile error>";
+
+    if(output == expected && output == reference)
+        return true;
+    std::cerr << "tiny_static_test: " << name << " printed\n" << output << "\nthe Compiler's bytecode printed\n"
+              << reference << "\nexpected\n" << expected << std::endl;
+    return false;
+}
+#endif
+}
+
+int main()
+{
+#ifdef TINY_STATIC_ERROR
+    constexpr auto program = TINY::compile_static<"BEGIN\nLET x = 1\nPRINT y\nEND\n">();
+    return int(program.code.size());
+#else
+    bool ok = true;
+    ok &= check<"BEGIN\nPRINT \"Hello World\"\nEND\n">("hello", "", "Hello World");
+    ok &= check<"BEGIN\nINPUT num\nIF num mod 2 == 0\n   PRINT \"Even number\"\nELSE\n   PRINT \"Odd number\"\nENDIF\nEND\n">(
+        "mod", "7\n", "Odd number");
+    ok &= check<"BEGIN\nINPUT n\nLET a = 0\nLET b = 1\nWHILE n > 0 REPEAT\n    PRINT a\n    LET c = a + b\n"
+                "    LET a = b\n    LET b = c\n    LET n = n - 1\nENDWHILE\nEND\n">("fibonacci", "10\n", "0112358132134");
+    ok &= check<"BEGIN\nLET a = 1.5e+3\nLET b = .25\nLET c = -7\nLET d = a / +2\nLET e = 010 * 2.5e-1\nIF d >= 12E-1\n"
+                "   PRINT d\nENDIF\nWHILE c <= 0 REPEAT\n   LET c = c + 1\nENDWHILE\nPRINT c\nPRINT e\nEND\n">(
+        "numbers", "", "75012");
+    return ok ? 0 : 1;
+#endif
+}
@@ -0,0 +1,714 @@
+#ifndef TINY_STATS_HPP_INCLUDED
+#define TINY_STATS_HPP_INCLUDED
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <cstddef>
+#include <memory_resource>
+
+namespace TINY
+{
+// Where translation time goes. The translator parses and emits in one pass, so parsing time is what is left of a
+// translation once the time spent getting tokens (LEX) and writing code to the output stream (EMIT) is taken out.
+// There is no optimization pass yet, OPTIMIZE stays at zero
+enum class Phase { READ, LEX, PARSE, OPTIMIZE, EMIT, WRITE, EXECUTE, COUNT };
+
+inline const char* phase_name(Phase phase)
+{
+    static const char* const names[] = {"read", "lex", "parse", "optimize", "emit", "write", "execute"};
+    return names[int(phase)];
+}
+
+// Hardware events a Phase_Timer can count on top of time, see Event_Counters
+enum class Counter { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES, COUNT };
+
+inline const char* counter_name(Counter counter)
+{
+    static const char* const names[] = {"cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"};
+    return names[int(counter)];
+}
+
+// Exclusive wall and CPU time of each phase, in seconds, and the number of times each phase was entered.
+// With event counters, also the events of each phase
+struct Phase_Times
+{
+    double wall[int(Phase::COUNT)] = {};
+    double cpu[int(Phase::COUNT)] = {};
+    std::uint64_t calls[int(Phase::COUNT)] = {};
+    std::uint64_t events[int(Phase::COUNT)][int(Counter::COUNT)] = {};
+    unsigned counters = 0; // Bit i set when Counter i was counted
+
+    Phase_Times& operator+=(const Phase_Times& other)
+    {
+        for(int i = 0; i < int(Phase::COUNT); i++)
+        {
+            wall[i] += other.wall[i];
+            cpu[i] += other.cpu[i];
+            calls[i] += other.calls[i];
+            for(int j = 0; j < int(Counter::COUNT); j++)
+                events[i][j] += other.events[i][j];
+        }
+        counters |= other.counters;
+        return *this;
+    }
+
+    double total_wall() const
+    {
+        double total = 0;
+        for(double seconds : wall)
+            total += seconds;
+        return total;
+    }
+};
+
+// Source of hardware event counts for a Phase_Timer (see tiny_perf.hpp for the Linux one). Counts only the thread
+// it was made on
+class Event_Counters
+{
+ public:
+    virtual ~Event_Counters() = default;
+
+    // Bit i set when Counter i can be counted. May lose bits once read, when the counters turn out not to count
+    virtual unsigned available() const = 0;
+
+    // Current value of every counter, zero for those not available
+    virtual void read(std::uint64_t values[int(Counter::COUNT)]) = 0;
+};
+
+// Receives every phase a Phase_Timer went through, from when it was entered to when it was left (inner phases included),
+// see Trace_Recorder (tiny_trace.hpp). Called on the thread of the timer
+class Span_Sink
+{
+ public:
+    virtual ~Span_Sink() = default;
+
+    virtual void span(Phase phase, std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end) = 0;
+};
+
+// Measures the phases of the calling thread. Time is exclusive: entering a phase stops the clock of the enclosing
+// one, which resumes when the inner phase is left, so the phases add up to the measured time.
+// Wall time comes from the steady clock, CPU time from the thread's CPU clock.
+// Only the outermost phases (regions: reading, a whole translation, writing) are measured on every call. The phases
+// nested in them run once per token or per write, where reading the clocks would cost more than the phase itself:
+// the first sample_period calls of each in a region and one call in sample_period after that are timed on the steady
+// clock alone, and the region's time is split according to these samples when it ends, its CPU time in proportion.
+// With span sinks (traces), every phase is measured instead
+class Phase_Timer
+{
+ public:
+    static const unsigned sample_period = 128;
+
+ protected:
+    // Clocks and counters at some point, what a phase is charged the difference of
+    struct Mark
+    {
+        std::chrono::steady_clock::time_point wall;
+        double cpu = 0;
+        std::uint64_t events[int(Counter::COUNT)] = {};
+    };
+
+    Phase_Times times;
+    int current; // -1 when no phase is running
+    int level;   // Running phases, 1 in a region and 2 in a phase nested in it
+    Mark mark;
+    Mark region_begin; // When the running region was entered
+    Event_Counters* p_counters;
+    Span_Sink* p_spans;
+    std::chrono::steady_clock::time_point entered[8]; // When the running phases were entered, outermost first
+
+    // Phases nested in the running region: their calls, and the time and events of those that were sampled
+    Phase_Times sampled;
+    std::uint64_t region_calls[int(Phase::COUNT)];
+    bool sampling; // The running nested phase is a sample, started at sample_mark
+    Mark sample_mark;
+
+ public:
+    Phase_Timer() : current(-1), level(0), p_counters(nullptr), p_spans(nullptr), region_calls(), sampling(false) {}
+
+    Phase_Timer(const Phase_Timer&) = delete;
+    Phase_Timer(Phase_Timer&&) = delete;
+
+    const Phase_Times& get_times() const { return times; }
+
+    // Also count hardware events in each phase, read when the clocks are. Counters made on the thread of the timer,
+    // before any phase starts
+    void set_counters(Event_Counters& counters)
+    {
+        p_counters = &counters;
+        times.counters = counters.available();
+        counters.read(mark.events);
+    }
+
+    // Also hand the spans of the phases to spans. Before any phase starts
+    void set_spans(Span_Sink& spans) { p_spans = &spans; }
+
+    // Phase running now, COUNT when none
+    Phase current_phase() const { return current < 0 ? Phase::COUNT : Phase(current); }
+
+    // Start phase, returning the phase to resume when it ends
+    int enter(Phase phase)
+    {
+        int previous = current;
+        if(p_spans || level == 0)
+        {
+            charge();
+            region_begin = mark;
+            if(p_spans && level < 8)
+                entered[level] = mark.wall;
+        }
+        else if(level == 1)
+        {
+            region_calls[int(phase)]++;
+            if(region_calls[int(phase)] <= sample_period || times.calls[int(phase)] % sample_period == 0)
+            {
+                // The clock is read last, so that it does not measure reading the counters
+                if(p_counters)
+                    p_counters->read(sample_mark.events);
+                sample_mark.wall = std::chrono::steady_clock::now();
+                sampling = true;
+            }
+        }
+        current = int(phase);
+        times.calls[current]++;
+        level++;
+        return previous;
+    }
+
+    void leave(int previous)
+    {
+        level--;
+        if(p_spans)
+        {
+            charge();
+            if(level < 8)
+                p_spans->span(Phase(current), entered[level], mark.wall);
+        }
+        else if(level == 0)
+        {
+            charge();
+            split_region();
+        }
+        else if(level == 1 && sampling)
+        {
+            // Samples leave the CPU clock out, a system call costing more than most of these phases
+            Mark now;
+            now.wall = std::chrono::steady_clock::now();
+            if(p_counters)
+                p_counters->read(now.events);
+            now.cpu = sample_mark.cpu;
+            add(sampled, current, sample_mark, now);
+            sampled.wall[current] = std::max(sampled.wall[current] - clock_overhead(), 0.0);
+            sampled.calls[current]++;
+            sampling = false;
+        }
+        current = previous;
+    }
+
+    // Timer of the calling thread, nullptr when its phases are not measured
+    static Phase_Timer*& active()
+    {
+        thread_local Phase_Timer* p_timer = nullptr;
+        return p_timer;
+    }
+
+ protected:
+    static double thread_cpu_seconds()
+    {
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return double(now.tv_sec) + double(now.tv_nsec) * 1e-9;
+    }
+
+    // Seconds between two consecutive reads of the steady clock, which each sample measures on top of its phase
+    static double clock_overhead()
+    {
+        static const double overhead = []
+        {
+            double least = 1;
+            for(int i = 0; i < 1000; i++)
+            {
+                std::chrono::steady_clock::time_point first = std::chrono::steady_clock::now();
+                std::chrono::steady_clock::time_point second = std::chrono::steady_clock::now();
+                least = std::min(least, std::chrono::duration<double>(second - first).count());
+            }
+            return least;
+        }();
+        return overhead;
+    }
+
+    void read(Mark& now)
+    {
+        now.wall = std::chrono::steady_clock::now();
+        now.cpu = thread_cpu_seconds();
+        if(p_counters)
+            p_counters->read(now.events);
+    }
+
+    // Add what happened from begin to end to phase of to
+    void add(Phase_Times& to, int phase, const Mark& begin, const Mark& end)
+    {
+        to.wall[phase] += std::chrono::duration<double>(end.wall - begin.wall).count();
+        to.cpu[phase] += end.cpu - begin.cpu;
+        if(p_counters)
+        {
+            for(int i = 0; i < int(Counter::COUNT); i++)
+                to.events[phase][i] += end.events[i] - begin.events[i];
+        }
+    }
+
+    // Charge the running phase with what happened since the last mark
+    void charge()
+    {
+        Mark now;
+        read(now);
+        if(current >= 0)
+            add(times, current, mark, now);
+        mark = now;
+        if(p_counters)
+            times.counters = p_counters->available();
+    }
+
+    // Move the estimated share of the phases nested in the region that just ended (current) out of it: each phase
+    // is charged its samples scaled by its calls. Sampling noise can make the estimates add up to more than the
+    // region, they are then scaled down to it
+    void split_region()
+    {
+        Phase_Times region;
+        add(region, current, region_begin, mark);
+
+        double factor[int(Phase::COUNT)] = {};
+        double wall = 0;
+        double events[int(Counter::COUNT)] = {};
+        for(int i = 0; i < int(Phase::COUNT); i++)
+        {
+            if(i == current || sampled.calls[i] == 0)
+                continue;
+            factor[i] = double(region_calls[i]) / double(sampled.calls[i]);
+            wall += factor[i] * sampled.wall[i];
+            for(int j = 0; j < int(Counter::COUNT); j++)
+                events[j] += factor[i] * double(sampled.events[i][j]);
+        }
+
+        auto scale = [](double estimate, double measured) { return estimate > measured ? measured / estimate : 1.0; };
+        double wall_scale = scale(wall, region.wall[current]);
+        for(int i = 0; i < int(Phase::COUNT); i++)
+        {
+            if(factor[i] == 0)
+                continue;
+            double seconds = wall_scale * factor[i] * sampled.wall[i];
+            times.wall[i] += seconds;
+            times.wall[current] -= seconds;
+            seconds = region.wall[current] > 0 ? seconds * region.cpu[current] / region.wall[current] : 0;
+            times.cpu[i] += seconds;
+            times.cpu[current] -= seconds;
+            for(int j = 0; j < int(Counter::COUNT); j++)
+            {
+                double share = scale(events[j], double(region.events[current][j])) * factor[i];
+                std::uint64_t counted = std::uint64_t(share * double(sampled.events[i][j]));
+                times.events[i][j] += counted;
+                times.events[current][j] -= counted;
+            }
+        }
+
+        sampled = Phase_Times();
+        std::fill(std::begin(region_calls), std::end(region_calls), std::uint64_t(0));
+    }
+};
+
+// Run a scope in a phase of the active timer of the thread. Costs one thread local read when nothing is measured
+class Phase_Scope
+{
+ protected:
+    Phase_Timer* p_timer;
+    int previous;
+
+ public:
+    explicit Phase_Scope(Phase phase) : p_timer(Phase_Timer::active()), previous(-1)
+    {
+        if(p_timer)
+            previous = p_timer->enter(phase);
+    }
+
+    Phase_Scope(const Phase_Scope&) = delete;
+    Phase_Scope(Phase_Scope&&) = delete;
+
+    ~Phase_Scope()
+    {
+        if(p_timer)
+            p_timer->leave(previous);
+    }
+};
+
+// Make a timer the active one of the thread for a scope
+class Phase_Timer_Activation
+{
+ protected:
+    Phase_Timer* p_saved;
+
+ public:
+    explicit Phase_Timer_Activation(Phase_Timer& timer) : p_saved(Phase_Timer::active())
+    {
+        Phase_Timer::active() = &timer;
+    }
+
+    Phase_Timer_Activation(const Phase_Timer_Activation&) = delete;
+    Phase_Timer_Activation(Phase_Timer_Activation&&) = delete;
+
+    ~Phase_Timer_Activation() { Phase_Timer::active() = p_saved; }
+};
+
+// Output stream buffer forwarding to another one and charging the time spent writing to EMIT
+class Timed_Streambuf : public std::streambuf
+{
+ protected:
+    std::streambuf* p_target;
+
+ public:
+    explicit Timed_Streambuf(std::streambuf* target) : p_target(target) {}
+
+ protected:
+    int_type overflow(int_type c) override
+    {
+        Phase_Scope scope(Phase::EMIT);
+        if(traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+        return p_target ? p_target->sputc(traits_type::to_char_type(c)) : c;
+    }
+
+    std::streamsize xsputn(const char* text, std::streamsize count) override
+    {
+        Phase_Scope scope(Phase::EMIT);
+        return p_target ? p_target->sputn(text, count) : count;
+    }
+
+    int sync() override
+    {
+        Phase_Scope scope(Phase::EMIT);
+        return p_target ? p_target->pubsync() : 0;
+    }
+};
+
+// Allocations made in each phase: how many, how many bytes, and the most bytes live at once while in the phase.
+// Index COUNT is for allocations made outside of any measured phase
+struct Allocation_Stats
+{
+    std::uint64_t count[int(Phase::COUNT) + 1] = {};
+    std::uint64_t bytes[int(Phase::COUNT) + 1] = {};
+    std::uint64_t peak[int(Phase::COUNT) + 1] = {};
+
+    // Counts add up, peaks keep the highest
+    Allocation_Stats& operator+=(const Allocation_Stats& other)
+    {
+        for(int i = 0; i <= int(Phase::COUNT); i++)
+        {
+            count[i] += other.count[i];
+            bytes[i] += other.bytes[i];
+            peak[i] = peak[i] < other.peak[i] ? other.peak[i] : peak[i];
+        }
+        return *this;
+    }
+
+    std::uint64_t total_count() const
+    {
+        std::uint64_t total = 0;
+        for(std::uint64_t n : count)
+            total += n;
+        return total;
+    }
+
+    std::uint64_t total_bytes() const
+    {
+        std::uint64_t total = 0;
+        for(std::uint64_t n : bytes)
+            total += n;
+        return total;
+    }
+
+    std::uint64_t peak_bytes() const
+    {
+        std::uint64_t highest = 0;
+        for(std::uint64_t n : peak)
+            highest = highest < n ? n : highest;
+        return highest;
+    }
+};
+
+// Memory resource counting the allocations going through it before handing them to an upstream resource. Each one is
+// charged to the phase the active Phase_Timer of the calling thread is in. Not thread safe, use one per thread like
+// std::pmr::unsynchronized_pool_resource.
+// Stacked over a pool and under another Accounting_Resource, it tells what the code asks for from what reaches the
+// system: once the pool is warm, a steady state makes no upstream allocation at all
+class Accounting_Resource : public std::pmr::memory_resource
+{
+ protected:
+    std::pmr::memory_resource* p_upstream;
+    Allocation_Stats stats;
+    std::uint64_t live; // Bytes allocated and not deallocated yet
+
+ public:
+    explicit Accounting_Resource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : p_upstream(upstream), live(0) {}
+
+    Accounting_Resource(const Accounting_Resource&) = delete;
+    Accounting_Resource(Accounting_Resource&&) = delete;
+
+    const Allocation_Stats& get_stats() const { return stats; }
+    std::uint64_t live_bytes() const { return live; }
+
+    // Start counting again, live bytes excepted
+    void reset() { stats = Allocation_Stats(); }
+
+ protected:
+    void* do_allocate(std::size_t size, std::size_t alignment) override
+    {
+        void* p = p_upstream->allocate(size, alignment);
+
+        Phase_Timer* p_timer = Phase_Timer::active();
+        int phase = int(p_timer ? p_timer->current_phase() : Phase::COUNT);
+        live += size;
+        stats.count[phase]++;
+        stats.bytes[phase] += size;
+        if(stats.peak[phase] < live)
+            stats.peak[phase] = live;
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t size, std::size_t alignment) override
+    {
+        p_upstream->deallocate(p, size, alignment);
+        live -= size;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Parts of a translation whose memory is told apart: the source text, the token buffers of the lexer, the state of the
+// parse (the translator emits while parsing, so there is no tree: indentation prefixes, profiling frames and messages),
+// the symbol table and the generated code
+enum class Component { SOURCE, TOKENS, IR, SYMBOLS, OUTPUT, COUNT };
+
+inline const char* component_name(Component component)
+{
+    static const char* const names[] = {"source", "tokens", "ir", "symbols", "output"};
+    return names[int(component)];
+}
+
+// High-water marks of a translation: the most bytes live at once in each component, and in all of them together
+struct Memory_Peaks
+{
+    std::uint64_t peak[int(Component::COUNT)] = {};
+    std::uint64_t total = 0;
+
+    // Peaks keep the highest, what the largest translation needs
+    Memory_Peaks& operator+=(const Memory_Peaks& other)
+    {
+        for(int i = 0; i < int(Component::COUNT); i++)
+            peak[i] = peak[i] < other.peak[i] ? other.peak[i] : peak[i];
+        total = total < other.total ? other.total : total;
+        return *this;
+    }
+};
+
+// Live bytes of each component of a translation, as requested from the allocator rather than as held by it, so that
+// the caching of a pool or of malloc does not show. Each component allocates through resource(component), which
+// counts the bytes going through it before handing them to the upstream resource. Not thread safe, use one per
+// translation like Accounting_Resource
+class Memory_Tracker
+{
+ protected:
+    class Component_Resource : public std::pmr::memory_resource
+    {
+     public:
+        Memory_Tracker* p_tracker = nullptr;
+        int component = 0;
+
+     protected:
+        void* do_allocate(std::size_t size, std::size_t alignment) override
+        {
+            void* p = p_tracker->p_upstream->allocate(size, alignment);
+            p_tracker->live[component] += size;
+            p_tracker->live_total += size;
+            Memory_Peaks& peaks = p_tracker->peaks;
+            if(peaks.peak[component] < p_tracker->live[component])
+                peaks.peak[component] = p_tracker->live[component];
+            if(peaks.total < p_tracker->live_total)
+                peaks.total = p_tracker->live_total;
+            return p;
+        }
+
+        void do_deallocate(void* p, std::size_t size, std::size_t alignment) override
+        {
+            p_tracker->p_upstream->deallocate(p, size, alignment);
+            p_tracker->live[component] -= size;
+            p_tracker->live_total -= size;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    std::pmr::memory_resource* p_upstream;
+    Component_Resource resources[int(Component::COUNT)];
+    std::uint64_t live[int(Component::COUNT)];
+    std::uint64_t live_total;
+    Memory_Peaks peaks;
+
+ public:
+    explicit Memory_Tracker(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : p_upstream(upstream), live(), live_total(0)
+    {
+        for(int i = 0; i < int(Component::COUNT); i++)
+        {
+            resources[i].p_tracker = this;
+            resources[i].component = i;
+        }
+    }
+
+    Memory_Tracker(const Memory_Tracker&) = delete;
+    Memory_Tracker(Memory_Tracker&&) = delete;
+
+    std::pmr::memory_resource* resource(Component component) { return &resources[int(component)]; }
+
+    const Memory_Peaks& get_peaks() const { return peaks; }
+    std::uint64_t live_bytes(Component component) const { return live[int(component)]; }
+};
+
+// Phase table: one row per phase with wall and CPU milliseconds, the share of the wall time and the entry count
+inline void print_phase_table(const Phase_Times& times, std::ostream& out)
+{
+    double total = times.total_wall();
+    out << "phase       wall(ms)   cpu(ms)      %      calls\n";
+    for(int i = 0; i < int(Phase::COUNT); i++)
+    {
+        char line[96];
+        std::snprintf(line, sizeof line, "%-9s %10.3f %9.3f %6.1f %10llu\n", phase_name(Phase(i)), 1000 * times.wall[i],
+                      1000 * times.cpu[i], total > 0 ? 100 * times.wall[i] / total : 0.0,
+                      static_cast<unsigned long long>(times.calls[i]));
+        out << line;
+    }
+
+    if(times.counters == 0)
+        return;
+
+    // Events, with instructions per cycle when both were counted
+    out << "\nphase    ";
+    for(int j = 0; j < int(Counter::COUNT); j++)
+    {
+        if(times.counters & (1u << j))
+        {
+            char column[32];
+            std::snprintf(column, sizeof column, " %14s", counter_name(Counter(j)));
+            out << column;
+        }
+    }
+    bool ipc = (times.counters & 3u) == 3u;
+    out << (ipc ? "    ipc\n" : "\n");
+    for(int i = 0; i < int(Phase::COUNT); i++)
+    {
+        char line[160];
+        int length = std::snprintf(line, sizeof line, "%-9s", phase_name(Phase(i)));
+        for(int j = 0; j < int(Counter::COUNT); j++)
+            if(times.counters & (1u << j))
+                length += std::snprintf(line + length, sizeof line - length, " %14llu",
+                                        static_cast<unsigned long long>(times.events[i][j]));
+        const std::uint64_t* events = times.events[i];
+        if(ipc)
+            std::snprintf(line + length, sizeof line - length, " %6.2f",
+                          events[int(Counter::CYCLES)] ? double(events[int(Counter::INSTRUCTIONS)]) / double(events[int(Counter::CYCLES)]) : 0.0);
+        out << line << "\n";
+    }
+}
+
+// Allocation table: one row per phase with the allocation count, the bytes allocated and the peak of live bytes
+inline void print_allocation_table(const Allocation_Stats& stats, std::ostream& out)
+{
+    out << "phase     allocations        bytes   peak bytes\n";
+    for(int i = 0; i <= int(Phase::COUNT); i++)
+    {
+        char line[96];
+        std::snprintf(line, sizeof line, "%-9s %11llu %12llu %12llu\n", i < int(Phase::COUNT) ? phase_name(Phase(i)) : "other",
+                      static_cast<unsigned long long>(stats.count[i]), static_cast<unsigned long long>(stats.bytes[i]),
+                      static_cast<unsigned long long>(stats.peak[i]));
+        out << line;
+    }
+}
+
+// Memory table: the high-water mark of each component and of all of them together
+inline void print_memory_table(const Memory_Peaks& peaks, std::ostream& out)
+{
+    out << "component   peak bytes\n";
+    for(int i = 0; i <= int(Component::COUNT); i++)
+    {
+        char line[64];
+        std::snprintf(line, sizeof line, "%-9s %12llu\n", i < int(Component::COUNT) ? component_name(Component(i)) : "total",
+                      static_cast<unsigned long long>(i < int(Component::COUNT) ? peaks.peak[i] : peaks.total));
+        out << line;
+    }
+}
+
+// {"source": ..., "tokens": ..., "ir": ..., "symbols": ..., "output": ..., "total": ...}, peak bytes
+inline std::string memory_json(const Memory_Peaks& peaks)
+{
+    std::string json = "{";
+    for(int i = 0; i <= int(Component::COUNT); i++)
+    {
+        char member[64];
+        std::snprintf(member, sizeof member, "%s\"%s\":%llu", i ? "," : "",
+                      i < int(Component::COUNT) ? component_name(Component(i)) : "total",
+                      static_cast<unsigned long long>(i < int(Component::COUNT) ? peaks.peak[i] : peaks.total));
+        json += member;
+    }
+    return json + "}";
+}
+
+// {"read": {"wall_ms": ..., "cpu_ms": ..., "calls": ...}, "lex": {...}, ...}
+// Counted events are added to each phase: {"wall_ms": ..., ..., "cycles": ..., "instructions": ...}
+inline std::string phase_json(const Phase_Times& times)
+{
+    std::string json = "{";
+    for(int i = 0; i < int(Phase::COUNT); i++)
+    {
+        char member[128];
+        std::snprintf(member, sizeof member, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"calls\":%llu", i ? "," : "",
+                      phase_name(Phase(i)), 1000 * times.wall[i], 1000 * times.cpu[i],
+                      static_cast<unsigned long long>(times.calls[i]));
+        json += member;
+        for(int j = 0; j < int(Counter::COUNT); j++)
+        {
+            if(times.counters & (1u << j))
+            {
+                std::snprintf(member, sizeof member, ",\"%s\":%llu", counter_name(Counter(j)),
+                              static_cast<unsigned long long>(times.events[i][j]));
+                json += member;
+            }
+        }
+        json += "}";
+    }
+    return json + "}";
+}
+
+// {"read": {"allocations": ..., "bytes": ..., "peak_bytes": ...}, ..., "other": {...}}
+inline std::string allocation_json(const Allocation_Stats& stats)
+{
+    std::string json = "{";
+    for(int i = 0; i <= int(Phase::COUNT); i++)
+    {
+        char member[128];
+        std::snprintf(member, sizeof member, "%s\"%s\":{\"allocations\":%llu,\"bytes\":%llu,\"peak_bytes\":%llu}",
+                      i ? "," : "", i < int(Phase::COUNT) ? phase_name(Phase(i)) : "other",
+                      static_cast<unsigned long long>(stats.count[i]), static_cast<unsigned long long>(stats.bytes[i]),
+                      static_cast<unsigned long long>(stats.peak[i]));
+        json += member;
+    }
+    return json + "}";
+}
+}
+
+#endif // TINY_STATS_HPP_INCLUDED
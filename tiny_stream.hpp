@@ -0,0 +1,171 @@
+#ifndef TINY_STREAM_HPP_INCLUDED
+#define TINY_STREAM_HPP_INCLUDED
+
+#include <streambuf>
+#include <string>
+#include <memory_resource>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+
+#include <unistd.h>
+
+namespace TINY
+{
+// Input stream buffer reading a file descriptor (stdin, a pipe, a socket...) as data arrives.
+// The lexer moves back by putting back whole tokens with their leading whitespace, which std::cin and std::filebuf
+// only support for one character on pipes. This buffer keeps the last putback_size characters read before each refill
+// and makes room for any further putback, so move_back works whatever the amount of text to put back
+class Fd_Streambuf : public std::streambuf
+{
+ protected:
+    int fd;
+    std::vector<char> storage;
+    std::size_t chunk_size;    // Bytes asked to read() at once
+    std::size_t putback_size;  // Characters kept in front of the new data on refill
+
+ public:
+    explicit Fd_Streambuf(int descriptor, std::size_t chunk = 1 << 16, std::size_t putback = 1 << 12)
+        : fd(descriptor), storage(putback + chunk), chunk_size(chunk), putback_size(putback)
+    {
+        setg(storage.data(), storage.data(), storage.data());
+    }
+
+    Fd_Streambuf(const Fd_Streambuf&) = delete;
+    Fd_Streambuf(Fd_Streambuf&&) = delete;
+
+ protected:
+    int_type underflow() override
+    {
+        if(gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        std::size_t keep = std::min<std::size_t>(std::size_t(gptr() - eback()), putback_size);
+        std::vector<char> kept(gptr() - keep, gptr());
+        if(storage.size() < keep + chunk_size)
+            storage.resize(keep + chunk_size);
+        std::memcpy(storage.data(), kept.data(), keep);
+
+        ssize_t got;
+        do
+        {
+            // A pipe returns what is available, so every line can be processed as soon as it is written
+            got = ::read(fd, storage.data() + keep, chunk_size);
+        } while(got < 0 && errno == EINTR);
+
+        setg(storage.data(), storage.data() + keep, storage.data() + keep + (got > 0 ? got : 0));
+        if(got <= 0)
+            return traits_type::eof();
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type pbackfail(int_type c) override
+    {
+        if(traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::eof();
+
+        if(gptr() > eback())
+        {
+            gbump(-1);
+            *gptr() = traits_type::to_char_type(c);
+            return c;
+        }
+
+        // No room left in front: move the unread characters behind a new putback area
+        std::size_t unread = std::size_t(egptr() - gptr());
+        std::vector<char> grown(putback_size + unread + chunk_size);
+        std::memcpy(grown.data() + putback_size, gptr(), unread);
+        storage.swap(grown);
+
+        setg(storage.data(), storage.data() + putback_size - 1, storage.data() + putback_size + unread);
+        *gptr() = traits_type::to_char_type(c);
+        return c;
+    }
+};
+
+// Input stream buffer reading memory owned by the caller, which is never written (it may be read only).
+// Putting back what was just read only moves the read position; when the lexer puts back something else (at the
+// start of the memory, or a character that is not the one read), that character goes to a small overlay read before
+// the memory again
+class View_Streambuf : public std::streambuf
+{
+ protected:
+    char* data_end;
+    std::string overlay;
+    char* resume; // Where to continue in the memory once the overlay is read, nullptr when reading the memory
+
+ public:
+    View_Streambuf(const char* data, std::size_t size) : data_end(const_cast<char*>(data) + size), resume(nullptr)
+    {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, data_end);
+    }
+
+    View_Streambuf(const View_Streambuf&) = delete;
+    View_Streambuf(View_Streambuf&&) = delete;
+
+ protected:
+    int_type underflow() override
+    {
+        if(gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if(!resume)
+            return traits_type::eof();
+
+        setg(resume, resume, data_end);
+        resume = nullptr;
+        return gptr() < egptr() ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+    }
+
+    int_type pbackfail(int_type c) override
+    {
+        if(traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::eof();
+
+        if(!resume)
+        {
+            resume = gptr();
+            overlay.assign(1, traits_type::to_char_type(c));
+        }
+        else
+        {
+            overlay = std::string(1, traits_type::to_char_type(c)) + std::string(gptr(), egptr());
+        }
+        setg(&overlay[0], &overlay[0], &overlay[0] + overlay.size());
+        return c;
+    }
+};
+
+// Output stream buffer appending to a string owned by the caller, so that the result needs no copy out of a stream
+template<class String>
+class Basic_String_Streambuf : public std::streambuf
+{
+ protected:
+    String* p_string;
+
+ public:
+    explicit Basic_String_Streambuf(String& target) : p_string(&target) {}
+
+ protected:
+    int_type overflow(int_type c) override
+    {
+        if(!traits_type::eq_int_type(c, traits_type::eof()))
+            p_string->push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* text, std::streamsize count) override
+    {
+        p_string->append(text, std::size_t(count));
+        return count;
+    }
+};
+
+using String_Streambuf = Basic_String_Streambuf<std::string>;
+// Same over a string whose memory comes from a memory resource
+using Pmr_String_Streambuf = Basic_String_Streambuf<std::pmr::string>;
+}
+
+#endif // TINY_STREAM_HPP_INCLUDED
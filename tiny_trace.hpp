@@ -0,0 +1,187 @@
+#ifndef TINY_TRACE_HPP_INCLUDED
+#define TINY_TRACE_HPP_INCLUDED
+
+#include "tiny_stats.hpp"
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#include <unistd.h>
+
+namespace TINY
+{
+// Records the spans of translations running on any number of threads and writes them as Chrome trace events, to be
+// opened in Perfetto (ui.perfetto.dev) or chrome://tracing. Each thread appends to a buffer of its own, found through
+// a thread local pointer; a thread joins the recorder by pushing its buffer on a lock free list, so recording never
+// takes a lock. write() reads every buffer and must only be called once the recording threads are done.
+//
+// To trace translations made from another thread pool, give each one a Phase_Timer with the recorder as span sink,
+// and record the file around it:
+//
+//     Phase_Timer timer;
+//     timer.set_spans(recorder);
+//     Phase_Timer_Activation activation(timer);
+//     auto begin = std::chrono::steady_clock::now();
+//     bool ok = translator.translate(input, output);
+//     recorder.file(path, begin, std::chrono::steady_clock::now(), ok, timer.get_times());
+class Trace_Recorder : public Span_Sink
+{
+ protected:
+    struct Span
+    {
+        Phase phase;
+        std::chrono::steady_clock::time_point begin;
+        std::chrono::steady_clock::time_point end;
+    };
+
+    struct File_Span
+    {
+        std::string path;
+        std::chrono::steady_clock::time_point begin;
+        std::chrono::steady_clock::time_point end;
+        bool ok;
+        Phase_Times times;
+    };
+
+    struct Buffer
+    {
+        Buffer* p_next;
+        std::uint32_t thread; // Order in which the threads joined, the trace's thread id
+        std::vector<Span> spans;
+        std::vector<File_Span> files;
+    };
+
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration min_span;
+    std::uint64_t id;                  // Tells recorders apart in the thread local pointers, addresses can be reused
+    std::atomic<Buffer*> p_buffers;
+    std::atomic<std::uint32_t> threads;
+
+ public:
+    // Spans shorter than min_span_us microseconds are not recorded: the lexer is entered for every token, and
+    // keeping all of them makes traces of large batches too big to open. Their time still shows in the totals
+    // of each file. 0 records everything
+    explicit Trace_Recorder(double min_span_us = 10)
+        : start(std::chrono::steady_clock::now()),
+          min_span(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double, std::micro>(min_span_us))),
+          id(next_id()), p_buffers(nullptr), threads(0) {}
+
+    Trace_Recorder(const Trace_Recorder&) = delete;
+    Trace_Recorder(Trace_Recorder&&) = delete;
+
+    ~Trace_Recorder() override
+    {
+        for(Buffer* p_buffer = p_buffers.load(); p_buffer; )
+        {
+            Buffer* p_next = p_buffer->p_next;
+            delete p_buffer;
+            p_buffer = p_next;
+        }
+    }
+
+    void span(Phase phase, std::chrono::steady_clock::time_point begin,
+              std::chrono::steady_clock::time_point end) override
+    {
+        if(end - begin >= min_span)
+            thread_buffer().spans.push_back(Span{phase, begin, end});
+    }
+
+    // Translation of a whole file, with the exclusive times of its phases as arguments
+    void file(const std::string& path, std::chrono::steady_clock::time_point begin,
+              std::chrono::steady_clock::time_point end, bool ok, const Phase_Times& times)
+    {
+        thread_buffer().files.push_back(File_Span{path, begin, end, ok, times});
+    }
+
+    // {"traceEvents": [...]}: a complete event ("ph": "X") per span, on one track per recording thread
+    void write(std::ostream& out) const
+    {
+        int pid = int(getpid());
+        char line[256];
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        std::snprintf(line, sizeof line, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"tiny\"}}",
+                      pid);
+        out << line;
+
+        for(const Buffer* p_buffer = p_buffers.load(); p_buffer; p_buffer = p_buffer->p_next)
+        {
+            std::snprintf(line, sizeof line,
+                          ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}",
+                          pid, p_buffer->thread, p_buffer->thread);
+            out << line;
+
+            for(const Span& span : p_buffer->spans)
+            {
+                std::snprintf(line, sizeof line,
+                              ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                              phase_name(span.phase), microseconds(span.begin - start),
+                              microseconds(span.end - span.begin), pid, p_buffer->thread);
+                out << line;
+            }
+
+            for(const File_Span& file : p_buffer->files)
+            {
+                out << ",\n{\"name\":\"";
+                for(char c : file.path)
+                {
+                    if(c == '"' || c == '\\')
+                        out << '\\';
+                    if(static_cast<unsigned char>(c) >= 0x20)
+                        out << c;
+                }
+                std::snprintf(line, sizeof line,
+                              "\",\"cat\":\"file\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"ok\":%s",
+                              microseconds(file.begin - start), microseconds(file.end - file.begin), pid,
+                              p_buffer->thread, file.ok ? "true" : "false");
+                out << line;
+                for(int i = 0; i < int(Phase::COUNT); i++)
+                {
+                    if(file.times.calls[i] != 0)
+                    {
+                        std::snprintf(line, sizeof line, ",\"%s_ms\":%.3f", phase_name(Phase(i)), 1000 * file.times.wall[i]);
+                        out << line;
+                    }
+                }
+                out << "}}";
+            }
+        }
+        out << "\n]}" << std::endl;
+    }
+
+ protected:
+    static std::uint64_t next_id()
+    {
+        static std::atomic<std::uint64_t> ids(1);
+        return ids++;
+    }
+
+    static double microseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+
+    // Buffer of the calling thread, made and pushed on the list the first time the thread records
+    Buffer& thread_buffer()
+    {
+        thread_local std::uint64_t owner = 0;
+        thread_local Buffer* p_buffer = nullptr;
+        if(owner != id)
+        {
+            p_buffer = new Buffer{p_buffers.load(std::memory_order_relaxed), ++threads, {}, {}};
+            p_buffer->spans.reserve(4096);
+            while(!p_buffers.compare_exchange_weak(p_buffer->p_next, p_buffer, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {}
+            owner = id;
+        }
+        return *p_buffer;
+    }
+};
+}
+
+#endif // TINY_TRACE_HPP_INCLUDED
@@ -0,0 +1,95 @@
+// Implementation of the compiled library mode (tiny_translator.hpp) over the header only translator.
+// Build it with the C API into libtiny (CMakeLists.txt), or on its own:
+//     g++ -std=c++17 -O2 -fPIC -c tiny_translator.cpp && ar rcs libtiny.a tiny_translator.o
+
+#include "tiny_translator.hpp"
+
+#include "tiny_language (1).hpp"
+#include "tiny_stream.hpp"
+
+#include <set>
+#include <istream>
+#include <ostream>
+
+namespace TINY
+{
+struct Compiled_Translator::Impl
+{
+    Translator translator;
+    std::ostream* p_diagnostics = &std::cerr; // Given to set_diagnostics, restored after translating to a string
+};
+
+const char* translator_version()
+{
+    return TINY_TRANSLATOR_VERSION;
+}
+
+Compiled_Translator::Compiled_Translator() : p_impl(new Impl) {}
+
+Compiled_Translator::~Compiled_Translator() = default;
+
+void Compiled_Translator::set_diagnostics(std::ostream& out)
+{
+    p_impl->translator.set_diagnostics(out);
+    p_impl->p_diagnostics = &out;
+}
+
+void Compiled_Translator::set_profiling(Profile_Mode mode)
+{
+    p_impl->translator.set_profiling(Translator::Profile_Mode(int(mode)));
+}
+
+bool Compiled_Translator::operator()(const std::string& file_path)
+{
+    return p_impl->translator(file_path);
+}
+
+bool Compiled_Translator::translate(std::iostream& input, std::ostream& output)
+{
+    return p_impl->translator.translate(input, output);
+}
+
+bool Compiled_Translator::translate(std::string_view source, std::string& code, std::string* p_diagnostics)
+{
+    View_Streambuf input_buffer(source.data(), source.size());
+    std::iostream input(&input_buffer);
+    code.clear();
+    String_Streambuf code_buffer(code);
+    std::ostream output(&code_buffer);
+
+    if(!p_diagnostics)
+    {
+        bool ok = p_impl->translator.translate(input, output);
+        output.flush();
+        return ok;
+    }
+
+    // Diagnostics go to *p_diagnostics for this call only
+    p_diagnostics->clear();
+    String_Streambuf diagnostics_buffer(*p_diagnostics);
+    std::ostream diagnostics(&diagnostics_buffer);
+    p_impl->translator.set_diagnostics(diagnostics);
+    bool ok = p_impl->translator.translate(input, output);
+    output.flush();
+    diagnostics.flush();
+    p_impl->translator.set_diagnostics(*p_impl->p_diagnostics);
+    return ok;
+}
+
+bool Compiled_Translator::translate_fragment(std::iostream& input, std::ostream& output,
+                                             const std::vector<std::string>& declared)
+{
+    return p_impl->translator.translate_fragment(input, output, std::set<std::string>(declared.begin(), declared.end()));
+}
+
+void Compiled_Translator::begin_program(std::ostream& output)
+{
+    Translator::begin_output(output);
+    Translator::begin_main(output);
+}
+
+void Compiled_Translator::end_program(std::ostream& output)
+{
+    Translator::end_main(output);
+}
+}
@@ -0,0 +1,66 @@
+#ifndef TINY_TRANSLATOR_HPP_INCLUDED
+#define TINY_TRANSLATOR_HPP_INCLUDED
+
+// Compiled library mode of the translator: the API of tiny_language (1).hpp without its implementation, which lives in
+// tiny_translator.cpp (in libtiny with the CMake build). Including this header costs <iosfwd>, <string>, <vector>
+// and <memory>, not the lexer, the parser and <iostream>.
+//
+//     TINY::Compiled_Translator translator;
+//     std::string code, diagnostics;
+//     if(!translator.translate(source, code, &diagnostics))
+//         report(diagnostics);
+//
+// Translation units needing the rest (memory resources, Phase_Timer, the batch drivers) include the full header.
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+namespace TINY
+{
+// Version of the generated code, TINY_TRANSLATOR_VERSION of the library
+const char* translator_version();
+
+class Compiled_Translator
+{
+ protected:
+    struct Impl;
+    std::unique_ptr<Impl> p_impl;
+
+ public:
+    // Instrumentation of the generated code, as Translator::Profile_Mode
+    enum class Profile_Mode { NONE, COUNT, SAMPLE };
+
+    Compiled_Translator();
+    ~Compiled_Translator();
+
+    // Each translator should use its own resources
+    Compiled_Translator(const Compiled_Translator&) = delete;
+    Compiled_Translator(Compiled_Translator&&) = delete;
+
+    // Redirect error messages to another stream. Defaults to std::cerr
+    void set_diagnostics(std::ostream& out);
+
+    // Write instrumented code, see Translator::set_profiling
+    void set_profiling(Profile_Mode mode);
+
+    // Translate the .txt file at file_path into the .cpp file next to it. Returns false on error
+    bool operator()(const std::string& file_path);
+
+    // Translate a whole program read from input, writing the C++ code to output. Returns false on error
+    bool translate(std::iostream& input, std::ostream& output);
+
+    // Translate a program in memory. The diagnostics go to *p_diagnostics instead when given
+    bool translate(std::string_view source, std::string& code, std::string* p_diagnostics = nullptr);
+
+    // Translate a fragment of top level statements, the identifiers in declared being already declared, see
+    // Translator::translate_fragment. begin_program and end_program write the code around the fragments
+    bool translate_fragment(std::iostream& input, std::ostream& output, const std::vector<std::string>& declared);
+    static void begin_program(std::ostream& output);
+    static void end_program(std::ostream& output);
+};
+}
+
+#endif // TINY_TRANSLATOR_HPP_INCLUDED
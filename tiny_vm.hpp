@@ -0,0 +1,714 @@
+#ifndef TINY_VM_HPP_INCLUDED
+#define TINY_VM_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_bytecode.hpp"
+#include "tiny_literal.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+
+namespace TINY
+{
+// Errors raised while a program is running (division by zero, step limit)
+using Runtime_Error = Error<2>;
+
+// Recursive descent compiler from TINY to bytecode. It follows the grammar and the error messages of the Translator,
+// so a program is accepted by one exactly when it is accepted by the other
+class Compiler
+{
+    using Token = Translator::Token;
+    using Lexer = Translator::Lexer;
+
+ protected:
+    Lexer* p_lexer;
+    Bytecode* p_code;
+
+    // Slot of every declared variable, plays the role of the translator's id_set
+    std::map<std::string, std::uint32_t> slots;
+
+    std::ostream* p_diagnostics;
+
+ public:
+    Compiler() : p_lexer(nullptr), p_code(nullptr), slots(), p_diagnostics(&std::cerr) {}
+
+    Compiler(const Compiler&) = delete;
+    Compiler(Compiler&&) = delete;
+
+    void set_diagnostics(std::ostream& out) { p_diagnostics = &out; }
+
+    // Compile a whole program read from input into code. Returns false on error
+    bool compile(std::iostream& input, Bytecode& code)
+    {
+        Phase_Scope scope(Phase::PARSE);
+        Lexer lexer(input);
+        p_lexer = &lexer;
+        p_code = &code;
+        code.clear();
+
+        bool result = true;
+        try
+        {
+            program();
+        }
+        catch(Lexical_Error& er)
+        {
+            *p_diagnostics << "Lexical Error: " << er << std::endl;
+            result = false;
+        }
+        catch(Syntax_Error& er)
+        {
+            *p_diagnostics << "Syntax Error: " << er << std::endl;
+            result = false;
+        }
+
+        p_lexer = nullptr;
+        p_code = nullptr;
+        slots.clear();
+
+        return result;
+    }
+
+ private:
+    std::uint32_t emit(Op op, std::uint32_t operand = 0)
+    {
+        p_code->code.push_back(Instruction{op, operand});
+        return std::uint32_t(p_code->code.size() - 1);
+    }
+
+    // Point the jump at index to the next instruction to be emitted
+    void patch(std::uint32_t index)
+    {
+        p_code->code[index].operand = std::uint32_t(p_code->code.size());
+    }
+
+    std::uint32_t declare(const std::string& name)
+    {
+        auto found = slots.find(name);
+        if(found != slots.end())
+            return found->second;
+
+        std::uint32_t slot = std::uint32_t(p_code->variables.size());
+        p_code->variables.push_back(name);
+        slots.emplace(name, slot);
+        return slot;
+    }
+
+    // <program>	::= 'BEGIN' <newlines> <statements> <newlines> 'END'
+    void program()
+    {
+        std::string temp_text;
+
+        p_lexer->advance();
+        if(p_lexer->get_current_token() != Token::BEGIN_LITERAL)
+        {
+            throw Syntax_Error{"Cannot find the beginning of the program"};
+        }
+
+        newlines("BEGIN");
+        p_lexer->advance();
+
+        if(p_lexer->get_current_token() != Token::END_LITERAL)
+        {
+            statements();
+
+            temp_text = p_lexer->get_current_text();
+            p_lexer->advance();
+        }
+
+        Token current_token = p_lexer->get_current_token();
+        if((current_token != Token::END_LITERAL) && !(current_token == Token::EOFSTREAM && temp_text == "END"))
+        {
+            throw Syntax_Error{"Cannot find the end of the program"};
+        }
+        p_lexer->advance();
+
+        emit(Op::HALT);
+
+        if(p_lexer->get_current_token() != Token::EOFSTREAM)
+        {
+            throw Syntax_Error{"Unexpected tokens after END"};
+        }
+    }
+
+    void newlines(std::string name)
+    {
+        p_lexer->advance(true);
+        if(p_lexer->get_current_token() != Token::NEWLINE)
+        {
+            throw Syntax_Error{name + " must be followed by a newline"};
+        }
+    }
+
+    void statements()
+    {
+        while(true)
+        {
+            switch(p_lexer->get_current_token())
+            {
+            case Token::PRINT_LITERAL:
+                print_statement();
+                newlines("print_statement");
+                break;
+
+            case Token::INPUT_LITERAL:
+                input_statement();
+                newlines("input_statement");
+                break;
+
+            case Token::LET_LITERAL:
+                let_statement();
+                newlines("let_statement");
+                break;
+
+            case Token::IF_LITERAL:
+                if_statement();
+                newlines("if_statement");
+                break;
+
+            case Token::WHILE_LITERAL:
+                while_statement();
+                newlines("print_statement");
+                break;
+
+            default:
+                p_lexer->move_back();
+                return;
+            }
+
+            p_lexer->advance(); // Move past the newline
+        }
+    }
+
+    // <print_statement>	::= 'PRINT' <string>|'PRINT' id
+    void print_statement()
+    {
+        p_lexer->advance(); // move past PRINT literal
+
+        switch(p_lexer->get_current_token())
+        {
+        case Token::STRING:
+            p_code->strings.push_back(p_lexer->get_current_text());
+            emit(Op::PRINT_STRING, std::uint32_t(p_code->strings.size() - 1));
+            return;
+        case Token::ID:
+            if(slots.find(p_lexer->get_current_text()) == slots.end())
+            {
+                throw Syntax_Error{"Attempt to print an undeclared identifier"};
+            }
+
+            emit(Op::LOAD, slots[p_lexer->get_current_text()]);
+            emit(Op::PRINT);
+            return;
+
+        default:
+            throw Syntax_Error{"Unexpected tokens after PRINT"};
+        }
+    }
+
+    // <input_statement>	::= 'INPUT' <id>
+    void input_statement()
+    {
+        p_lexer->advance(); // move past INPUT literal
+
+        if(p_lexer->get_current_token() == Token::ID)
+        {
+            emit(Op::INPUT, declare(p_lexer->get_current_text()));
+            return;
+        }
+        else
+        {
+            throw Syntax_Error{"Unexpected tokens after INPUT"};
+        }
+    }
+
+    // <let_statement>	::= 'LET' <assignment>
+    void let_statement()
+    {
+        p_lexer->advance(); // move past LET literal
+
+        // Declare before the assignment is checked, exactly like the translator does
+        if(p_lexer->get_current_token() == Token::ID)
+            declare(p_lexer->get_current_text());
+
+        assignment();
+    }
+
+    // <if_statement>	:= 'IF' <condition> <newline> <statements> <newline> 'ENDIF' with optional ELSEIF and ELSE parts
+    void if_statement()
+    {
+        std::vector<std::uint32_t> exits; // Jumps to the end of the whole statement
+
+        p_lexer->advance(); // move past IF literal
+        condition();
+        newlines("if_statement's condition");
+
+        std::uint32_t skip = emit(Op::JUMP_IF_FALSE);
+
+        p_lexer->advance(); // move past newline literal
+        statements();
+
+        p_lexer->advance();
+        Token current_token = p_lexer->get_current_token();
+
+        while(current_token == Token::ELSEIF_LITERAL)
+        {
+            exits.push_back(emit(Op::JUMP));
+            patch(skip);
+
+            p_lexer->advance(); // move past ELSEIF literal
+            condition();
+            newlines("elseif_statement's condition");
+
+            skip = emit(Op::JUMP_IF_FALSE);
+
+            p_lexer->advance(); // move past newline literal
+            statements();
+
+            p_lexer->advance();
+            current_token = p_lexer->get_current_token();
+        }
+
+        if(current_token == Token::ELSE_LITERAL)
+        {
+            newlines("ELSE");
+
+            exits.push_back(emit(Op::JUMP));
+            patch(skip);
+
+            p_lexer->advance(); // move past newline literal
+            statements();
+
+            p_lexer->advance(); // move past the statement
+            current_token = p_lexer->get_current_token();
+        }
+        else
+        {
+            patch(skip);
+        }
+
+        if(current_token != Token::ENDIF_LITERAL)
+        {
+            throw Syntax_Error{"Cannot find the end of if_statement"};
+        }
+
+        for(std::uint32_t exit : exits)
+            patch(exit);
+    }
+
+    // <while_statement>	:= 'WHILE' <condition> 'REPEAT' <newline> <statements> <newline> 'ENDWHILE'
+    void while_statement()
+    {
+        std::uint32_t start = std::uint32_t(p_code->code.size());
+
+        p_lexer->advance(); // move past WHILE literal
+        condition();
+
+        std::uint32_t exit = emit(Op::JUMP_IF_FALSE);
+
+        p_lexer->advance(true);
+        if(p_lexer->get_current_token() != Token::REPEAT_LITERAL)
+        {
+            throw Syntax_Error{"a WHILE literal and a REPEAT literal must be on the same line"};
+        }
+
+        newlines("REPEAT");
+
+        p_lexer->advance(); // move past newline literal
+        statements();
+
+        emit(Op::JUMP, start);
+        patch(exit);
+
+        p_lexer->advance();
+        if(p_lexer->get_current_token() != Token::ENDWHILE_LITERAL)
+        {
+            throw Syntax_Error{"Cannot find the end of while_statement"};
+        }
+    }
+
+    // <assignment>	::= <id> = <expression>
+    void assignment()
+    {
+        if(p_lexer->get_current_token() != Token::ID)
+        {
+            throw Syntax_Error{"Target of assignment must be an identifier"};
+        }
+        else if(slots.find(p_lexer->get_current_text()) == slots.end())
+        {
+            throw Syntax_Error{"Attempt to assign to an undeclared identifier"};
+        }
+
+        std::uint32_t slot = slots[p_lexer->get_current_text()];
+
+        p_lexer->advance();
+        if(p_lexer->get_current_token() != Token::ASSIGNMENT_SYMBOL)
+        {
+            throw Syntax_Error{"Unexpected token in assignment"};
+        }
+
+        p_lexer->advance(); // Move past assignment symbol
+        expression();
+        emit(Op::STORE, slot);
+    }
+
+    // <expression> 	::= <exp> | <exp> ('+'|'-'|'*'|'/'|'mod') <exp>
+    void expression()
+    {
+        exp();
+
+        p_lexer->advance(); // Move past the exp
+
+        Op op;
+        switch(p_lexer->get_current_token())
+        {
+        case Token::PLUS_SYMBOL:
+            op = Op::ADD;
+            break;
+        case Token::MINUS_SYMBOL:
+            op = Op::SUB;
+            break;
+        case Token::MUL_SYMBOL:
+            op = Op::MUL;
+            break;
+        case Token::DIV_SYMBOL:
+            op = Op::DIV;
+            break;
+        case Token::MOD_SYMBOL:
+            op = Op::MOD;
+            break;
+        default:
+            p_lexer->move_back();
+            return;
+        }
+
+        p_lexer->advance(); // Move past the symbol
+        exp();
+        emit(op);
+    }
+
+    // <exp>	:= <id>|<number>
+    void exp()
+    {
+        if(p_lexer->get_current_token() == Token::ID)
+        {
+            if(slots.find(p_lexer->get_current_text()) == slots.end())
+            {
+                throw Syntax_Error{"Attempt to handle an undeclared identifier in exp"};
+            }
+
+            emit(Op::LOAD, slots[p_lexer->get_current_text()]);
+        }
+        else
+        {
+            number();
+        }
+    }
+
+    // <number>	::= '-'<num>|'+'<num>| <num>
+    void number()
+    {
+        bool negative = false;
+
+        switch(p_lexer->get_current_token())
+        {
+        case Token::MINUS_SYMBOL:
+        case Token::PLUS_SYMBOL:
+            negative = p_lexer->get_current_token() == Token::MINUS_SYMBOL;
+
+            p_lexer->advance();
+            if(p_lexer->get_current_token() != Token::NUM)
+            {
+                throw Syntax_Error{"Unexpected tokens in number"};
+            }
+            break;
+
+        case Token::NUM:
+            break;
+
+        default:
+            throw Syntax_Error{"Unexpected tokens in number"};
+        }
+
+        Value value = literal(p_lexer->get_current_text());
+        if(negative)
+        {
+            value.integer = -value.integer;
+            value.number = -value.number;
+        }
+
+        p_code->constants.push_back(value);
+        emit(Op::PUSH, std::uint32_t(p_code->constants.size() - 1));
+    }
+
+    // Value of a numeric literal, by the rule of tiny_literal.hpp
+    static Value literal(const std::string& text)
+    {
+        Literal literal;
+        if(!convert_literal(text.c_str(), literal))
+        {
+            throw Syntax_Error{"Invalid number " + text};
+        }
+        return Value{literal.real, literal.integer, literal.number};
+    }
+
+    // <condition>	::= <expression> <compare> <expression>
+    void condition()
+    {
+        expression();
+
+        p_lexer->advance();
+        Op op;
+        switch(p_lexer->get_current_token())
+        {
+        case Token::GREATER_SYMBOL:
+            op = Op::GREATER;
+            break;
+        case Token::LESS_SYMBOL:
+            op = Op::LESS;
+            break;
+        case Token::GREATER_EQUAL_SYMBOL:
+            op = Op::GREATER_EQUAL;
+            break;
+        case Token::LESS_EQUAL_SYMBOL:
+            op = Op::LESS_EQUAL;
+            break;
+        case Token::EQUAL_SYMBOL:
+            op = Op::EQUAL;
+            break;
+        default:
+            throw Syntax_Error{"Unexpected tokens in condition"};
+        }
+
+        p_lexer->advance(); // move past the symbol
+
+        expression();
+        emit(op);
+    }
+};
+
+// Stack machine running compiled programs with the semantics of the generated C++
+class VM
+{
+ protected:
+    std::vector<Value> stack;
+    std::vector<std::int32_t> variables;
+
+    std::uint64_t max_steps; // 0 for no limit
+    std::uint64_t steps;     // Instructions executed by the last run
+
+    std::ostream* p_diagnostics;
+
+ public:
+    VM() : max_steps(0), steps(0), p_diagnostics(&std::cerr) {}
+
+    VM(const VM&) = delete;
+    VM(VM&&) = delete;
+
+    void set_diagnostics(std::ostream& out) { p_diagnostics = &out; }
+
+    // Stop programs running more than limit instructions (e.g. endless loops in a server), 0 for no limit
+    void set_step_limit(std::uint64_t limit) { max_steps = limit; }
+
+    std::uint64_t get_steps() const { return steps; }
+
+    // Run code, reading INPUT values from input and writing PRINT output to output. Returns false on runtime error
+    bool run(const Bytecode& code, std::istream& input, std::ostream& output)
+    {
+        Phase_Scope scope(Phase::EXECUTE);
+        stack.clear();
+        variables.assign(code.variables.size(), 0);
+        steps = 0;
+
+        try
+        {
+            execute(code, input, output);
+            output.flush();
+            return true;
+        }
+        catch(Runtime_Error& er)
+        {
+            output.flush();
+            *p_diagnostics << "Runtime Error: " << er << std::endl;
+            return false;
+        }
+    }
+
+ private:
+    Value pop()
+    {
+        Value value = stack.back();
+        stack.pop_back();
+        return value;
+    }
+
+    void push_integer(std::int64_t integer)
+    {
+        Value value;
+        // int arithmetic wraps around like the generated code does on every common target
+        value.integer = std::int32_t(std::uint32_t(integer));
+        stack.push_back(value);
+    }
+
+    void push_real(double number)
+    {
+        Value value;
+        value.real = true;
+        value.number = number;
+        stack.push_back(value);
+    }
+
+    void push_bool(bool condition)
+    {
+        Value value;
+        value.integer = condition;
+        stack.push_back(value);
+    }
+
+    static std::int32_t to_int(const Value& value)
+    {
+        if(!value.real)
+            return std::int32_t(std::uint32_t(value.integer));
+
+        // Out of range conversions are undefined in C++, saturate instead of trapping
+        if(!(value.number > double(std::numeric_limits<std::int32_t>::min()) - 1))
+            return std::numeric_limits<std::int32_t>::min();
+        if(!(value.number < double(std::numeric_limits<std::int32_t>::max()) + 1))
+            return std::numeric_limits<std::int32_t>::max();
+        return std::int32_t(value.number);
+    }
+
+    void arithmetic(Op op)
+    {
+        Value right = pop();
+        Value left = pop();
+
+        if(left.real || right.real)
+        {
+            double a = left.as_real(), b = right.as_real();
+            switch(op)
+            {
+            case Op::ADD: push_real(a + b); return;
+            case Op::SUB: push_real(a - b); return;
+            case Op::MUL: push_real(a * b); return;
+            case Op::DIV: push_real(a / b); return;
+            default:
+                throw Runtime_Error{"mod applied to a floating point number"};
+            }
+        }
+
+        std::int64_t a = left.integer, b = right.integer;
+        switch(op)
+        {
+        case Op::ADD: push_integer(a + b); return;
+        case Op::SUB: push_integer(a - b); return;
+        case Op::MUL: push_integer(std::int64_t(std::uint64_t(a) * std::uint64_t(b))); return;
+        default:
+            if(b == 0)
+                throw Runtime_Error{"division by zero"};
+            push_integer(op == Op::DIV ? a / b : a % b);
+            return;
+        }
+    }
+
+    void compare(Op op)
+    {
+        Value right = pop();
+        Value left = pop();
+
+        if(left.real || right.real)
+        {
+            double a = left.as_real(), b = right.as_real();
+            switch(op)
+            {
+            case Op::GREATER: push_bool(a > b); return;
+            case Op::LESS: push_bool(a < b); return;
+            case Op::EQUAL: push_bool(a == b); return;
+            case Op::GREATER_EQUAL: push_bool(a >= b); return;
+            default: push_bool(a <= b); return;
+            }
+        }
+
+        std::int64_t a = left.integer, b = right.integer;
+        switch(op)
+        {
+        case Op::GREATER: push_bool(a > b); return;
+        case Op::LESS: push_bool(a < b); return;
+        case Op::EQUAL: push_bool(a == b); return;
+        case Op::GREATER_EQUAL: push_bool(a >= b); return;
+        default: push_bool(a <= b); return;
+        }
+    }
+
+    void execute(const Bytecode& code, std::istream& input, std::ostream& output)
+    {
+        std::size_t pc = 0;
+        while(true)
+        {
+            if(max_steps != 0 && steps == max_steps)
+                throw Runtime_Error{"step limit exceeded"};
+            steps++;
+
+            const Instruction& instruction = code.code[pc++];
+            switch(instruction.op)
+            {
+            case Op::PUSH:
+                stack.push_back(code.constants[instruction.operand]);
+                break;
+
+            case Op::LOAD:
+                push_integer(variables[instruction.operand]);
+                break;
+
+            case Op::STORE:
+                variables[instruction.operand] = to_int(pop());
+                break;
+
+            case Op::ADD: case Op::SUB: case Op::MUL: case Op::DIV: case Op::MOD:
+                arithmetic(instruction.op);
+                break;
+
+            case Op::GREATER: case Op::LESS: case Op::EQUAL: case Op::GREATER_EQUAL: case Op::LESS_EQUAL:
+                compare(instruction.op);
+                break;
+
+            case Op::JUMP:
+                pc = instruction.operand;
+                break;
+
+            case Op::JUMP_IF_FALSE:
+                if(pop().integer == 0)
+                    pc = instruction.operand;
+                break;
+
+            case Op::PRINT_STRING:
+                output << code.strings[instruction.operand];
+                break;
+
+            case Op::PRINT:
+                output << to_int(pop());
+                break;
+
+            case Op::INPUT:
+            {
+                // Same extraction as 'cin >> x' in the generated code, including its behaviour on bad input
+                int value = variables[instruction.operand];
+                input >> value;
+                variables[instruction.operand] = value;
+                break;
+            }
+
+            case Op::HALT:
+                return;
+            }
+        }
+    }
+};
+}
+
+#endif // TINY_VM_HPP_INCLUDED
@@ -0,0 +1,378 @@
+#ifndef TINY_WATCH_HPP_INCLUDED
+#define TINY_WATCH_HPP_INCLUDED
+
+#include "tiny_language (1).hpp"
+#include "tiny_batch.hpp"
+#include "tiny_hash.hpp"
+#include "tiny_manifest.hpp"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace TINY
+{
+// Errors setting up or reading the inotify watches
+using Watch_Error = Error<5>;
+
+struct Watch_Options
+{
+    Batch_Options batch;
+    unsigned debounce_ms = 5; // Quiet time after the last change before translating, editors save in several steps
+};
+
+// One round of retranslation
+struct Watch_Round
+{
+    Batch_Result batch;
+    double latency_seconds = 0; // From the first change of the round to its last output
+};
+
+// Translates the sources named by command line operands, then again every one of them saved afterwards.
+// Changes are noticed with inotify (a file is changed once written and closed, or moved in place), debounced, and
+// only the changed files are translated, on a scheduler kept for the whole session so that the worker translators
+// stay warm. A save that does not change the content (hash of the last translated source) is skipped, and an
+// identical output is not rewritten so that its mtime is kept.
+// Directory operands are watched recursively, new subdirectories included; file and glob operands only watch the
+// files they name
+class Watcher
+{
+ protected:
+    // What a watch descriptor looks at
+    struct Watched_Directory
+    {
+        std::string path;
+        bool recursive = false;      // Every .txt file, and new subdirectories, count
+        std::set<std::string> names; // Otherwise only these files
+    };
+
+    std::vector<std::string> operands;
+    Watch_Options options;
+    int inotify_fd;
+    int stop_pipe[2];
+    std::map<int, Watched_Directory> directories;
+    std::map<std::string, std::uint64_t> translated; // Source hash of the last translation of each file
+    Work_Stealing_Scheduler scheduler;
+
+ public:
+    Watcher(const std::vector<std::string>& operands, const Watch_Options& options = Watch_Options())
+        : operands(operands), options(options), inotify_fd(-1), stop_pipe{-1, -1},
+          scheduler(options.batch.jobs == 0 ? Work_Stealing_Scheduler::default_size() : options.batch.jobs)
+    {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(inotify_fd < 0)
+            throw Watch_Error{std::string("inotify_init1 failed: ") + std::strerror(errno)};
+        if(pipe2(stop_pipe, O_NONBLOCK | O_CLOEXEC) != 0)
+        {
+            ::close(inotify_fd);
+            throw Watch_Error{std::string("pipe2 failed: ") + std::strerror(errno)};
+        }
+    }
+
+    Watcher(const Watcher&) = delete;
+    Watcher(Watcher&&) = delete;
+
+    ~Watcher()
+    {
+        ::close(inotify_fd);
+        ::close(stop_pipe[0]);
+        ::close(stop_pipe[1]);
+    }
+
+    // Add the watches and translate every input once. Operands matching nothing are reported in errors
+    Watch_Round start(std::vector<std::string>& errors)
+    {
+        namespace fs = std::filesystem;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+        std::vector<std::string> inputs = collect_inputs(operands, errors);
+        for(const std::string& operand : operands)
+        {
+            std::error_code ec;
+            if(fs::is_directory(operand, ec))
+                watch_tree(operand, nullptr);
+        }
+        // The kernel hands out one descriptor per directory, so a file in a watched tree only adds its name
+        for(const std::string& input : inputs)
+            watch_file(input);
+
+        return translate(inputs, begin);
+    }
+
+    // Wait for changes and translate them, calling report after each round, until stop is called
+    void run(const std::function<void(const Watch_Round&)>& report)
+    {
+        std::vector<std::string> changed;
+        std::chrono::steady_clock::time_point first_change;
+
+        while(true)
+        {
+            // Block until something happens, then only wait for the quiet time while changes keep coming
+            int timeout = changed.empty() ? -1 : int(options.debounce_ms);
+            pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+            int ready = ::poll(fds, 2, timeout);
+            if(ready < 0 && errno != EINTR)
+                throw Watch_Error{std::string("poll failed: ") + std::strerror(errno)};
+            if(fds[1].revents & POLLIN)
+                return;
+
+            if(ready > 0 && (fds[0].revents & POLLIN))
+            {
+                if(changed.empty())
+                    first_change = std::chrono::steady_clock::now();
+                read_events(changed);
+                continue;
+            }
+
+            if(ready == 0 && !changed.empty())
+            {
+                std::sort(changed.begin(), changed.end());
+                changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+                report(translate(changed, first_change));
+                changed.clear();
+            }
+        }
+    }
+
+    // Make run return. Safe to call from another thread or a signal handler
+    void stop()
+    {
+        char byte = 0;
+        ssize_t written = ::write(stop_pipe[1], &byte, 1);
+        (void)written;
+    }
+
+ protected:
+    static bool is_source(const std::string& name)
+    {
+        return name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0;
+    }
+
+    static std::string parent_of(const std::string& path)
+    {
+        std::string parent = std::filesystem::path(path).parent_path().string();
+        return parent.empty() ? "." : parent;
+    }
+
+    int add_watch(const std::string& path)
+    {
+        int wd = inotify_add_watch(inotify_fd, path.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+        if(wd < 0)
+            throw Watch_Error{path + ": cannot watch: " + std::strerror(errno)};
+        return wd;
+    }
+
+    // Watch a directory and its subdirectories. With found, collect the sources already in them: a directory created
+    // after the start may have been filled before its watch was added
+    void watch_tree(const std::string& root, std::vector<std::string>* found)
+    {
+        namespace fs = std::filesystem;
+
+        Watched_Directory& directory = directories[add_watch(root)];
+        directory.path = root;
+        directory.recursive = true;
+
+        std::error_code ec;
+        for(fs::recursive_directory_iterator it(root, ec), end; it != end; it.increment(ec))
+        {
+            if(ec)
+                break;
+            if(it->is_directory(ec))
+            {
+                Watched_Directory& sub = directories[add_watch(it->path().string())];
+                sub.path = it->path().string();
+                sub.recursive = true;
+            }
+            else if(found && it->is_regular_file(ec) && it->path().extension() == ".txt")
+            {
+                found->push_back(it->path().string());
+            }
+        }
+    }
+
+    void watch_file(const std::string& path)
+    {
+        std::string parent = parent_of(path);
+        Watched_Directory& directory = directories[add_watch(parent)];
+        directory.path = parent;
+        directory.names.insert(std::filesystem::path(path).filename().string());
+    }
+
+    // Drain the pending events, appending the sources to translate again
+    void read_events(std::vector<std::string>& changed)
+    {
+        alignas(inotify_event) char buffer[1 << 16];
+
+        while(true)
+        {
+            ssize_t got = ::read(inotify_fd, buffer, sizeof buffer);
+            if(got < 0 && errno == EINTR)
+                continue;
+            if(got <= 0)
+                return;
+
+            for(char* p = buffer; p < buffer + got; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                handle_event(*event, changed);
+            }
+        }
+    }
+
+    void handle_event(const inotify_event& event, std::vector<std::string>& changed)
+    {
+        if(event.mask & IN_Q_OVERFLOW)
+        {
+            // Events were lost, every known file may have changed
+            for(const auto& entry : translated)
+                changed.push_back(entry.first);
+            return;
+        }
+
+        auto found = directories.find(event.wd);
+        if(found == directories.end())
+            return;
+        if(event.mask & IN_IGNORED)
+        {
+            directories.erase(found);
+            return;
+        }
+        if(event.len == 0)
+            return;
+
+        const Watched_Directory& directory = found->second;
+        std::string name = event.name;
+        std::string path = (std::filesystem::path(directory.path) / name).string();
+
+        if(event.mask & IN_ISDIR)
+        {
+            if(directory.recursive && (event.mask & (IN_CREATE | IN_MOVED_TO)))
+            {
+                try
+                {
+                    watch_tree(path, &changed);
+                }
+                catch(Watch_Error&)
+                {
+                    // Already removed again
+                }
+            }
+            return;
+        }
+
+        if(!is_source(name) || (!directory.recursive && directory.names.count(name) == 0))
+            return;
+
+        if(event.mask & (IN_DELETE | IN_MOVED_FROM))
+            translated.erase(path);
+        else if(event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            changed.push_back(path);
+    }
+
+    // Translate (or check) the given sources on the session's scheduler
+    Watch_Round translate(const std::vector<std::string>& inputs, std::chrono::steady_clock::time_point since)
+    {
+        Watch_Round round;
+        Batch_Result& batch = round.batch;
+        batch.files.resize(inputs.size());
+        std::vector<char> skipped(inputs.size(), 0);
+        std::vector<std::uint64_t> hashes(inputs.size(), 0);
+
+        std::vector<std::pair<std::uint64_t, Work_Stealing_Scheduler::Task>> tasks;
+        for(std::size_t i = 0; i < inputs.size(); i++)
+        {
+            batch.files[i].path = inputs[i];
+            auto last = translated.find(inputs[i]);
+            bool known = last != translated.end();
+            std::uint64_t last_hash = known ? last->second : 0;
+
+            tasks.emplace_back(0, [this, &batch, &skipped, &hashes, i, known, last_hash]
+            {
+                File_Result& result = batch.files[i];
+                std::ifstream file(result.path, std::ios::binary);
+                if(result.path.size() < 4 || !file)
+                {
+                    result.diagnostics = "Invalid file path\n";
+                    return;
+                }
+                if(!is_source(result.path))
+                {
+                    result.diagnostics = "Invalid file extension\n";
+                    return;
+                }
+                std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+                hashes[i] = content_hash(source);
+                if(known && hashes[i] == last_hash)
+                {
+                    result.ok = true;
+                    skipped[i] = 1;
+                    return;
+                }
+
+                Translator& translator = worker_translator();
+                Profiling_Scope profiling(translator, options.batch.profile);
+                std::ostringstream diagnostics;
+                translator.set_diagnostics(diagnostics);
+
+                std::stringstream input(std::move(source));
+                std::ostringstream output;
+                result.ok = translator.translate(input, output);
+                result.diagnostics = diagnostics.str();
+                translator.set_diagnostics(std::cerr);
+
+                if(options.batch.check_only)
+                    return;
+
+                std::string output_path = result.path.substr(0, result.path.size() - 4) + ".cpp";
+                if(!result.ok)
+                    std::remove(output_path.c_str());
+                else if(!detail::write_if_changed(output_path, output.str()))
+                {
+                    result.ok = false;
+                    result.diagnostics += "Cannot write output\n";
+                }
+            });
+        }
+
+        scheduler.seed(std::move(tasks));
+        scheduler.wait();
+
+        for(std::size_t i = 0; i < inputs.size(); i++)
+        {
+            // Failed files are not remembered, saving one again reports its diagnostics again
+            if(batch.files[i].ok && hashes[i] != 0)
+                translated[inputs[i]] = hashes[i];
+            else
+                translated.erase(inputs[i]);
+            if(skipped[i])
+                batch.skipped++;
+            if(!batch.files[i].ok)
+                batch.failed++;
+        }
+        batch.workers = scheduler.stats();
+
+        round.latency_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+        return round;
+    }
+};
+}
+
+#endif // TINY_WATCH_HPP_INCLUDED